@@ -0,0 +1,520 @@
+/**
+ * @file GG1-C6-bench.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Headless benchmark for the CPU-side systems of GG1-C6. Needs no window or GL context. Build from the repository root with
+ *        g++ -std=c++17 -O2 -mavx2 -mfma GG1-C6-bench.cpp util/jobs/jobs.cpp -o GG1-C6-bench -lpthread
+ *        (glm on the include path; drop -mavx2 -mfma for the SSE2 kernels)
+ * @version 0.1
+ * @date 2022-08-06
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "util/jobs/jobs.h"
+#include "util/timer.h"
+#include "objects/particles.h"
+#include "objects/particlesort.h"
+#include "objects/noise.h"
+#include "objects/sdf.h"
+#include "objects/emissionsurface.h"
+#include "objects/fluid.h"
+
+/**
+ * @brief Steps a particle system at steady state and reports the cost per frame for several particle counts. Target is 1M particles inside a 60 Hz frame. The plain rows are spawn and integration only; the 1M and 2M counts are run again with curl-noise turbulence on every emitter. Collision is left out here (see benchCollision)
+ * 
+ * @param jobs Job system to run on
+ */
+static void benchParticles(JobSystem* jobs) {
+    const unsigned int counts[] = {100000, 250000, 1000000, 2000000};
+    const int emitterCount = 4;
+    const float dt = 1.0f / 60.0f;
+
+    NoiseField noise;
+    noise.generate(NoiseParams(), jobs);
+
+    printf("-- particles (SIMD width %d, %u threads)\n", PARTICLE_SIMD_WIDTH, jobs->getThreadCount());
+    printf("%12s %12s %12s %12s\n", "particles", "turbulence", "ms/frame", "Mpart/s");
+
+    for (int turbulent = 0; turbulent < 2; turbulent++) {
+        for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            if (turbulent && counts[c] < 1000000)
+                continue;
+            ParticleSystem system(jobs);
+            system.turbulenceField = &noise;
+            for (int e = 0; e < emitterCount; e++) {
+                EmitterDesc desc;
+                desc.capacity = counts[c] / emitterCount;
+                desc.lifeMin = desc.lifeMax = 2.0f;
+                desc.spawnRate = desc.capacity / desc.lifeMax;
+                desc.frameCount = 64;
+                desc.turbulence = turbulent ? 1.5f : 0.0f;
+                desc.seed = e + 1;
+                system.addEmitter(desc);
+            }
+
+            // fill up to steady state
+            for (int f = 0; f < 150; f++)
+                system.update(dt);
+
+            const int frames = 200;
+            Timer timer;
+            for (int f = 0; f < frames; f++)
+                system.update(dt);
+            double ms = timer.elapsedMs() / frames;
+
+            printf("%12u %12s %12.3f %12.1f\n", system.getParticleCount(), turbulent ? "on" : "off", ms, system.getParticleCount() / (ms * 1000.0));
+        }
+    }
+}
+
+/**
+ * @brief Runs the same emitter updated whole and in 2 and 4 round-robin slices over an uneven frame time, and reports the cost per frame. The particles as drawn (each aged by its slice's lag, and hidden once past its lifetime) should match the unsliced run in count and mean age
+ * 
+ * @param jobs Job system to run on
+ */
+static void benchSlices(JobSystem* jobs) {
+    const unsigned int capacity = 250000;
+    const float dts[3] = {1.0f / 50.0f, 1.0f / 60.0f, 1.0f / 75.0f};
+
+    printf("-- update slices (%u particle pool, uneven frames)\n", capacity);
+    printf("%12s %12s %12s %12s %12s\n", "slices", "ms/frame", "pool", "drawn", "mean age");
+
+    unsigned int wholeDrawn = 0;
+    double wholeAge = 0.0;
+    for (unsigned int slices = 1; slices <= 4; slices *= 2) {
+        ParticleSystem system(jobs);
+        EmitterDesc desc;
+        desc.capacity = capacity;
+        desc.lifeMin = 1.0f; desc.lifeMax = 3.0f;
+        desc.spawnRate = 100000.0f;
+        desc.frameCount = 64;
+        desc.updateSlices = slices;
+        desc.seed = 1;
+        ParticleEmitter* em = system.addEmitter(desc);
+
+        for (int f = 0; f < 300; f++)
+            system.update(dts[f % 3]);
+
+        const int frames = 201;
+        Timer timer;
+        for (int f = 0; f < frames; f++)
+            system.update(dts[f % 3]);
+        double ms = timer.elapsedMs() / frames;
+
+        // what the renderer would draw
+        EmitterSlicing sl = em->drawSlicing();
+        unsigned int drawn = 0;
+        double ageSum = 0.0;
+        for (unsigned int s = 0, i = 0; i < em->pool.count; i++) {
+            while (sl.slices > 0 && s < sl.slices - 1 && i >= sl.start[s + 1])
+                s++;
+            float age = em->pool.age[i] + (sl.slices > 0 ? sl.lag[s] : 0.0f);
+            if (age < em->pool.life[i]) {
+                drawn++;
+                ageSum += age;
+            }
+        }
+        printf("%12u %12.3f %12u %12u %12.4f\n", slices, ms, em->pool.count, drawn, ageSum / drawn);
+
+        // sanity check: slicing changes when particles are stepped, not how long they live
+        if (slices == 1) {
+            wholeDrawn = drawn;
+            wholeAge = ageSum / drawn;
+        } else if (drawn != wholeDrawn || fabs(ageSum / drawn - wholeAge) > 1e-3) {
+            printf("%u slices drift from the unsliced run\n", slices);
+        }
+    }
+}
+
+/**
+ * @brief Runs emitters whose spawn rates swing between bursts and silence in one shared slab, so pools keep growing and shrinking, and reports the cost per frame with the slab's high-water mark, failed allocations and dropped spawns
+ * 
+ * @param jobs Job system to run on
+ */
+static void benchPools(JobSystem* jobs) {
+    const int emitterCount = 8;
+    const unsigned int capacity = 65536;
+    const float dt = 1.0f / 60.0f;
+
+    ParticleSlab slab(emitterCount * capacity);
+    printf("-- particle pools (%u particle slab)\n", slab.capacity);
+    printf("%12s %12s %12s %12s %12s\n", "frames", "ms/frame", "slab peak", "slab misses", "dropped");
+
+    {
+        ParticleSystem system(jobs, &slab);
+        for (int e = 0; e < emitterCount; e++) {
+            EmitterDesc desc;
+            desc.capacity = capacity;
+            desc.lifeMin = 0.5f; desc.lifeMax = 1.0f;
+            desc.seed = e + 1;
+            system.addEmitter(desc);
+        }
+
+        const int frames = 600;
+        double ms = 0.0;
+        for (int f = 0; f < frames; f++) {
+            // each emitter bursts for half a second out of every two, out of phase with the others
+            for (int e = 0; e < emitterCount; e++)
+                system.emitters[e]->desc.spawnRate = ((f + e * 15) % 120) < 30 ? capacity * 1.5f : 0.0f;
+            Timer timer;
+            system.update(dt);
+            ms += timer.elapsedMs();
+        }
+        printf("%12d %12.3f %12u %12u %12u\n", frames, ms / frames, slab.peak, slab.failures, system.getSpawnFailures());
+    }
+
+    // sanity check: every block came back
+    if (slab.used != 0)
+        printf("slab leaked %u particles\n", slab.used);
+}
+
+/**
+ * @brief Compares the ways to bring emitters to steady state: stepping update() frame by frame, presimulate() without the frame clock, and loading a snapshot of the result. Also checks the snapshot round-trips
+ * 
+ * @param jobs Job system to run on
+ */
+static void benchWarmStart(JobSystem* jobs) {
+    const int emitterCount = 8;
+    const unsigned int capacity = 32768;
+    const float seconds = 2.0f, dt = 1.0f / 60.0f;
+    const char* path = "particles_bench.bin";
+
+    ParticleSystem stepped(jobs), presimulated(jobs), loaded(jobs);
+    ParticleSystem* systems[3] = {&stepped, &presimulated, &loaded};
+    for (int s = 0; s < 3; s++) {
+        for (int e = 0; e < emitterCount; e++) {
+            EmitterDesc desc;
+            desc.capacity = capacity;
+            desc.lifeMin = 1.0f; desc.lifeMax = seconds;
+            desc.spawnRate = capacity / seconds;
+            desc.frameCount = 64;
+            desc.seed = e + 1;
+            systems[s]->addEmitter(desc);
+        }
+    }
+
+    Timer timer;
+    for (int f = 0; f < (int)ceilf(seconds / dt); f++)
+        stepped.update(dt);
+    double steppedMs = timer.elapsedMs();
+
+    timer.reset();
+    presimulated.presimulate(seconds, dt);
+    double presimMs = timer.elapsedMs();
+
+    uint64_t key = presimulated.snapshotKey(seconds, dt);
+    timer.reset();
+    bool saved = presimulated.save(path, key);
+    double saveMs = timer.elapsedMs();
+
+    timer.reset();
+    bool ok = loaded.load(path, key);
+    double loadMs = timer.elapsedMs();
+
+    FILE* file = fopen(path, "rb");
+    long bytes = 0;
+    if (file != NULL) {
+        fseek(file, 0, SEEK_END);
+        bytes = ftell(file);
+        fclose(file);
+    }
+    std::remove(path);
+
+    // sanity check: the loaded state is the saved one, particle for particle
+    bool same = saved && ok;
+    for (int e = 0; e < emitterCount && same; e++) {
+        ParticlePool* a = &presimulated.emitters[e]->pool;
+        ParticlePool* b = &loaded.emitters[e]->pool;
+        same = a->count == b->count && memcmp(a->px, b->px, a->count * sizeof(float)) == 0 && memcmp(a->age, b->age, a->count * sizeof(float)) == 0;
+    }
+
+    printf("-- warm start (%d emitters, %.1f s, %u threads)\n", emitterCount, seconds, jobs->getThreadCount());
+    printf("%12s %12s %12s %12s %12s %12s\n", "particles", "stepped ms", "presim ms", "save ms", "load ms", "KB");
+    printf("%12u %12.3f %12.3f %12.3f %12.3f %12.1f%s\n", presimulated.getParticleCount(), steppedMs, presimMs, saveMs, loadMs, bytes / 1024.0, same ? "" : "  (snapshot mismatch)");
+}
+
+/**
+ * @brief Reports depth sort time versus particle count: a cold sort, a re-sort from a still camera (coherent fast path), a re-sort after one frame of camera motion, and the mean over frames of the particles themselves moving (last frame's order tried at most every other frame)
+ * 
+ * @param jobs Job system to run on
+ */
+static void benchSort(JobSystem* jobs) {
+    const unsigned int counts[] = {10000, 100000, 250000, 1000000, 2000000};
+    const char* paths[] = {"none", "radix", "insertion"};
+
+    printf("-- depth sort (%u threads)\n", jobs->getThreadCount());
+    printf("%12s %12s %12s %12s %12s %12s %12s %12s %12s\n", "particles", "cold ms", "path", "still ms", "path", "moved ms", "path", "drift ms", "path");
+
+    for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        ParticlePool pool(counts[c]);
+        ParticleRNG rng(7);
+        pool.count = counts[c];
+        for (unsigned int i = 0; i < pool.count; i++) {
+            pool.px[i] = rng.range(-1, 1);
+            pool.py[i] = rng.range(0, 2);
+            pool.pz[i] = rng.range(-1, 1);
+            pool.vx[i] = rng.range(-1, 1);
+            pool.vy[i] = rng.range(-1, 1);
+            pool.vz[i] = rng.range(-1, 1);
+        }
+
+        ParticleSorter sorter(pool.capacity);
+        glm::vec3 eye(3, 1, 3);
+        sorter.sort(&pool, eye, jobs);
+        double coldMs = sorter.lastMs;
+        SortPath coldPath = sorter.lastPath;
+
+        // same view again: steady state for a still camera
+        sorter.sort(&pool, eye, jobs);
+        double stillMs = sorter.lastMs;
+        SortPath stillPath = sorter.lastPath;
+
+        // one frame of walking at 1 m/s
+        eye += glm::vec3(1.0f / 60.0f, 0, 0);
+        sorter.sort(&pool, eye, jobs);
+        double movedMs = sorter.lastMs;
+        SortPath movedPath = sorter.lastPath;
+
+        // frames of the particles themselves moving at up to 1 m/s per axis, averaged
+        const int driftFrames = 8;
+        double driftMs = 0.0;
+        const uint32_t* order = NULL;
+        for (int f = 0; f < driftFrames; f++) {
+            for (unsigned int i = 0; i < pool.count; i++) {
+                pool.px[i] += pool.vx[i] / 60.0f;
+                pool.py[i] += pool.vy[i] / 60.0f;
+                pool.pz[i] += pool.vz[i] / 60.0f;
+            }
+            order = sorter.sort(&pool, eye, jobs);
+            driftMs += sorter.lastMs / driftFrames;
+        }
+
+        // sanity check: back to front
+        for (unsigned int i = 1; i < pool.count; i++) {
+            glm::vec3 a = glm::vec3(pool.px[order[i - 1]], pool.py[order[i - 1]], pool.pz[order[i - 1]]) - eye;
+            glm::vec3 b = glm::vec3(pool.px[order[i]], pool.py[order[i]], pool.pz[order[i]]) - eye;
+            if (glm::dot(a, a) < glm::dot(b, b)) {
+                printf("sort order broken at %u\n", i);
+                break;
+            }
+        }
+
+        printf("%12u %12.3f %12s %12.3f %12s %12.3f %12s %12.3f %12s\n", pool.count, coldMs, paths[coldPath], stillMs, paths[stillPath],
+               movedMs, paths[movedPath], driftMs, paths[sorter.lastPath]);
+    }
+}
+
+/**
+ * @brief Reports the cost of baking the 3D noise and curl fields at a few sizes, and of sampling curl for 1M particles, checking the SIMD sampler against the scalar one
+ * 
+ * @param jobs Job system to run on
+ */
+static void benchNoise(JobSystem* jobs) {
+    const int sizes[] = {32, 64, 128};
+    const size_t count = 1000000;
+
+    printf("-- noise (SIMD width %d, %u threads)\n", NOISE_SIMD_WIDTH, jobs->getThreadCount());
+    printf("%12s %12s %12s\n", "size", "bake ms", "MB");
+
+    NoiseField field;
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        NoiseParams p;
+        p.size = sizes[s];
+        Timer timer;
+        field.generate(p, jobs);
+        double ms = timer.elapsedMs();
+        printf("%12d %12.3f %12.1f\n", p.size, ms, field.noise.size() * 4 * sizeof(float) / 1e6);
+    }
+
+    field.generate(NoiseParams(), jobs);
+    ParticleRNG rng(11);
+    vector<float> px(count), py(count), pz(count), vx(count, 0.0f), vy(count, 0.0f), vz(count, 0.0f);
+    for (size_t i = 0; i < count; i++) {
+        px[i] = rng.range(-2, 2);
+        py[i] = rng.range(0, 4);
+        pz[i] = rng.range(-2, 2);
+    }
+
+    const int frames = 20;
+    Timer timer;
+    for (int f = 0; f < frames; f++)
+        field.addCurl(&px[0], &py[0], &pz[0], &vx[0], &vy[0], &vz[0], count, 0.7f, 1.0f);
+    double ms = timer.elapsedMs() / frames;
+
+    // sanity check: the batch sampler agrees with the scalar one
+    float worst = 0.0f;
+    for (size_t i = 0; i < count; i += 997) {
+        glm::vec3 c = glm::vec3(field.sample(glm::vec3(px[i], py[i], pz[i]) * 0.7f)) * (float)frames;
+        worst = std::max(worst, glm::length(c - glm::vec3(vx[i], vy[i], vz[i])) / frames);
+    }
+    printf("%12s %12s %12s %12s\n", "curl", "ms/1M", "Mpart/s", "ns/part");
+    printf("%12s %12.3f %12.1f %12.2f  (max error %g)\n", "1M", ms, count / (ms * 1000.0), ms * 1e6 / count, worst);
+}
+
+// just enough of a mesh for SignedDistanceField::addMesh, without a GL context
+struct BenchVertex {
+    glm::vec3 position;
+};
+struct BenchMesh {
+    vector<BenchVertex> vertices;
+    vector<unsigned int> indices;
+};
+
+// axis-aligned box with outward-wound faces
+static BenchMesh benchBox(glm::vec3 lo, glm::vec3 hi) {
+    BenchMesh m;
+    for (int i = 0; i < 8; i++)
+        m.vertices.push_back(BenchVertex{glm::vec3(i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z)});
+    const unsigned int faces[36] = {0,2,3, 0,3,1, 4,5,7, 4,7,6, 0,1,5, 0,5,4, 2,6,7, 2,7,3, 0,4,6, 0,6,2, 1,3,7, 1,7,5};
+    m.indices.assign(faces, faces + 36);
+    return m;
+}
+
+/**
+ * @brief Bakes a distance field of a ground plane and a few boxes, then drops sparks onto it and reports the collision cost per frame. Target is tens of thousands of sparks well inside a frame
+ * 
+ * @param jobs Job system to run on
+ */
+static void benchCollision(JobSystem* jobs) {
+    const unsigned int counts[] = {10000, 50000, 200000};
+    const float dt = 1.0f / 60.0f;
+
+    SignedDistanceField sdf;
+    BenchMesh ground;
+    ground.vertices = {BenchVertex{glm::vec3(-10, 0, 10)}, BenchVertex{glm::vec3(10, 0, 10)}, BenchVertex{glm::vec3(10, 0, -10)}, BenchVertex{glm::vec3(-10, 0, -10)}};
+    ground.indices = {0, 1, 2, 0, 2, 3};
+    sdf.addMesh(ground, glm::mat4(1.0f));
+    for (int i = 0; i < 6; i++)
+        sdf.addMesh(benchBox(glm::vec3(-0.3f, 0.0f, -0.05f), glm::vec3(0.3f, 0.1f, 0.05f)), glm::rotate(glm::mat4(1.0f), glm::radians(60.0f * i), glm::vec3(0, 1, 0)));
+    sdf.bake(0.1f, 0.5f, jobs);
+
+    printf("-- SDF collision (%d x %d x %d voxels, baked in %.3f ms)\n", sdf.nx, sdf.ny, sdf.nz, sdf.lastMs);
+    printf("%12s %12s %12s %12s\n", "sparks", "ms/frame", "Mpart/s", "below");
+
+    for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        unsigned int n = counts[c];
+        ParticleRNG rng(5);
+        vector<float> px(n), py(n), pz(n), vx(n), vy(n), vz(n);
+        for (unsigned int i = 0; i < n; i++) {
+            px[i] = rng.range(-1, 1); py[i] = rng.range(0.1f, 1.0f); pz[i] = rng.range(-1, 1);
+            vx[i] = rng.range(-1, 1); vy[i] = rng.range(-2, 2); vz[i] = rng.range(-1, 1);
+        }
+
+        const int frames = 120;
+        double ms = 0.0;
+        for (int f = 0; f < frames; f++) {
+            for (unsigned int i = 0; i < n; i++) {
+                vy[i] -= 9.8f * dt;
+                px[i] += vx[i] * dt; py[i] += vy[i] * dt; pz[i] += vz[i] * dt;
+            }
+            Timer timer;
+            jobs->parallelFor(n, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+                sdf.collide(&px[begin], &py[begin], &pz[begin], &vx[begin], &vy[begin], &vz[begin], end - begin, 0.01f, 0.35f, 0.4f);
+            });
+            ms += timer.elapsedMs();
+        }
+
+        // sanity check: nothing fell through the ground
+        unsigned int below = 0;
+        for (unsigned int i = 0; i < n; i++)
+            if (py[i] < -0.001f)
+                below++;
+        printf("%12u %12.3f %12.1f %12u\n", n, ms / frames, n / (ms / frames * 1000.0), below);
+    }
+}
+
+// adds a grid of quads over [x0, x1] x [-1, 1] at y = 0
+static void benchGrid(BenchMesh& m, float x0, float x1, int cells) {
+    unsigned int base = m.vertices.size();
+    for (int j = 0; j <= cells; j++)
+        for (int i = 0; i <= cells; i++)
+            m.vertices.push_back(BenchVertex{glm::vec3(x0 + (x1 - x0) * i / cells, 0, -1.0f + 2.0f * j / cells)});
+    for (int j = 0; j < cells; j++) {
+        for (int i = 0; i < cells; i++) {
+            unsigned int v = base + j * (cells + 1) + i;
+            unsigned int quad[6] = {v, v + cells + 1, v + cells + 2, v, v + cells + 2, v + 1};
+            m.indices.insert(m.indices.end(), quad, quad + 6);
+        }
+    }
+}
+
+/**
+ * @brief Samples 1M spawn points from surfaces of increasing triangle count and reports the cost, which grows only as the triangle records fall out of cache. Half of each surface is tessellated far more finely than the other, so an even split of the points shows sampling follows area rather than triangle count
+ */
+static void benchSurface() {
+    const int cells[] = {16, 128, 512};
+    const size_t count = 1000000;
+
+    printf("-- surface emission (SIMD width %d)\n", SURFACE_SIMD_WIDTH);
+    printf("%12s %12s %12s %12s\n", "triangles", "ms/1M", "Mpart/s", "fine half");
+
+    for (unsigned int c = 0; c < sizeof(cells) / sizeof(cells[0]); c++) {
+        BenchMesh mesh;
+        benchGrid(mesh, -1.0f, 0.0f, cells[c]);
+        benchGrid(mesh, 0.0f, 1.0f, 4);
+        EmissionSurface surface;
+        surface.addMesh(mesh, glm::mat4(1.0f));
+        surface.build();
+
+        SurfaceRNG rng(9);
+        vector<float> px(count), py(count), pz(count), nx(count), ny(count), nz(count);
+        const int frames = 10;
+        Timer timer;
+        for (int f = 0; f < frames; f++)
+            for (size_t i = 0; i < count; i += PARTICLE_GRAIN) {
+                size_t n = count - i < PARTICLE_GRAIN ? count - i : PARTICLE_GRAIN;
+                surface.sample(rng, n, &px[i], &py[i], &pz[i], &nx[i], &ny[i], &nz[i]);
+            }
+        double ms = timer.elapsedMs() / frames;
+
+        size_t fine = 0;
+        for (size_t i = 0; i < count; i++)
+            fine += px[i] < 0.0f;
+        printf("%12u %12.3f %12.1f %12.3f\n", surface.triangleCount, ms, count / (ms * 1000.0), (double)fine / count);
+    }
+}
+
+/**
+ * @brief Steps the smoke solver at several grid sizes and reports the cost per step, split by stage, with the divergence left after projection
+ * 
+ * @param jobs Job system to run on
+ */
+static void benchFluid(JobSystem* jobs) {
+    const int sizes[] = {32, 64, 96, 128};
+    const float dt = 1.0f / 60.0f;
+
+    printf("-- smoke fluid (SIMD width %d, %u threads)\n", FLUID_SIMD_WIDTH, jobs->getThreadCount());
+    printf("%12s %12s %12s %12s %12s %12s\n", "grid", "ms/step", "forces", "advect", "project", "rms div");
+
+    for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        SmokeFluid fluid(sizes[s], jobs);
+        // let a plume develop before timing
+        for (int f = 0; f < 30; f++)
+            fluid.step(dt);
+
+        const int frames = 30;
+        double ms = 0.0, forces = 0.0, advect = 0.0, project = 0.0;
+        for (int f = 0; f < frames; f++) {
+            fluid.step(dt);
+            ms += fluid.lastMs; forces += fluid.forceMs; advect += fluid.advectMs; project += fluid.projectMs;
+        }
+        printf("%11d^3 %12.3f %12.3f %12.3f %12.3f %12.4f\n", fluid.size, ms / frames, forces / frames, advect / frames, project / frames, fluid.rmsDivergence());
+    }
+}
+
+int main() {
+    JobSystem jobs;
+
+    benchParticles(&jobs);
+    benchSlices(&jobs);
+    benchPools(&jobs);
+    benchWarmStart(&jobs);
+    benchSort(&jobs);
+    benchNoise(&jobs);
+    benchCollision(&jobs);
+    benchSurface();
+    benchFluid(&jobs);
+
+    return 0;
+}
@@ -10,11 +10,1030 @@
 
 GG1_C6_Handler::GG1_C6_Handler() {
     wDown = false; aDown = false; sDown = false; dDown = false; spDown = false; shDown = false; enDown = false;
+    relX = 0; relY = 0;
     camera = new Camera(glm::vec3(2.8963, 0.35203, -1.65028), glm::vec3(0, 1, 0), -209.7, -6.2);
     camera->movementSpeed = 20.0f;
+
+    // light-heavy deployments can pick deferred shading at startup
+    const char* path = getenv("GG1C6_RENDER_PATH");
+    if (path != NULL && strcmp(path, "deferred") == 0)
+        renderPath = PATH_DEFERRED;
+    // the GPU benchmarks cost seconds before the first frame, so they only run when asked for
+    const char* bench = getenv("GG1C6_BENCHMARK");
+    benchmarksOn = bench != NULL && strcmp(bench, "0") != 0;
+
+    jobs = new JobSystem();
+    // every CPU emitter's pool lives in one arena, with headroom for a pool to move while it grows
+    particleSlab = new ParticleSlab(65536);
+    particles = new ParticleSystem(jobs, particleSlab);
+
+    // baked once and cached; shared by the particle turbulence and the heat haze
+    noiseField = new NoiseField();
+    noiseField->import("textures", NoiseParams(), jobs);
+    particles->turbulenceField = noiseField;
+    particleLod = new ParticleLod();
+    fluid = new SmokeFluid(64, jobs);
+
+    // flames
+    EmitterDesc fire;
+    fire.layer = LAYER_FIRE;
+    fire.capacity = 8192;
+    fire.radius = 0.15f;
+    fire.spawnRate = 4096.0f;
+    fire.lifeMin = 0.6f; fire.lifeMax = 1.2f;
+    fire.velocity = glm::vec3(0, 0.8f, 0);
+    fire.velocitySpread = 0.15f;
+    fire.acceleration = glm::vec3(0, 1.2f, 0);
+    fire.drag = 1.0f;
+    fire.turbulence = 1.5f;
+    fire.turbulenceScale = 0.7f;
+    fire.sizeStart = 0.35f; fire.sizeEnd = 0.1f;
+    fire.frameCount = 64;
+    fire.seed = 1;
+    particles->addEmitter(fire);
+
+    // embers
+    EmitterDesc embers;
+    embers.layer = LAYER_EMBER;
+    embers.capacity = 2048;
+    embers.radius = 0.2f;
+    embers.spawnRate = 256.0f;
+    embers.lifeMin = 1.5f; embers.lifeMax = 3.0f;
+    embers.velocity = glm::vec3(0, 1.5f, 0);
+    embers.velocitySpread = 0.6f;
+    embers.acceleration = glm::vec3(0, -0.3f, 0);
+    embers.drag = 0.2f;
+    embers.sizeStart = 0.02f; embers.sizeEnd = 0.01f;
+    embers.collide = true;
+    embers.seed = 2;
+    particles->addEmitter(embers);
+
+    // sparks: thrown out of the fire, they fall and skitter over the logs and the ground
+    EmitterDesc sparks;
+    sparks.layer = LAYER_EMBER;
+    sparks.capacity = 16384;
+    sparks.position = glm::vec3(0, 0.2f, 0);
+    sparks.radius = 0.15f;
+    sparks.spawnRate = 4096.0f;
+    sparks.lifeMin = 1.0f; sparks.lifeMax = 2.0f;
+    sparks.velocity = glm::vec3(0, 2.5f, 0);
+    sparks.velocitySpread = 1.5f;
+    sparks.acceleration = glm::vec3(0, -9.8f, 0);
+    sparks.drag = 0.1f;
+    sparks.sizeStart = 0.015f; sparks.sizeEnd = 0.005f;
+    sparks.collide = true;
+    sparks.restitution = 0.35f;
+    sparks.friction = 0.4f;
+    sparks.seed = 4;
+    particles->addEmitter(sparks);
+
+    // smoke
+    EmitterDesc smoke;
+    smoke.layer = LAYER_SMOKE;
+    smoke.capacity = 4096;
+    smoke.position = glm::vec3(0, 0.6f, 0);
+    smoke.radius = 0.2f;
+    smoke.spawnRate = 512.0f;
+    smoke.lifeMin = 3.0f; smoke.lifeMax = 5.0f;
+    smoke.velocity = glm::vec3(0, 0.6f, 0);
+    smoke.velocitySpread = 0.1f;
+    smoke.acceleration = glm::vec3(0.05f, 0.1f, 0);
+    smoke.drag = 0.3f;
+    smoke.turbulence = 0.6f;
+    smoke.turbulenceScale = 0.35f;
+    smoke.sizeStart = 0.3f; smoke.sizeEnd = 1.2f;
+    smoke.frameCount = 64;
+    smoke.updateSlices = 4;
+    smoke.seed = 3;
+    particles->addEmitter(smoke);
+
+    // a ring of logs under the fire, leaning in, for the flames and smoke to intersect
+    for (int i = 0; i < 6; i++) {
+        glm::mat4 m = glm::rotate(glm::mat4(1.0f), glm::radians(60.0f * i), glm::vec3(0, 1, 0));
+        m = glm::translate(m, glm::vec3(0.3f, 0.08f, 0));
+        m = glm::rotate(m, glm::radians(20.0f), glm::vec3(0, 0, 1));
+        logTransforms.push_back(m);
+    }
+
+    // small flames licking along the logs themselves; the surface is filled in once the log mesh exists
+    logSurface = new EmissionSurface();
+    EmitterDesc logFlames;
+    logFlames.layer = LAYER_FIRE;
+    logFlames.capacity = 4096;
+    logFlames.surface = logSurface;
+    logFlames.radius = 0.02f;
+    logFlames.normalSpeed = 0.15f;
+    logFlames.spawnRate = 2048.0f;
+    logFlames.lifeMin = 0.3f; logFlames.lifeMax = 0.7f;
+    logFlames.velocity = glm::vec3(0, 0.4f, 0);
+    logFlames.velocitySpread = 0.05f;
+    logFlames.acceleration = glm::vec3(0, 1.0f, 0);
+    logFlames.drag = 1.0f;
+    logFlames.turbulence = 1.0f;
+    logFlames.turbulenceScale = 1.5f;
+    logFlames.sizeStart = 0.12f; logFlames.sizeEnd = 0.03f;
+    logFlames.frameCount = 64;
+    logFlames.seed = 5;
+    particles->addEmitter(logFlames);
+
+    // the fire's glow, and faint moonlight
+    fireLight = new PntLight(glm::vec3(0, 0.4f, 0), 1.0f);
+    moonLight = new DirLight(glm::normalize(glm::vec3(0.3f, -1.0f, 0.5f)), 0.05f);
+
+    // a field of torches around it, each its own small flickering light
+    for (int x = -7; x <= 7; x++) {
+        for (int z = -7; z <= 7; z++) {
+            if (abs(x) < 2 && abs(z) < 2)
+                continue;
+            torchLights.push_back(new PntLight(glm::vec3(x * 1.3f, 0.25f, z * 1.3f), 0.3f, 1.5f));
+            torchPhases.push_back((float)((x * 7 + z * 13) & 63));
+        }
+    }
+
+    // embers are purely additive, so only flames and smoke are drawn back to front
+    for (unsigned int i = 0; i < particles->emitters.size(); i++) {
+        ParticleEmitter* e = particles->emitters[i];
+        particleSorters.push_back(e->desc.layer == LAYER_EMBER ? NULL : new ParticleSorter(e->pool.maxCapacity));
+    }
 }
 
 GG1_C6_Handler::~GG1_C6_Handler() {
+    for (unsigned int i = 0; i < cpuParticleBuffers.size(); i++)
+        delete cpuParticleBuffers[i];
+    for (unsigned int i = 0; i < particleSorters.size(); i++)
+        delete particleSorters[i];
+    delete particleRenderer;
+    delete oit;
+    delete lowRes;
+    delete haze;
+    delete bloom;
+    delete hdr;
+    delete sceneDepth;
+    delete sceneShader;
+    delete lights;
+    delete fireLight;
+    delete moonLight;
+    for (unsigned int i = 0; i < torchLights.size(); i++)
+        delete torchLights[i];
+    delete clusters;
+    delete deferred;
+    delete shadows;
+    delete potMesh;
+    delete ground;
+    delete logMesh;
+    delete gpuParticles;
+    delete gpuSorter;
+    for (unsigned int i = 0; i < gpuSortTimers.size(); i++)
+        delete gpuSortTimers[i];
+    delete gpuSimTimer;
+    delete particleDrawTimer;
+    delete clusterTimer;
+    delete sceneTimer;
+    delete shadowTimer;
+    delete oitTimer;
+    delete depthTimer;
+    delete hazeTimer;
+    delete bloomTimer;
+    delete particles;
+    delete particleSlab;
+    delete logSurface;
+    delete fluid;
+    delete smokeVolume;
+    delete smokeTimer;
+    delete volumeFire;
+    delete volumeFireTimer;
+    delete sceneSdf;
+    delete particleLod;
+    delete noiseField;
+    glDeleteTextures(1, &noiseTexture);
+    delete jobs;
     delete camera;
 }
 
+/**
+ * @brief Polls SDL events; tracks movement keys and relative mouse motion
+ */
+void GG1_C6_Handler::objEventHandler() {
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT) {
+            kernel->stop();
+        } else if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+            bool down = event.type == SDL_KEYDOWN;
+            switch (event.key.keysym.sym) {
+                case SDLK_w: wDown = down; break;
+                case SDLK_a: aDown = down; break;
+                case SDLK_s: sDown = down; break;
+                case SDLK_d: dDown = down; break;
+                case SDLK_SPACE: spDown = down; break;
+                case SDLK_LSHIFT: shDown = down; break;
+                case SDLK_RETURN: enDown = down; break;
+                case SDLK_ESCAPE: kernel->stop(); break;
+                case SDLK_p:
+                    // switch simulation backend (both run the same emitter descriptions)
+                    if (down) {
+                        backend = backend == BACKEND_CPU ? BACKEND_GPU : BACKEND_CPU;
+                        cout << "particle backend: " << (backend == BACKEND_CPU ? "CPU" : "GPU") << endl;
+                    }
+                    break;
+                case SDLK_i: if (down) toggleTransparency(LAYER_FIRE); break;
+                case SDLK_o: if (down) toggleTransparency(LAYER_SMOKE); break;
+                case SDLK_l:
+                    // cycle particle resolution: full, half, quarter
+                    if (down) {
+                        lowRes->setFactor(lowRes->factor == 4 ? 1 : lowRes->factor * 2);
+                        cout << "particle resolution: 1/" << lowRes->factor << endl;
+                    }
+                    break;
+                case SDLK_h:
+                    if (down) {
+                        hazeOn = !hazeOn;
+                        cout << "heat haze: " << (hazeOn ? "on" : "off") << endl;
+                    }
+                    break;
+                case SDLK_b:
+                    if (down) {
+                        bloomOn = !bloomOn;
+                        cout << "bloom: " << (bloomOn ? "on" : "off") << endl;
+                    }
+                    break;
+                case SDLK_f:
+                    // switch the HDR scene format; the haze copy of the scene follows it
+                    if (down) {
+                        hdr->setFormat(hdr->format == GL_R11F_G11F_B10F ? GL_RGBA16F : GL_R11F_G11F_B10F);
+                        delete haze;
+                        haze = new HeatHaze(kernel->getRX(), kernel->getRY(), hdr->format);
+                        haze->setNoise(noiseTexture);
+                        cout << "HDR format: " << (hdr->format == GL_R11F_G11F_B10F ? "R11F_G11F_B10F" : "RGBA16F") << endl;
+                    }
+                    break;
+                case SDLK_m:
+                    if (down) {
+                        particleLod->enabled = !particleLod->enabled;
+                        cout << "particle LOD: " << (particleLod->enabled ? "on" : "off") << endl;
+                    }
+                    break;
+                case SDLK_v:
+                    // grid-simulated smoke over the fire, raymarched; it starts empty each time it is turned on
+                    if (down) {
+                        fluidOn = !fluidOn;
+                        if (fluidOn) {
+                            delete fluid;
+                            fluid = new SmokeFluid(64, jobs);
+                        }
+                        cout << "fluid smoke: " << (fluidOn ? "on" : "off") << endl;
+                    }
+                    break;
+                case SDLK_c:
+                    // cycle the fire: sprites, then raymarched at full, half and quarter resolution
+                    if (down) {
+                        if (!volumeFireOn) {
+                            volumeFireOn = true;
+                            volumeFire->pass->setFactor(1);
+                        } else if (volumeFire->pass->factor == 4)
+                            volumeFireOn = false;
+                        else
+                            volumeFire->pass->setFactor(volumeFire->pass->factor * 2);
+                        if (volumeFireOn)
+                            cout << "fire: raymarched at 1/" << volumeFire->pass->factor << endl;
+                        else
+                            cout << "fire: sprites" << endl;
+                    }
+                    break;
+                case SDLK_u:
+                    // cycle how many slices the CPU smoke is updated in: 1, 2, 4
+                    if (down) {
+                        for (unsigned int i = 0; i < particles->emitters.size(); i++) {
+                            EmitterDesc& d = particles->emitters[i]->desc;
+                            if (d.layer != LAYER_SMOKE)
+                                continue;
+                            d.updateSlices = d.updateSlices >= 4 ? 1 : d.updateSlices * 2;
+                            cout << "smoke: 1/" << d.updateSlices << " of particles updated per frame" << endl;
+                        }
+                    }
+                    break;
+                case SDLK_k:
+                    // cycle soft particles: off, full-resolution depth, half-resolution depth
+                    if (down) {
+                        softMode = (SoftParticleMode)((softMode + 1) % 3);
+                        cout << "soft particles: " << (softMode == SOFT_OFF ? "off" : softMode == SOFT_FULL ? "full-res depth" : "half-res depth") << endl;
+                    }
+                    break;
+            }
+        } else if (event.type == SDL_MOUSEMOTION) {
+            relX += event.motion.xrel;
+            relY += event.motion.yrel;
+        }
+    }
+}
+
+/**
+ * @brief Draws all objects in the scene
+ */
+void GG1_C6_Handler::objRendererHandler() {
+    // shadow tiles change light records, so the atlas is updated before the lights are flushed
+    shadowTimer->begin();
+    dynamicBounds[0] = glm::vec4(glm::vec3(potTransform[3]), 0.2f);
+    shadows->update(camera, kernel->getRX(), kernel->getRY(), lights,
+        [this](Shader* shader) { drawShadowCasters(shader, false); },
+        [this](Shader* shader) { drawShadowCasters(shader, true); },
+        dynamicBounds);
+    shadowTimer->end();
+
+    // everything is drawn in HDR and tonemapped into the window at the end
+    hdr->begin();
+    glEnable(GL_DEPTH_TEST);
+
+    lights->flush();
+    lights->bind();
+
+    sceneTimer->begin();
+    drawScene(lights, renderPath);
+    sceneTimer->end();
+
+    // particles fade against the opaque scene (and low-resolution particles test against it), so its depth is resolved in between
+    // GPU particles also collide with it on the next step
+    if (softMode != SOFT_OFF || lowRes->factor > 1 || hazeOn || backend == BACKEND_GPU || fluidOn || volumeFireOn) {
+        depthTimer->begin();
+        sceneDepth->resolve(camera, kernel->getRX(), kernel->getRY());
+        depthTimer->end();
+        float aspect = (float)kernel->getRX() / kernel->getRY();
+        gpuParticles->setCollisionDepth(sceneDepth->texture(DEPTH_FULL), camera->getProjectionMatrix(aspect) * camera->getViewMatrix(), camera->position);
+    }
+
+    // the grid smoke is part of what the haze shimmers, so it goes first
+    if (fluidOn) {
+        smokeTimer->begin();
+        smokeVolume->draw(camera, (float)kernel->getRX() / kernel->getRY(), sceneDepth->texture(DEPTH_FULL), fireLight, lightColor, ambient);
+        smokeTimer->end();
+    }
+
+    // shimmer distorts the scene behind the flames, so it goes before them
+    if (hazeOn)
+        drawHaze();
+
+    if (softMode != SOFT_OFF)
+        particleRenderer->setSceneDepth(sceneDepth->texture(softMode == SOFT_HALF ? DEPTH_HALF : DEPTH_FULL), softMode == SOFT_HALF);
+    else
+        particleRenderer->setSceneDepth(0, false);
+
+    // the raymarched flames go under the remaining layers, which rise out of them
+    if (volumeFireOn) {
+        volumeFireTimer->begin();
+        volumeFire->draw(camera, (float)kernel->getRX() / kernel->getRY(), sceneDepth, elapsed);
+        volumeFireTimer->end();
+    }
+
+    drawParticles();
+
+    if (bloomOn)
+        drawBloom();
+
+    hdr->resolve(bloomOn ? bloom->pyramid : 0, bloom->intensity);
+    lights->endFrame();
+}
+
+/**
+ * @brief Renders fire distortion at reduced resolution and resamples the scene through it
+ */
+void GG1_C6_Handler::drawHaze() {
+    hazeTimer->begin();
+
+    // distortion is occluded by the half-resolution depth whether or not the sprites themselves are soft
+    particleRenderer->setSceneDepth(sceneDepth->texture(DEPTH_HALF), true);
+    haze->begin(elapsed);
+    for (unsigned int i = 0; i < getEmitterCount(); i++) {
+        ParticleDrawSource src = particleSource(i);
+        if (src.layer == LAYER_FIRE)
+            particleRenderer->draw(src, camera, haze->width(), haze->height(), haze->particleShader);
+    }
+    haze->end();
+    haze->apply();
+
+    hazeTimer->end();
+}
+
+/**
+ * @brief Builds the glow around the brightest parts of the frame; it is added during the tonemapping resolve
+ */
+void GG1_C6_Handler::drawBloom() {
+    bloomTimer->begin();
+    bloom->apply(hdr->color());
+    bloomTimer->end();
+}
+
+/**
+ * @brief Number of emitters of the active backend
+ */
+unsigned int GG1_C6_Handler::getEmitterCount() {
+    return backend == BACKEND_CPU ? particles->emitters.size() : gpuParticles->emitters.size();
+}
+
+/**
+ * @brief Unsorted draw source of an emitter of the active backend
+ */
+ParticleDrawSource GG1_C6_Handler::particleSource(unsigned int i) {
+    if (backend == BACKEND_CPU)
+        return cpuParticleBuffers[i]->drawSource(particles->emitters[i]->desc.layer);
+    return gpuParticles->emitters[i]->drawSource();
+}
+
+/**
+ * @brief Draws and lights the opaque scene into the scene framebuffer
+ *
+ * @param sceneLights Lights to shade with, flushed and bound
+ * @param path Forward shading over light clusters, or deferred shading over screen tiles
+ */
+void GG1_C6_Handler::drawScene(LightBuffer* sceneLights, RenderPath path) {
+    shadows->bind();
+
+    if (path == PATH_DEFERRED) {
+        deferred->begin();
+        drawSceneGeometry(deferred->geometryShader);
+        deferred->shade(camera, sceneLights->getCount(), lightColor, ambient);
+        return;
+    }
+
+    // shading only evaluates the lights that can reach each froxel
+    clusterTimer->begin();
+    clusters->build(camera, (float)kernel->getRX() / (float)kernel->getRY(), sceneLights);
+    clusterTimer->end();
+
+    sceneShader->use();
+    clusters->bindBuffers();
+    clusters->setUniforms(sceneShader, camera, kernel->getRX(), kernel->getRY());
+    sceneShader->setVec3("eye", camera->position);
+    sceneShader->setVec3("lightColor", lightColor);
+    sceneShader->setVec3("ambient", ambient);
+    drawSceneGeometry(sceneShader);
+}
+
+/**
+ * @brief Draws the ground and the logs of the fire with any shader taking the scene vertex shader's uniforms plus albedo and roughness
+ */
+void GG1_C6_Handler::drawSceneGeometry(Shader* shader) {
+    float aspect = (float)kernel->getRX() / (float)kernel->getRY();
+    shader->use();
+    shader->setMat4("view", camera->getViewMatrix());
+    shader->setMat4("projection", camera->getProjectionMatrix(aspect));
+
+    shader->setMat4("model", glm::mat4(1.0f));
+    shader->setVec3("albedo", glm::vec3(0.25f, 0.22f, 0.2f));
+    shader->setFloat("roughness", 0.9f);
+    ground->draw(shader);
+
+    shader->setVec3("albedo", glm::vec3(0.3f, 0.18f, 0.1f));
+    shader->setFloat("roughness", 0.6f);
+    for (unsigned int i = 0; i < logTransforms.size(); i++) {
+        shader->setMat4("model", logTransforms[i]);
+        logMesh->draw(shader);
+    }
+
+    shader->setVec3("albedo", glm::vec3(0.05f, 0.05f, 0.06f));
+    shader->setFloat("roughness", 0.4f);
+    shader->setMat4("model", potTransform);
+    potMesh->draw(shader);
+}
+
+/**
+ * @brief Draws shadow casters with the shadow depth shader. The ground casts onto nothing, so it is left out
+ *
+ * @param shader Shader to draw with (only "model" is set)
+ * @param dynamic Whether to draw the moving casters rather than the static ones
+ */
+void GG1_C6_Handler::drawShadowCasters(Shader* shader, bool dynamic) {
+    if (dynamic) {
+        shader->setMat4("model", potTransform);
+        potMesh->draw(shader);
+        return;
+    }
+    for (unsigned int i = 0; i < logTransforms.size(); i++) {
+        shader->setMat4("model", logTransforms[i]);
+        logMesh->draw(shader);
+    }
+}
+
+/**
+ * @brief Times the opaque scene under both render paths with 10, 100 and 1000 point lights scattered over the ground, and prints a table to choose a path per deployment by
+ */
+void GG1_C6_Handler::benchmarkRenderPaths() {
+    const unsigned int counts[] = {10, 100, 1000};
+    const int frames = 32;
+    GLuint queries[2];
+    glGenQueries(2, queries);
+
+    cout << "-- opaque scene, ms/frame at " << kernel->getRX() << "x" << kernel->getRY() << endl;
+    cout << "lights\tforward\tdeferred" << endl;
+    for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        LightBuffer benchLights(counts[c]);
+        vector<PntLight> points;
+        points.reserve(counts[c]);
+        ParticleRNG rng(c + 1);
+        for (unsigned int i = 0; i < counts[c]; i++)
+            points.push_back(PntLight(glm::vec3(rng.range(-10, 10), rng.range(0.1f, 0.5f), rng.range(-10, 10)), 0.3f, 1.5f));
+        for (unsigned int i = 0; i < counts[c]; i++)
+            benchLights.add(&points[i]);
+
+        float ms[2];
+        for (int p = 0; p < 2; p++) {
+            // a few frames first, so every region of the light buffer is filled and the pipeline is warm
+            for (int f = -4; f < frames; f++) {
+                if (f == 0)
+                    glQueryCounter(queries[0], GL_TIMESTAMP);
+                hdr->begin();
+                benchLights.flush();
+                benchLights.bind();
+                drawScene(&benchLights, (RenderPath)p);
+                benchLights.endFrame();
+            }
+            glQueryCounter(queries[1], GL_TIMESTAMP);
+
+            GLuint64 t0, t1;
+            glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &t0);
+            glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &t1);
+            ms[p] = (t1 - t0) / 1000000.0f / frames;
+        }
+        cout << counts[c] << "\t" << ms[0] << "\t" << ms[1] << endl;
+    }
+    glFinish();
+    glDeleteQueries(2, queries);
+}
+
+/**
+ * @brief Times the fire sprites against the raymarched fire at 1, 1/2 and 1/4 resolution, drawn over the opaque scene, and prints a table. The CPU fire has been warm-started, so the sprites are at their steady-state count. Skipped when the scene has no fire emitter
+ */
+void GG1_C6_Handler::benchmarkFireRenderers() {
+    const int frames = 32;
+    const int factors[] = {1, 2, 4};
+    int rx = kernel->getRX(), ry = kernel->getRY();
+
+    unsigned int fire = 0;
+    while (fire < particles->emitters.size() && particles->emitters[fire]->desc.layer != LAYER_FIRE)
+        fire++;
+    if (fire == particles->emitters.size() || volumeFire == NULL)
+        return;
+    GLuint queries[2];
+    glGenQueries(2, queries);
+    ParticlePool* pool = &particles->emitters[fire]->pool;
+    cpuParticleBuffers[fire]->upload(pool, particleSorters[fire]->sort(pool, camera->position, jobs));
+    ParticleDrawSource src = cpuParticleBuffers[fire]->drawSource(LAYER_FIRE);
+
+    // one scene under every variant; each frame blends over the last, which is all the timing needs
+    hdr->begin();
+    lights->flush();
+    lights->bind();
+    drawScene(lights, renderPath);
+    lights->endFrame();
+    sceneDepth->resolve(camera, rx, ry);
+    particleRenderer->setSceneDepth(sceneDepth->texture(DEPTH_HALF), true);
+    float aspect = (float)rx / ry;
+    int restoreFactor = volumeFire->pass->factor;
+
+    float ms[4];
+    for (int v = 0; v < 4; v++) {
+        if (v > 0)
+            volumeFire->pass->setFactor(factors[v - 1]);
+        for (int f = -4; f < frames; f++) {
+            if (f == 0)
+                glQueryCounter(queries[0], GL_TIMESTAMP);
+            if (v == 0)
+                particleRenderer->draw(src, camera, rx, ry);
+            else
+                volumeFire->draw(camera, aspect, sceneDepth, f / 60.0f);
+        }
+        glQueryCounter(queries[1], GL_TIMESTAMP);
+
+        GLuint64 t0, t1;
+        glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &t0);
+        glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &t1);
+        ms[v] = (t1 - t0) / 1000000.0f / frames;
+    }
+    volumeFire->pass->setFactor(restoreFactor);
+
+    cout << "-- fire, ms/frame at " << rx << "x" << ry << " (" << pool->count << " sprites, raymarch skips " << 100.0f - volumeFire->occupancy * 100.0f << "% of its bounds)" << endl;
+    cout << "sprites\traymarch 1/1\traymarch 1/2\traymarch 1/4" << endl;
+    cout << ms[0] << "\t" << ms[1] << "\t" << ms[2] << "\t" << ms[3] << endl;
+    glFinish();
+    glDeleteQueries(2, queries);
+}
+
+/**
+ * @brief Times a smoke layer of 16K, 64K and 256K particles both ways: depth sorted on the CPU and drawn in order, against weighted blended OIT drawn in pool order, and prints a table. The sort is re-run every frame from a slowly moving eye, as it would be in play, so its cost counts against the sorted path
+ */
+void GG1_C6_Handler::benchmarkTransparency() {
+    const unsigned int counts[] = {16384, 65536, 262144};
+    const int frames = 32;
+    int rx = kernel->getRX(), ry = kernel->getRY();
+    GLuint queries[2];
+    glGenQueries(2, queries);
+
+    glm::vec3 origin(0, 0.6f, 0);
+    for (unsigned int i = 0; i < particles->emitters.size(); i++)
+        if (particles->emitters[i]->desc.layer == LAYER_SMOKE)
+            origin = particles->emitters[i]->desc.position;
+
+    hdr->begin();
+    lights->flush();
+    lights->bind();
+    drawScene(lights, renderPath);
+    lights->endFrame();
+    sceneDepth->resolve(camera, rx, ry);
+    particleRenderer->setSceneDepth(sceneDepth->texture(DEPTH_HALF), true);
+
+    cout << "-- smoke transparency, ms/frame at " << rx << "x" << ry << endl;
+    cout << "particles\tsort\tsorted draw\tsorted total\tOIT draw" << endl;
+    for (unsigned int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        // a column of smoke over the fire, at every age
+        ParticlePool pool(counts[c]);
+        ParticleRNG rng(c + 1);
+        unsigned int granted;
+        pool.spawn(counts[c], granted);
+        for (unsigned int i = 0; i < pool.count; i++) {
+            pool.px[i] = origin.x + rng.range(-0.8f, 0.8f);
+            pool.py[i] = origin.y + rng.range(0.0f, 3.0f);
+            pool.pz[i] = origin.z + rng.range(-0.8f, 0.8f);
+            pool.vx[i] = 0.0f; pool.vy[i] = 0.6f; pool.vz[i] = 0.0f;
+            pool.life[i] = 4.0f;
+            pool.age[i] = rng.range(0.0f, 4.0f);
+            pool.size[i] = 0.3f + 0.9f * pool.age[i] / pool.life[i];
+            pool.frame[i] = rng.next() % 64;
+        }
+        ParticleSorter sorter(pool.maxCapacity);
+        CpuParticleBuffer buffer(pool.maxCapacity);
+
+        // each draw is timed on its own, so the GPU idling through the CPU sort is not counted as drawing
+        double sortMs = 0.0;
+        float ms[2] = {0.0f, 0.0f};
+        for (int v = 0; v < 2; v++) {
+            if (v == 1)
+                buffer.upload(&pool);
+            for (int f = -4; f < frames; f++) {
+                if (v == 0) {
+                    Timer timer;
+                    const uint32_t* order = sorter.sort(&pool, camera->position + glm::vec3(0.01f * f, 0, 0), jobs);
+                    if (f >= 0)
+                        sortMs += timer.elapsedMs();
+                    buffer.upload(&pool, order);
+                }
+
+                glQueryCounter(queries[0], GL_TIMESTAMP);
+                if (v == 0) {
+                    particleRenderer->draw(buffer.drawSource(LAYER_SMOKE), camera, rx, ry);
+                } else {
+                    oit->begin(rx, ry);
+                    particleRenderer->draw(buffer.drawSource(LAYER_SMOKE), camera, rx, ry, oit->particleShader);
+                    oit->end(rx, ry);
+                    oit->composite();
+                }
+                glQueryCounter(queries[1], GL_TIMESTAMP);
+
+                GLuint64 t0, t1;
+                glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &t0);
+                glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &t1);
+                if (f >= 0)
+                    ms[v] += (t1 - t0) / 1000000.0f / frames;
+            }
+        }
+        sortMs /= frames;
+        cout << pool.count << "\t" << sortMs << "\t" << ms[0] << "\t" << sortMs + ms[0] << "\t" << ms[1] << endl;
+    }
+    glFinish();
+    glDeleteQueries(2, queries);
+}
+
+/**
+ * @brief Draws every emitter of the active backend. Sorted and additive layers are blended straight into the scene; OIT layers are accumulated unsorted and composited on top
+ */
+void GG1_C6_Handler::drawParticles() {
+    int rx = kernel->getRX(), ry = kernel->getRY();
+    unsigned int emitterCount = getEmitterCount();
+
+    particleDrawTimer->begin();
+    gpuSortMs = 0.0f;
+    bool anyOit = false;
+    bool reduced = lowRes->factor > 1;
+    if (reduced)
+        lowRes->begin(sceneDepth, camera);
+    for (unsigned int i = 0; i < emitterCount; i++) {
+        ParticleDrawSource src = particleSource(i);
+
+        // the fire sprites are still simulated under the raymarched flames: they drive the haze
+        if (volumeFireOn && src.layer == LAYER_FIRE)
+            continue;
+        if (usesOit(src.layer)) {
+            anyOit = true;
+            continue;
+        }
+
+        // each sorted list is only valid until the next sort, so sort and draw one emitter at a time
+        if (backend == BACKEND_GPU && src.layer != LAYER_EMBER) {
+            gpuSortTimers[i]->begin();
+            src = gpuSorter->sort(src, camera->position);
+            gpuSortTimers[i]->end();
+            gpuSortMs += gpuSortTimers[i]->getMs();
+        }
+
+        if (reduced) {
+            lowRes->bindLowRes();
+            particleRenderer->draw(src, camera, lowRes->width(), lowRes->height());
+            lowRes->beginFixup();
+            particleRenderer->draw(src, camera, rx, ry);
+            lowRes->endFixup();
+        } else {
+            particleRenderer->draw(src, camera, rx, ry);
+        }
+    }
+    if (reduced)
+        lowRes->composite(sceneDepth, camera);
+    particleDrawTimer->end();
+
+    if (!anyOit)
+        return;
+
+    // OIT layers draw in pool order; the weights stand in for the sort
+    oitTimer->begin();
+    oit->begin(rx, ry);
+    for (unsigned int i = 0; i < emitterCount; i++) {
+        ParticleDrawSource src = particleSource(i);
+
+        if (usesOit(src.layer) && !(volumeFireOn && src.layer == LAYER_FIRE))
+            particleRenderer->draw(src, camera, rx, ry, oit->particleShader);
+    }
+    oit->end(rx, ry);
+    oit->composite();
+    oitTimer->end();
+}
+
+/**
+ * @brief Whether a particle layer is currently resolved with weighted blended OIT instead of a depth sort
+ */
+bool GG1_C6_Handler::usesOit(ParticleLayer layer) {
+    return layer != LAYER_EMBER && layerModes[layer] == TRANSPARENCY_OIT;
+}
+
+/**
+ * @brief Switches a layer between sorted and OIT rendering
+ */
+void GG1_C6_Handler::toggleTransparency(ParticleLayer layer) {
+    layerModes[layer] = layerModes[layer] == TRANSPARENCY_SORTED ? TRANSPARENCY_OIT : TRANSPARENCY_SORTED;
+    cout << (layer == LAYER_FIRE ? "fire" : "smoke") << " transparency: " << (layerModes[layer] == TRANSPARENCY_SORTED ? "sorted" : "OIT") << endl;
+}
+
+/**
+ * @brief Advances the clock, moves the camera and steps the scene objects
+ */
+void GG1_C6_Handler::objUpdateHandler() {
+    std::chrono::_V2::steady_clock::time_point now = std::chrono::steady_clock::now();
+    dt = std::chrono::duration<float>(now - lastT).count();
+    lastT = now;
+    elapsed += dt;
+    frame++;
+
+    // camera
+    int direction = NONE;
+    if (wDown) direction |= FORWARD;
+    if (sDown) direction |= BACKWARD;
+    if (aDown) direction |= LEFT;
+    if (dDown) direction |= RIGHT;
+    if (spDown) direction |= UP;
+    if (shDown) direction |= DOWN;
+    camera->updateKeyboard(direction, dt);
+    // mouse look while enter is held
+    if (enDown)
+        camera->updateMouse(relX, -relY);
+    relX = 0; relY = 0;
+
+    // lights follow the brightness and color of the flame footage, looked up in the flipbook's tables
+    fireLight->intensity = flameFlipbook.relativeLuminance(elapsed * flameFps);
+    fireLight->color = flameFlipbook.lightColor(elapsed * flameFps);
+    lights->write(fireLight);
+
+    // the pot swings on its chain over the fire
+    potTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0, 1.6f, 0));
+    potTransform = glm::rotate(potTransform, 0.25f * sinf(elapsed * 1.7f), glm::vec3(0, 0, 1));
+    potTransform = glm::translate(potTransform, glm::vec3(0, -0.5f, 0));
+    for (unsigned int i = 0; i < torchLights.size(); i++) {
+        float frame = elapsed * flameFps + torchPhases[i];
+        torchLights[i]->intensity = 0.3f * flameFlipbook.relativeLuminance(frame);
+        torchLights[i]->color = flameFlipbook.lightColor(frame);
+        lights->write(torchLights[i]);
+    }
+
+    // grid smoke; long frames are clamped so a hitch does not blow the advection apart
+    if (fluidOn) {
+        fluid->step(glm::min(dt, 1.0f / 30.0f));
+        smokeVolume->upload(fluid);
+    }
+
+    // particles: level of detail first, from where the camera is and what it looks at
+    float aspect = (float)kernel->getRX() / kernel->getRY();
+    if (backend == BACKEND_CPU)
+        particleLod->update(camera, aspect, particles->emitters);
+    else
+        particleLod->update(camera, aspect, gpuParticles->emitters);
+
+    if (backend == BACKEND_CPU) {
+        Timer timer;
+        particles->update(dt);
+        particleUpdateMs = timer.elapsedMs();
+
+        particleSortMs = 0.0;
+        particleUploadMs = 0.0;
+        for (unsigned int i = 0; i < particles->emitters.size(); i++) {
+            ParticlePool* pool = &particles->emitters[i]->pool;
+            const uint32_t* order = NULL;
+            // OIT layers skip the sort entirely
+            if (particleSorters[i] != NULL && !usesOit(particles->emitters[i]->desc.layer)) {
+                order = particleSorters[i]->sort(pool, camera->position, jobs);
+                particleSortMs += particleSorters[i]->lastMs;
+            }
+
+            timer.reset();
+            cpuParticleBuffers[i]->upload(pool, order);
+            cpuParticleBuffers[i]->slicing = particles->emitters[i]->drawSlicing();
+            particleUploadMs += timer.elapsedMs();
+        }
+    } else {
+        gpuSimTimer->begin();
+        gpuParticles->update(dt);
+        gpuSimTimer->end();
+    }
+
+    // frames per second, and stats once a second
+    fpsFrames++;
+    fpsTimer += dt;
+    if (fpsTimer >= 1.0f) {
+        curFPS = fpsFrames;
+        fpsFrames = 0;
+        fpsTimer -= 1.0f;
+        printStats();
+    }
+}
+
+/**
+ * @brief Runs immediately before the render loop
+ */
+void GG1_C6_Handler::objPreLoopStep() {
+    // GL objects need the context, which only exists once the kernel has started
+    particleRenderer = new ParticleRenderer("shaders/particle.vert", "shaders/particle.frag");
+    particleRenderer->setAtlas(textureFromFile("flame.png", "textures"), 8, 8);
+    if (flameFlipbook.import("textures/flame.png", 8, 8, FLIPBOOK_MAX_VERTICES))
+        particleRenderer->setFlipbook(&flameFlipbook);
+
+    // the log flames' surface, which the GPU emitters below upload as well
+    ground = createPlane(10.0f);
+    logMesh = createBox(glm::vec3(0.3f, 0.05f, 0.05f));
+    potMesh = createBox(glm::vec3(0.12f, 0.1f, 0.12f));
+    for (unsigned int i = 0; i < logTransforms.size(); i++)
+        logSurface->addMesh(*logMesh, logTransforms[i]);
+    logSurface->build();
+
+    const vector<float>& noiseTexels = noiseField->interleaved();
+    noiseTexture = createTexture3D(noiseField->params.size, GL_RGBA16F, GL_RGBA, GL_FLOAT, &noiseTexels[0]);
+
+    gpuParticles = new GpuParticleSystem("shaders/particle_emit.comp", "shaders/particle_simulate.comp");
+    gpuParticles->turbulenceTexture = noiseTexture;
+    unsigned int maxCapacity = 0;
+    for (unsigned int i = 0; i < particles->emitters.size(); i++) {
+        if (particles->emitters[i]->desc.capacity > maxCapacity)
+            maxCapacity = particles->emitters[i]->desc.capacity;
+        gpuParticles->addEmitter(particles->emitters[i]->desc);
+        cpuParticleBuffers.push_back(new CpuParticleBuffer(particles->emitters[i]->pool.maxCapacity));
+        gpuSortTimers.push_back(new GpuTimer());
+    }
+
+    gpuSorter = new GpuParticleSorter(maxCapacity);
+
+    gpuSimTimer = new GpuTimer();
+    particleDrawTimer = new GpuTimer();
+    oitTimer = new GpuTimer();
+    depthTimer = new GpuTimer();
+    hazeTimer = new GpuTimer();
+    bloomTimer = new GpuTimer();
+    clusterTimer = new GpuTimer();
+    sceneTimer = new GpuTimer();
+    shadowTimer = new GpuTimer();
+    smokeTimer = new GpuTimer();
+    volumeFireTimer = new GpuTimer();
+
+    sceneShader = new Shader("shaders/scene.vert", "shaders/scene.frag");
+    lights = new LightBuffer(256);
+    lights->add(fireLight);
+    lights->add(moonLight);
+    for (unsigned int i = 0; i < torchLights.size(); i++)
+        lights->add(torchLights[i]);
+    clusters = new LightClusters();
+    deferred = new DeferredRenderer(kernel->getRX(), kernel->getRY());
+    shadows = new ShadowAtlas();
+    shadows->addLight(fireLight);
+    for (unsigned int i = 0; i < torchLights.size(); i++)
+        shadows->addLight(torchLights[i]);
+
+    // CPU sparks collide with the static scene through a distance field baked from it here; the swinging pot is only in the GPU path's depth collision
+    sceneSdf = new SignedDistanceField();
+    sceneSdf->addMesh(*ground, glm::mat4(1.0f));
+    for (unsigned int i = 0; i < logTransforms.size(); i++)
+        sceneSdf->addMesh(*logMesh, logTransforms[i]);
+    sceneSdf->bake(0.1f, 0.5f, jobs);
+    particles->collisionField = sceneSdf;
+
+    // start the CPU emitters at steady state: one longest lifetime in, from a snapshot when one matches this scene
+    float warmSeconds = 0.0f;
+    for (unsigned int i = 0; i < particles->emitters.size(); i++)
+        warmSeconds = glm::max(warmSeconds, particles->emitters[i]->desc.lifeMax);
+    particles->warmStart("textures", warmSeconds);
+    sceneDepth = new SceneDepth(kernel->getRX(), kernel->getRY());
+    lowRes = new LowResParticlePass(kernel->getRX(), kernel->getRY());
+    hdr = new HdrTarget(kernel->getRX(), kernel->getRY());
+    haze = new HeatHaze(kernel->getRX(), kernel->getRY(), hdr->format);
+    haze->setNoise(noiseTexture);
+    bloom = new Bloom(kernel->getRX(), kernel->getRY());
+    // the fluid box sits on the ground, centered over the fire
+    smokeVolume = new SmokeVolume(fluid->size, glm::vec3(-1.2f, 0.0f, -1.2f), glm::vec3(1.2f, 2.4f, 1.2f));
+    for (unsigned int i = 0; i < particles->emitters.size() && volumeFire == NULL; i++)
+        if (particles->emitters[i]->desc.layer == LAYER_FIRE)
+            volumeFire = new VolumetricFire(kernel->getRX(), kernel->getRY(), particles->emitters[i]->desc, noiseField, noiseTexture);
+
+    // what the compact format saves in blend bandwidth, at window size
+    if (benchmarksOn) {
+        float compactGBs = HdrTarget::measureBandwidth(GL_R11F_G11F_B10F, kernel->getRX(), kernel->getRY());
+        float wideGBs = HdrTarget::measureBandwidth(GL_RGBA16F, kernel->getRX(), kernel->getRY());
+        cout << "HDR blend bandwidth: R11F_G11F_B10F " << compactGBs << " GB/s, RGBA16F " << wideGBs << " GB/s; "
+             << "per fullscreen blend pass " << 2.0f * 4 * kernel->getRX() * kernel->getRY() / (compactGBs * 1e6f) << " ms vs "
+             << 2.0f * 8 * kernel->getRX() * kernel->getRY() / (wideGBs * 1e6f) << " ms" << endl;
+    }
+
+    oit = new WeightedOit(kernel->getRX(), kernel->getRY());
+
+    if (benchmarksOn)
+        benchmarkRenderPaths();
+    cout << "render path: " << (renderPath == PATH_DEFERRED ? "deferred" : "forward") << " (set GG1C6_RENDER_PATH=deferred or forward)" << endl;
+    if (benchmarksOn) {
+        benchmarkFireRenderers();
+        benchmarkTransparency();
+    }
+
+    lastT = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief Prints frame rate and per-system timings to the console
+ */
+void GG1_C6_Handler::printStats() {
+    cout << "fps " << curFPS;
+    if (backend == BACKEND_CPU) {
+        cout << " | CPU particles " << particles->getParticleCount() << ": sim " << particleUpdateMs << " ms, sort " << particleSortMs << " ms, upload " << particleUploadMs << " ms";
+        // peak live / most ever held per pool, and the arena's high-water mark, for sizing both
+        cout << ", pools [";
+        for (unsigned int i = 0; i < particles->emitters.size(); i++)
+            cout << (i > 0 ? " " : "") << particles->emitters[i]->pool.peakCount << "/" << particles->emitters[i]->pool.maxCapacity;
+        cout << "] slab peak " << particleSlab->peak << "/" << particleSlab->capacity << ", " << particles->getSpawnFailures() << " spawns dropped";
+        if (particleSlab->failures > 0)
+            cout << " (" << particleSlab->failures << " slab misses)";
+    } else
+        cout << " | GPU particles: sim " << gpuSimTimer->getMs() << " ms, sort " << gpuSortMs << " ms (" << (gpuSorter->lastPath == GPU_SORT_BITONIC ? "bitonic" : "onesweep") << ")";
+    // on the GPU path the draw timer spans the sorts as well
+    float drawMs = particleDrawTimer->getMs() - (backend == BACKEND_GPU ? gpuSortMs : 0.0f);
+    int factorIndex = lowRes->factor == 4 ? 2 : lowRes->factor - 1;
+    drawMsByFactor[factorIndex] = drawMs;
+    cout << ", sorted draw " << drawMs << " ms at 1/" << lowRes->factor;
+    // time saved against the last full-resolution measurement
+    if (factorIndex > 0 && drawMsByFactor[0] > 0.0f)
+        cout << " (saves " << drawMsByFactor[0] - drawMs << " ms)";
+    if (usesOit(LAYER_FIRE) || usesOit(LAYER_SMOKE))
+        cout << ", OIT draw " << oitTimer->getMs() << " ms";
+    if (hazeOn)
+        cout << ", haze " << hazeTimer->getMs() << " ms";
+    if (bloomOn)
+        cout << ", bloom " << bloomTimer->getMs() << " ms";
+    cout << ", " << lights->getCount() << " lights ";
+    if (renderPath == PATH_FORWARD) {
+        float lightsPerCluster;
+        unsigned int maxPerCluster, fullClusters, droppedLights;
+        clusters->readStats(lightsPerCluster, maxPerCluster, fullClusters, droppedLights);
+        cout << "forward " << sceneTimer->getMs() << " ms (" << lightsPerCluster << " avg / " << maxPerCluster << " max per cluster";
+        if (fullClusters > 0)
+            cout << ", " << droppedLights << " lights dropped from " << fullClusters << " clusters over " << CLUSTER_MAX_LIGHTS;
+        cout << ", build " << clusterTimer->getMs() << " ms)";
+    } else
+        cout << "deferred " << sceneTimer->getMs() << " ms";
+    cout << ", shadows " << shadowTimer->getMs() << " ms (" << shadows->getShadowedCount() << " lights, " << shadows->staticRenders << " cached, " << shadows->dynamicRenders << " dynamic)";
+    if (fluidOn)
+        cout << ", fluid " << fluid->size << "^3 " << fluid->lastMs << " ms (advect " << fluid->advectMs << ", project " << fluid->projectMs << "), raymarch " << smokeTimer->getMs() << " ms";
+    if (volumeFireOn)
+        cout << ", volume fire " << volumeFireTimer->getMs() << " ms at 1/" << volumeFire->pass->factor << " (" << volumeFire->occupancy * 100.0f << "% of bounds occupied)";
+    if (softMode != SOFT_OFF || lowRes->factor > 1 || hazeOn || backend == BACKEND_GPU || fluidOn || volumeFireOn)
+        cout << ", depth resolve " << depthTimer->getMs() << " ms";
+    // how the particle budget was shared: granted / full-detail count per emitter, and frames per step when coarse
+    if (particleLod->enabled) {
+        cout << ", LOD " << particleLod->granted << "/" << particleLod->budget << " [";
+        for (unsigned int i = 0; i < particleLod->reports.size(); i++) {
+            const EmitterLodReport& r = particleLod->reports[i];
+            cout << (i > 0 ? " " : "") << r.granted << "/" << r.demand << (r.focused ? "*" : r.visible ? "" : " off");
+            if (r.interval > 1)
+                cout << " 1:" << r.interval;
+        }
+        cout << "]";
+    }
+    cout << " (fire " << (usesOit(LAYER_FIRE) ? "OIT" : "sorted") << ", smoke " << (usesOit(LAYER_SMOKE) ? "OIT" : "sorted") << ")" << endl;
+}
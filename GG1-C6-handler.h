@@ -10,10 +10,44 @@
 #define GG1_C6_HANDLER_H
 
 #include <chrono>
+#include <cstdlib>
+#include <cstring>
 
 #include "util/handler.h"
 #include "objects/helper.h"
-#include "objects/camera.h""
+#include "objects/camera.h"
+#include "objects/particles.h"
+#include "objects/particlelod.h"
+#include "objects/particlerenderer.h"
+#include "objects/gpuparticles.h"
+#include "objects/particlesort.h"
+#include "objects/gpusort.h"
+#include "objects/oit.h"
+#include "objects/depth.h"
+#include "objects/primitives.h"
+#include "objects/lowres.h"
+#include "objects/heathaze.h"
+#include "objects/bloom.h"
+#include "objects/hdr.h"
+#include "objects/lights.h"
+#include "objects/clusters.h"
+#include "objects/deferred.h"
+#include "objects/shadows.h"
+#include "objects/fluid.h"
+#include "objects/smokevolume.h"
+#include "objects/volumefire.h"
+#include "util/jobs/jobs.h"
+#include "util/timer.h"
+
+// What soft particles fade against
+enum SoftParticleMode {
+    SOFT_OFF=0, SOFT_FULL=1, SOFT_HALF=2
+};
+
+// Where particles are simulated
+enum ParticleBackend {
+    BACKEND_CPU=0, BACKEND_GPU=1
+};
 
 class GG1_C6_Handler : public Handler {
     public:
@@ -28,7 +62,10 @@ class GG1_C6_Handler : public Handler {
     private:
         int frame = 0;
         float dt = 0.0f;
+        float elapsed = 0.0f;
         int curFPS = 0;
+        int fpsFrames = 0;
+        float fpsTimer = 0.0f;
         std::chrono::_V2::steady_clock::time_point lastT;
 
         int relX, relY;
@@ -36,7 +73,92 @@ class GG1_C6_Handler : public Handler {
         Camera* camera;
 
         // scene objects
-        
+        Shader* sceneShader = NULL;
+        Mesh* ground = NULL;
+        Mesh* logMesh = NULL;
+        vector<glm::mat4> logTransforms;
+        EmissionSurface* logSurface = NULL;    // the logs' triangles, which the log flames spawn on
+        SignedDistanceField* sceneSdf = NULL;   // static scene, for CPU particle collision
+        Mesh* potMesh = NULL;               // swings over the fire; the scene's one dynamic shadow caster
+        glm::mat4 potTransform = glm::mat4(1.0f);
+        vector<glm::vec4> dynamicBounds = vector<glm::vec4>(1);    // bounding sphere of each dynamic caster, for the shadow atlas
+        SceneDepth* sceneDepth = NULL;
+        LightBuffer* lights = NULL;
+        PntLight* fireLight;
+        DirLight* moonLight;
+        vector<PntLight*> torchLights;      // small flickering flames scattered over the ground
+        vector<float> torchPhases;         // playback offset of each torch into the flame footage, in frames
+        Flipbook flameFlipbook;
+        float flameFps = 24.0f;             // playback rate of the flame footage that drives the lights
+        LightClusters* clusters = NULL;
+        DeferredRenderer* deferred = NULL;
+        ShadowAtlas* shadows = NULL;
+        glm::vec3 lightColor = glm::vec3(1.5f);                 // scene-wide light scale; point lights carry the flame's color themselves
+        glm::vec3 ambient = glm::vec3(0.03f, 0.03f, 0.04f);
+        RenderPath renderPath = PATH_FORWARD;
+        bool benchmarksOn = false;          // run the startup GPU benchmarks (GG1C6_BENCHMARK=1)
+        SoftParticleMode softMode = SOFT_HALF;
+
+        JobSystem* jobs;
+        NoiseField* noiseField = NULL;
+        unsigned int noiseTexture = 0;      // noiseField as an RGBA16F 3D texture: curl in rgb, noise in a
+        ParticleSlab* particleSlab = NULL;
+        ParticleSystem* particles;
+        ParticleLod* particleLod = NULL;
+        GpuParticleSystem* gpuParticles = NULL;
+        GpuParticleSorter* gpuSorter = NULL;
+        ParticleBackend backend = BACKEND_CPU;
+        ParticleRenderer* particleRenderer = NULL;
+        vector<CpuParticleBuffer*> cpuParticleBuffers;
+        vector<ParticleSorter*> particleSorters;    // per CPU emitter; null for layers that need no ordering
+        WeightedOit* oit = NULL;
+        LowResParticlePass* lowRes = NULL;
+        SmokeFluid* fluid = NULL;
+        SmokeVolume* smokeVolume = NULL;
+        bool fluidOn = false;
+        VolumetricFire* volumeFire = NULL;  // raymarched stand-in for the fire sprites
+        bool volumeFireOn = false;
+        HeatHaze* haze = NULL;
+        bool hazeOn = true;
+        Bloom* bloom = NULL;
+        bool bloomOn = true;
+        HdrTarget* hdr = NULL;
+        TransparencyMode layerModes[3] = {TRANSPARENCY_SORTED, TRANSPARENCY_SORTED, TRANSPARENCY_SORTED};    // per ParticleLayer; embers are additive and ignore this
+
+        // timings of the last frame, in milliseconds
+        double particleUpdateMs = 0.0;
+        double particleUploadMs = 0.0;
+        double particleSortMs = 0.0;
+        float gpuSortMs = 0.0f;
+        GpuTimer* gpuSimTimer = NULL;
+        vector<GpuTimer*> gpuSortTimers;    // per GPU emitter
+        GpuTimer* particleDrawTimer = NULL;
+        GpuTimer* oitTimer = NULL;
+        GpuTimer* depthTimer = NULL;
+        GpuTimer* hazeTimer = NULL;
+        GpuTimer* bloomTimer = NULL;
+        GpuTimer* clusterTimer = NULL;
+        GpuTimer* sceneTimer = NULL;
+        GpuTimer* shadowTimer = NULL;
+        GpuTimer* smokeTimer = NULL;
+        GpuTimer* volumeFireTimer = NULL;
+        float drawMsByFactor[3] = {0.0f, 0.0f, 0.0f};     // sorted particle draw at resolution factor 1, 2 and 4, as last measured
+
+        void drawScene(LightBuffer* sceneLights, RenderPath path);
+        void drawSceneGeometry(Shader* shader);
+        void drawShadowCasters(Shader* shader, bool dynamic);
+        void benchmarkRenderPaths();
+        void benchmarkFireRenderers();
+        void benchmarkTransparency();
+        void drawHaze();
+        void drawBloom();
+        void drawParticles();
+        unsigned int getEmitterCount();
+        ParticleDrawSource particleSource(unsigned int i);
+        bool usesOit(ParticleLayer layer);
+        void toggleTransparency(ParticleLayer layer);
+
+        void printStats();
 };
 
 #endif
@@ -0,0 +1,107 @@
+/**
+ * @file bloom.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Glow around bright fire. A compute pyramid: the scene is soft-thresholded into a half-resolution level and reduced level by level, then each level is blurred and added back up the chain. Both directions stage their footprint in shared memory, so no pass reads the full-resolution scene more than once
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <algorithm>
+
+#include "helper.h"
+#include "framebuffer.h"
+
+// Most pyramid levels, the first at half resolution
+#define BLOOM_MAX_LEVELS 6
+
+// Work group side of the pyramid passes (see shaders/bloom_down.comp)
+#define BLOOM_GROUP 8
+
+/**
+ * @brief Bloom pyramid and its passes. Usage per frame: apply() with the HDR scene texture, then add level 0 of the pyramid in the tonemapping resolve
+ */
+class Bloom {
+    public:
+        float threshold = 1.0f;     // brightness where glow starts
+        float knee = 0.5f;          // width of the soft transition around the threshold
+        float radius = 0.85f;       // share of each smaller level carried up the chain (wider glow when larger)
+        float intensity = 0.6f;     // scale applied when the pyramid is added to the scene
+        unsigned int pyramid;       // RGBA16F, levels at 1/2, 1/4, ... of the scene
+        int levels;
+
+        /**
+         * @brief Construct a new Bloom object
+         *
+         * @param rx Width of the scene in pixels
+         * @param ry Height of the scene in pixels
+         */
+        Bloom(int rx, int ry) {
+            downProgram = new ComputeShader("shaders/bloom_down.comp");
+            upProgram = new ComputeShader("shaders/bloom_up.comp");
+
+            width = (rx + 1) / 2;
+            height = (ry + 1) / 2;
+            levels = 1;
+            while (levels < BLOOM_MAX_LEVELS && (width >> levels) >= 2 && (height >> levels) >= 2)
+                levels++;
+            pyramid = createTexture2D(width, height, GL_RGBA16F, levels);
+        }
+
+        ~Bloom() {
+            glDeleteTextures(1, &pyramid);
+            delete downProgram;
+            delete upProgram;
+        }
+
+        /**
+         * @brief Rebuilds the pyramid from the scene
+         *
+         * @param scene Scene color texture (full resolution, single level)
+         */
+        void apply(unsigned int scene) {
+            downProgram->use();
+            downProgram->setInt("source", 0);
+            downProgram->setFloat("threshold", threshold);
+            downProgram->setFloat("knee", knee);
+            glActiveTexture(GL_TEXTURE0);
+
+            for (int level = 0; level < levels; level++) {
+                // level 0 prefilters the scene; every other level reduces the one above it
+                downProgram->setBool("prefilter", level == 0);
+                downProgram->setInt("sourceLod", level == 0 ? 0 : level - 1);
+                glBindTexture(GL_TEXTURE_2D, level == 0 ? scene : pyramid);
+                glBindImageTexture(0, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+                dispatchLevel(level);
+                glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            }
+
+            upProgram->use();
+            upProgram->setInt("source", 0);
+            upProgram->setFloat("radius", radius);
+            glBindTexture(GL_TEXTURE_2D, pyramid);
+            for (int level = levels - 2; level >= 0; level--) {
+                upProgram->setInt("sourceLod", level + 1);
+                glBindImageTexture(0, pyramid, level, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+                dispatchLevel(level);
+                glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+            }
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+    private:
+        int width, height;      // size of level 0
+        ComputeShader* downProgram;
+        ComputeShader* upProgram;
+
+        void dispatchLevel(int level) {
+            int w = std::max(width >> level, 1), h = std::max(height >> level, 1);
+            glDispatchCompute((w + BLOOM_GROUP - 1) / BLOOM_GROUP, (h + BLOOM_GROUP - 1) / BLOOM_GROUP, 1);
+        }
+};
+
+#endif
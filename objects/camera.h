@@ -41,6 +41,7 @@ class Camera {
 
         float yaw, pitch;
         float movementSpeed, mouseSens, zoom;
+        float nearPlane = 0.1f, farPlane = 100.0f;
 
         /**
          * @brief Construct a new Camera object
@@ -71,6 +72,16 @@ class Camera {
             return glm::lookAt(position, position + front, up);
         }
         
+        /**
+         * @brief Get the Projection Matrix of current camera, from its zoom (vertical FOV) and clip planes
+         * 
+         * @param aspect Viewport width over height
+         * @return glm::mat4 projection matrix
+         */
+        glm::mat4 getProjectionMatrix(float aspect) {
+            return glm::perspective(glm::radians(zoom), aspect, nearPlane, farPlane);
+        }
+
         /**
          * @brief Updates camera position based off of processed keyboard input. Accepts bitwise OR'd directions. Final direction is normalized to ensure constant velocity in each direction.
          * 
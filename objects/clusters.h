@@ -0,0 +1,128 @@
+/**
+ * @file clusters.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Clustered light assignment for many small lights. The view frustum is split into a grid of froxels (screen tiles by exponential depth slices), a compute pass lists the lights that can reach each one, and shading only evaluates the lights of its own froxel (see shaders/clusters.glsl)
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef CLUSTERS_H
+#define CLUSTERS_H
+
+#include "helper.h"
+#include "camera.h"
+#include "lights.h"
+
+// Froxel grid; the tile grid is the work group size of shaders/cluster_build.comp
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+
+// Lights kept per cluster (see MAX_LIGHTS in shaders/cluster_build.comp)
+#define CLUSTER_MAX_LIGHTS 64
+
+// SSBO bindings of the cluster ranges, light indices and build statistics
+#define CLUSTER_RANGES_BINDING 5
+#define CLUSTER_INDICES_BINDING 6
+#define CLUSTER_STATS_BINDING 7
+
+/**
+ * @brief Froxel grid buffers and the compute pass that fills them. Per frame: build() after the lights are flushed, then bind() and setUniforms() on every shader that includes clusters.glsl
+ */
+class LightClusters {
+    public:
+        float farPlane = 50.0f;     // depth covered by the slices; farther fragments use the last slice
+
+        LightClusters() {
+            buildProgram = new ComputeShader("shaders/cluster_build.comp");
+
+            glGenBuffers(1, &ranges);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, ranges);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, CLUSTER_COUNT * 2 * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+
+            glGenBuffers(1, &indices);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, indices);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, CLUSTER_COUNT * CLUSTER_MAX_LIGHTS * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+
+            glGenBuffers(1, &stats);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, stats);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, 5 * sizeof(uint32_t), NULL, GL_DYNAMIC_READ);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        ~LightClusters() {
+            glDeleteBuffers(1, &ranges);
+            glDeleteBuffers(1, &indices);
+            glDeleteBuffers(1, &stats);
+            delete buildProgram;
+        }
+
+        /**
+         * @brief Assigns every light to the clusters it can reach
+         *
+         * @param camera Camera the frame is drawn from
+         * @param aspect Viewport aspect ratio
+         * @param lights Lights, flushed and bound this frame
+         */
+        void build(Camera* camera, float aspect, LightBuffer* lights) {
+            uint32_t zero = 0;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, stats);
+            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+            glm::mat4 projection = camera->getProjectionMatrix(aspect);
+            buildProgram->use();
+            buildProgram->setMat4("view", camera->getViewMatrix());
+            buildProgram->setVec2("tanHalfFov", glm::vec2(1.0f / projection[0][0], 1.0f / projection[1][1]));
+            buildProgram->setFloat("clusterNear", camera->nearPlane);
+            buildProgram->setFloat("clusterFar", farPlane);
+            buildProgram->setInt("lightCount", lights->getCount());
+
+            bindBuffers();
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_STATS_BINDING, stats);
+            glDispatchCompute(1, 1, CLUSTER_Z);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+
+        // binds the cluster ranges and light indices for shading
+        void bindBuffers() {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_RANGES_BINDING, ranges);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_INDICES_BINDING, indices);
+        }
+
+        // sets the lookup uniforms of shaders/clusters.glsl
+        void setUniforms(Shader* shader, Camera* camera, int rx, int ry) {
+            shader->setIVec3("clusterGrid", CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+            shader->setFloat("clusterNear", camera->nearPlane);
+            shader->setFloat("clusterFar", farPlane);
+            shader->setVec2("viewportSize", glm::vec2(rx, ry));
+        }
+
+        /**
+         * @brief Reads back the statistics of the last build. Stalls until it is done, so call it rarely
+         *
+         * @param average Mean lights per cluster
+         * @param maximum Most lights in one cluster
+         * @param full Clusters reached by more than CLUSTER_MAX_LIGHTS lights
+         * @param dropped Lights left out of those clusters
+         */
+        void readStats(float& average, unsigned int& maximum, unsigned int& full, unsigned int& dropped) {
+            uint32_t values[5];
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, stats);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(values), values);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            maximum = values[1];
+            average = (float)values[2] / CLUSTER_COUNT;
+            full = values[3];
+            dropped = values[4];
+        }
+
+    private:
+        ComputeShader* buildProgram;
+        GLuint ranges, indices, stats;
+};
+
+#endif
@@ -0,0 +1,130 @@
+/**
+ * @file deferred.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Deferred shading path for light-heavy scenes. Opaque geometry is written once into a compact G-buffer, then a compute pass culls the lights per 16x16 screen tile and shades every pixel from its tile's list
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include "helper.h"
+#include "camera.h"
+#include "framebuffer.h"
+
+/* ----- G-BUFFER LAYOUT (12 bytes per pixel) ----- *\
+Attachment  Format              Contents
+color 0     RGBA8               albedo.rgb, roughness
+color 1     RG16                octahedral normal (shaders/octahedral.glsl)
+depth       DEPTH24_STENCIL8    window depth; position is rebuilt from it
+\* ------------------------------------------------ */
+
+// Screen tile of the light accumulation pass (see shaders/deferred_tiled.comp)
+#define DEFERRED_TILE 16
+
+// How opaque geometry is lit
+enum RenderPath {
+    PATH_FORWARD=0, PATH_DEFERRED=1
+};
+
+/**
+ * @brief G-buffer and the tiled lighting pass. Per frame: begin(), draw opaque geometry with geometryShader, then shade() lights it into the scene framebuffer
+ */
+class DeferredRenderer {
+    public:
+        Shader* geometryShader;     // writes the G-buffer; takes the scene vertex shader's uniforms plus albedo and roughness
+        RenderTarget* gbuffer;
+
+        /**
+         * @brief Construct a new DeferredRenderer object
+         *
+         * @param rx Width of the scene in pixels
+         * @param ry Height of the scene in pixels
+         */
+        DeferredRenderer(int rx, int ry) : rx(rx), ry(ry) {
+            geometryShader = new Shader("shaders/scene.vert", "shaders/gbuffer.frag");
+            lightingProgram = new ComputeShader("shaders/deferred_tiled.comp");
+            compositeShader = new Shader("shaders/fullscreen.vert", "shaders/deferred_composite.frag");
+
+            // same depth format as the HDR target, so depth can be blitted into the scene
+            gbuffer = new RenderTarget(rx, ry, {GL_RGBA8, GL_RG16}, GL_DEPTH24_STENCIL8);
+            lighting = createTexture2D(rx, ry, GL_RGBA16F);
+        }
+
+        ~DeferredRenderer() {
+            glDeleteTextures(1, &lighting);
+            delete gbuffer;
+            delete geometryShader;
+            delete lightingProgram;
+            delete compositeShader;
+        }
+
+        // binds and clears the G-buffer for the geometry pass
+        void begin() {
+            gbuffer->bind();
+            const float zero[4] = {0, 0, 0, 0};
+            glClearBufferfv(GL_COLOR, 0, zero);
+            glClearBufferfv(GL_COLOR, 1, zero);
+            glClear(GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+            glEnable(GL_DEPTH_TEST);
+        }
+
+        /**
+         * @brief Lights the G-buffer and writes the result, with its depth, into the scene framebuffer (left bound). The light SSBO must be bound
+         *
+         * @param camera Camera the G-buffer was drawn from
+         * @param lightCount Lights in the light buffer
+         * @param lightColor Shared tint of the lights
+         * @param ambient Ambient light
+         */
+        void shade(Camera* camera, int lightCount, glm::vec3 lightColor, glm::vec3 ambient) {
+            glm::mat4 view = camera->getViewMatrix();
+            glm::mat4 projection = camera->getProjectionMatrix((float)rx / (float)ry);
+
+            lightingProgram->use();
+            lightingProgram->setMat4("view", view);
+            lightingProgram->setMat4("invViewProjection", glm::inverse(projection * view));
+            lightingProgram->setVec2("tanHalfFov", glm::vec2(1.0f / projection[0][0], 1.0f / projection[1][1]));
+            lightingProgram->setFloat("nearPlane", camera->nearPlane);
+            lightingProgram->setFloat("farPlane", camera->farPlane);
+            lightingProgram->setVec3("eye", camera->position);
+            lightingProgram->setVec3("lightColor", lightColor);
+            lightingProgram->setVec3("ambient", ambient);
+            lightingProgram->setInt("lightCount", lightCount);
+
+            for (int i = 0; i < 2; i++) {
+                glActiveTexture(GL_TEXTURE0 + i);
+                glBindTexture(GL_TEXTURE_2D, gbuffer->colors[i]);
+            }
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, gbuffer->depth);
+            glBindImageTexture(0, lighting, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+            glDispatchCompute((rx + DEFERRED_TILE - 1) / DEFERRED_TILE, (ry + DEFERRED_TILE - 1) / DEFERRED_TILE, 1);
+            glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+            // later passes depth test against the opaque scene
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, gbuffer->fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, RenderTarget::sceneFbo());
+            glBlitFramebuffer(0, 0, rx, ry, 0, 0, rx, ry, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+            RenderTarget::bindScene(rx, ry);
+
+            compositeShader->use();
+            compositeShader->setInt("lighting", 0);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, lighting);
+            glDisable(GL_DEPTH_TEST);
+            drawFullscreenTriangle();
+            glEnable(GL_DEPTH_TEST);
+        }
+
+    private:
+        int rx, ry;
+        ComputeShader* lightingProgram;
+        Shader* compositeShader;
+        unsigned int lighting;      // RGBA16F lit color; alpha 0 where no geometry was drawn
+};
+
+#endif
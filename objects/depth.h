@@ -0,0 +1,96 @@
+/**
+ * @file depth.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Sampleable copies of the scene depth buffer, for effects that fade or test against opaque geometry (soft particles). Full-resolution raw depth is resolved with a blit; a half-resolution linear depth is reduced from it
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef DEPTH_H
+#define DEPTH_H
+
+#include "helper.h"
+#include "camera.h"
+#include "framebuffer.h"
+
+// Which resolved depth effects sample
+enum DepthResolution {
+    DEPTH_FULL=0, DEPTH_HALF=1
+};
+
+/**
+ * @brief Resolves the scene framebuffer's depth after the opaque pass. Resolve once per frame, before anything samples it
+ */
+class SceneDepth {
+    public:
+        RenderTarget* full;     // DEPTH24_STENCIL8, nonlinear window depth
+        RenderTarget* half;     // R32F, linear view depth (farthest of each 2x2 block)
+
+        /**
+         * @brief Construct a new SceneDepth object
+         *
+         * @param rx Width of the scene in pixels
+         * @param ry Height of the scene in pixels
+         */
+        SceneDepth(int rx, int ry) {
+            full = new RenderTarget(rx, ry, {}, GL_DEPTH24_STENCIL8);
+            half = new RenderTarget((rx + 1) / 2, (ry + 1) / 2, {GL_R32F});
+            setNearest(full->depth);
+            setNearest(half->colors[0]);
+
+            downsampleShader = new Shader("shaders/fullscreen.vert", "shaders/depth_downsample.frag");
+        }
+
+        ~SceneDepth() {
+            delete full;
+            delete half;
+            delete downsampleShader;
+        }
+
+        /**
+         * @brief Copies the scene framebuffer's depth, and rebuilds the half-resolution depth from it
+         *
+         * @param camera Camera the scene was drawn with (its planes linearize depth)
+         * @param rx Width of the scene in pixels
+         * @param ry Height of the scene in pixels
+         */
+        void resolve(Camera* camera, int rx, int ry) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, RenderTarget::sceneFbo());
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, full->fbo);
+            glBlitFramebuffer(0, 0, rx, ry, 0, 0, full->width, full->height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+            half->bind();
+            downsampleShader->use();
+            downsampleShader->setInt("depthTexture", 0);
+            downsampleShader->setFloat("nearPlane", camera->nearPlane);
+            downsampleShader->setFloat("farPlane", camera->farPlane);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, full->depth);
+
+            glDisable(GL_DEPTH_TEST);
+            drawFullscreenTriangle();
+            glEnable(GL_DEPTH_TEST);
+
+            RenderTarget::bindScene(rx, ry);
+        }
+
+        // texture sampled at a resolution; half-resolution depth is already linear
+        unsigned int texture(DepthResolution resolution) {
+            return resolution == DEPTH_HALF ? half->colors[0] : full->depth;
+        }
+
+    private:
+        Shader* downsampleShader;
+
+        // depth is never interpolated
+        static void setNearest(unsigned int texture) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+};
+
+#endif
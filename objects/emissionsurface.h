@@ -0,0 +1,349 @@
+/**
+ * @file emissionsurface.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Mesh surfaces that particles are emitted from, so models can burn. Triangles are picked in proportion to their area through an alias table, so each sample is O(1) however many triangles there are. Each triangle and its table column share one cache line, and samples are drawn in batches with a xoshiro128+ generator running in every SIMD lane
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef EMISSIONSURFACE_H
+#define EMISSIONSURFACE_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cmath>
+#include <cstring>
+#include <vector>
+using std::vector;
+
+#include <glm/glm.hpp>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SURFACE_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SURFACE_SIMD_WIDTH 4
+#else
+#define SURFACE_SIMD_WIDTH 1
+#endif
+
+// Floats per triangle record, on the CPU and in the packed GPU layout
+#define SURFACE_PACKED_FLOATS 16
+
+// SIMD vectors of samples whose triangle lookups are overlapped (AVX2 path)
+#define SURFACE_BATCH 8
+
+/**
+ * @brief One triangle and its alias table column, in one cache line. A sample reads the column it lands on, then the triangle it picks, so it touches at most two lines however large the mesh is
+ */
+struct alignas(64) SurfaceTriangle {
+    float corner[3];
+    float prob;                     // chance the column keeps this triangle
+    float edge1[3];
+    uint32_t alias;                 // the triangle it gives the rest to
+    float edge2[3];
+    float pad0;
+    float normal[3];
+    float pad1;
+};
+
+/**
+ * @brief xoshiro128+ with an independent state in every SIMD lane. Each call yields one uniform float per lane
+ */
+struct SurfaceRNG {
+    alignas(32) uint32_t s[4][SURFACE_SIMD_WIDTH];
+
+    SurfaceRNG(uint64_t seed = 1) {
+        // splitmix64 spreads one seed over every lane's state
+        uint64_t x = seed;
+        for (int l = 0; l < SURFACE_SIMD_WIDTH; l++) {
+            for (int w = 0; w < 4; w += 2) {
+                uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                z ^= z >> 31;
+                s[w][l] = (uint32_t)z;
+                s[w + 1][l] = (uint32_t)(z >> 32);
+            }
+        }
+    }
+
+#if SURFACE_SIMD_WIDTH == 8
+    // uniform floats in [0, 1), one per lane
+    __m256 next() {
+        __m256i s0 = _mm256_load_si256((const __m256i*)s[0]), s1 = _mm256_load_si256((const __m256i*)s[1]);
+        __m256i s2 = _mm256_load_si256((const __m256i*)s[2]), s3 = _mm256_load_si256((const __m256i*)s[3]);
+        __m256i result = _mm256_add_epi32(s0, s3);
+        __m256i t = _mm256_slli_epi32(s1, 9);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+        _mm256_store_si256((__m256i*)s[0], s0); _mm256_store_si256((__m256i*)s[1], s1);
+        _mm256_store_si256((__m256i*)s[2], s2); _mm256_store_si256((__m256i*)s[3], s3);
+        // the top 24 bits; the low bits of xoshiro+ are its weakest
+        return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(result, 8)), _mm256_set1_ps(1.0f / 16777216.0f));
+    }
+#elif SURFACE_SIMD_WIDTH == 4
+    // uniform floats in [0, 1), one per lane
+    __m128 next() {
+        __m128i s0 = _mm_load_si128((const __m128i*)s[0]), s1 = _mm_load_si128((const __m128i*)s[1]);
+        __m128i s2 = _mm_load_si128((const __m128i*)s[2]), s3 = _mm_load_si128((const __m128i*)s[3]);
+        __m128i result = _mm_add_epi32(s0, s3);
+        __m128i t = _mm_slli_epi32(s1, 9);
+        s2 = _mm_xor_si128(s2, s0);
+        s3 = _mm_xor_si128(s3, s1);
+        s1 = _mm_xor_si128(s1, s2);
+        s0 = _mm_xor_si128(s0, s3);
+        s2 = _mm_xor_si128(s2, t);
+        s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+        _mm_store_si128((__m128i*)s[0], s0); _mm_store_si128((__m128i*)s[1], s1);
+        _mm_store_si128((__m128i*)s[2], s2); _mm_store_si128((__m128i*)s[3], s3);
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+    }
+#endif
+
+    // writes SURFACE_SIMD_WIDTH uniform floats in [0, 1) to out
+    void next(float* out) {
+#if SURFACE_SIMD_WIDTH == 8
+        _mm256_storeu_ps(out, next());
+#elif SURFACE_SIMD_WIDTH == 4
+        _mm_storeu_ps(out, next());
+#else
+        uint32_t result = s[0][0] + s[3][0];
+        uint32_t t = s[1][0] << 9;
+        s[2][0] ^= s[0][0];
+        s[3][0] ^= s[1][0];
+        s[1][0] ^= s[2][0];
+        s[0][0] ^= s[3][0];
+        s[2][0] ^= t;
+        s[3][0] = (s[3][0] << 11) | (s[3][0] >> 21);
+        out[0] = (result >> 8) * (1.0f / 16777216.0f);
+#endif
+    }
+};
+
+/**
+ * @brief Triangles of one or more meshes, in world space, ready to be sampled uniformly by area. Usage: addMesh()/addModel(), then build()
+ */
+class EmissionSurface {
+    public:
+        unsigned int triangleCount = 0;
+        float area = 0.0f;                          // total surface area
+        glm::vec3 center = glm::vec3(0.0f);         // bounding sphere of the triangles
+        float radius = 0.0f;
+
+        /**
+         * @brief Adds the triangles of a mesh (anything with vertices[].position and indices, like Mesh)
+         *
+         * @param mesh Mesh to add
+         * @param transform Model matrix the mesh is drawn with
+         */
+        template <class MeshType>
+        void addMesh(const MeshType& mesh, const glm::mat4& transform) {
+            for (unsigned int i = 0; i + 2 < mesh.indices.size(); i += 3)
+                for (int c = 0; c < 3; c++)
+                    triangles.push_back(glm::vec3(transform * glm::vec4(mesh.vertices[mesh.indices[i + c]].position, 1.0f)));
+        }
+
+        /**
+         * @brief Adds every mesh of a model
+         *
+         * @param model Model to add
+         * @param transform Model matrix the model is drawn with
+         */
+        template <class ModelType>
+        void addModel(const ModelType& model, const glm::mat4& transform) {
+            for (unsigned int i = 0; i < model.meshes.size(); i++)
+                addMesh(model.meshes[i], transform);
+        }
+
+        /**
+         * @brief Builds the triangle records and the alias table (Vose's method) over the added triangles. The triangle list is released afterwards
+         */
+        void build() {
+            unsigned int n = triangles.size() / 3;
+            records.assign(n, SurfaceTriangle());
+
+            vector<double> areas(n);
+            double total = 0.0;
+            glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+            for (unsigned int t = 0; t < n; t++) {
+                glm::vec3 a = triangles[3 * t], e1 = triangles[3 * t + 1] - a, e2 = triangles[3 * t + 2] - a;
+                glm::vec3 c = glm::cross(e1, e2);
+                float len = glm::length(c);
+                glm::vec3 nrm = len > 0.0f ? c / len : glm::vec3(0, 1, 0);
+                SurfaceTriangle& r = records[t];
+                for (int k = 0; k < 3; k++) {
+                    r.corner[k] = a[k];
+                    r.edge1[k] = e1[k];
+                    r.edge2[k] = e2[k];
+                    r.normal[k] = nrm[k];
+                }
+                r.prob = 1.0f;
+                areas[t] = 0.5 * len;
+                total += areas[t];
+                for (int v = 0; v < 3; v++) {
+                    lo = glm::min(lo, triangles[3 * t + v]);
+                    hi = glm::max(hi, triangles[3 * t + v]);
+                }
+            }
+
+            // a surface with no area has nothing to emit from
+            triangleCount = total > 0.0 ? n : 0;
+            area = (float)total;
+            center = n > 0 ? (lo + hi) * 0.5f : glm::vec3(0.0f);
+            radius = n > 0 ? glm::length(hi - lo) * 0.5f : 0.0f;
+
+            // each column holds its own triangle with probability prob, and its alias otherwise
+            vector<double> scaled(n);
+            vector<uint32_t> small, large;
+            for (unsigned int t = 0; t < n; t++) {
+                records[t].alias = t;
+                scaled[t] = total > 0.0 ? areas[t] * n / total : 1.0;
+                (scaled[t] < 1.0 ? small : large).push_back(t);
+            }
+            while (!small.empty() && !large.empty()) {
+                uint32_t s = small.back(), l = large.back();
+                small.pop_back();
+                large.pop_back();
+                records[s].prob = (float)scaled[s];
+                records[s].alias = l;
+                scaled[l] -= 1.0 - scaled[s];
+                (scaled[l] < 1.0 ? small : large).push_back(l);
+            }
+            // whatever is left is 1 up to rounding
+            for (unsigned int i = 0; i < small.size(); i++)
+                records[small[i]].prob = 1.0f;
+            for (unsigned int i = 0; i < large.size(); i++)
+                records[large[i]].prob = 1.0f;
+
+            triangles.clear();
+            triangles.shrink_to_fit();
+        }
+
+        /**
+         * @brief Draws points uniformly over the surface, with the normals of the triangles they landed on. Vectorized with AVX2 gathers when available; otherwise the random numbers are drawn in SIMD and the lookups are scalar. Must not be called on an empty surface
+         *
+         * @param rng Generator to draw from
+         * @param count Points to draw
+         * @param px, py, pz Set to the points
+         * @param nx, ny, nz Set to their unit normals
+         */
+        void sample(SurfaceRNG& rng, size_t count, float* px, float* py, float* pz, float* nx, float* ny, float* nz) const {
+            size_t i = 0;
+
+#if SURFACE_SIMD_WIDTH == 8
+            const __m256 n = _mm256_set1_ps((float)triangleCount);
+            const __m256i last = _mm256_set1_epi32(triangleCount - 1);
+            const __m256 one = _mm256_set1_ps(1.0f);
+            const float* base = (const float*)&records[0];
+            float* out[2][3] = {{px, py, pz}, {nx, ny, nz}};
+
+            // batches of SURFACE_BATCH vectors, in three passes, so the cache misses of a whole batch are in flight together
+            // on meshes too large for the cache: columns are drawn and prefetched, then resolved against their alias and the
+            // picked triangles prefetched, and only then are the triangles read
+            alignas(32) float u[SURFACE_BATCH][3][8];
+            alignas(32) int picked[SURFACE_BATCH][8];
+            for (; i + SURFACE_BATCH * 8 <= count; i += SURFACE_BATCH * 8) {
+                for (int b = 0; b < SURFACE_BATCH; b++) {
+                    __m256i t = _mm256_min_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(rng.next(), n)), last);
+                    _mm256_store_si256((__m256i*)picked[b], t);
+                    for (int k = 0; k < 3; k++)
+                        _mm256_store_ps(u[b][k], rng.next());
+                    for (int l = 0; l < 8; l++)
+                        _mm_prefetch((const char*)&records[picked[b][l]], _MM_HINT_T0);
+                }
+
+                // its own triangle or its alias (gathers index floats, so a triangle's record starts at t * 16)
+                for (int b = 0; b < SURFACE_BATCH; b++) {
+                    __m256i t = _mm256_load_si256((const __m256i*)picked[b]);
+                    __m256i rec = _mm256_slli_epi32(t, 4);
+                    __m256 keep = _mm256_cmp_ps(_mm256_load_ps(u[b][0]), _mm256_i32gather_ps(base + 3, rec, 4), _CMP_LT_OQ);
+                    __m256i alt = _mm256_i32gather_epi32((const int*)(base + 7), rec, 4);
+                    t = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(alt), _mm256_castsi256_ps(t), keep));
+                    _mm256_store_si256((__m256i*)picked[b], t);
+                    for (int l = 0; l < 8; l++)
+                        _mm_prefetch((const char*)&records[picked[b][l]], _MM_HINT_T0);
+                }
+
+                for (int b = 0; b < SURFACE_BATCH; b++) {
+                    __m256i rec = _mm256_slli_epi32(_mm256_load_si256((const __m256i*)picked[b]), 4);
+
+                    // fold the unit square onto the triangle
+                    __m256 u2 = _mm256_load_ps(u[b][1]), u3 = _mm256_load_ps(u[b][2]);
+                    __m256 fold = _mm256_cmp_ps(_mm256_add_ps(u2, u3), one, _CMP_GT_OQ);
+                    u2 = _mm256_blendv_ps(u2, _mm256_sub_ps(one, u2), fold);
+                    u3 = _mm256_blendv_ps(u3, _mm256_sub_ps(one, u3), fold);
+
+                    size_t o = i + b * 8;
+                    for (int k = 0; k < 3; k++) {
+                        __m256 p = _mm256_i32gather_ps(base + k, rec, 4);
+                        p = _mm256_add_ps(p, _mm256_mul_ps(_mm256_i32gather_ps(base + 4 + k, rec, 4), u2));
+                        p = _mm256_add_ps(p, _mm256_mul_ps(_mm256_i32gather_ps(base + 8 + k, rec, 4), u3));
+                        _mm256_storeu_ps(out[0][k] + o, p);
+                        _mm256_storeu_ps(out[1][k] + o, _mm256_i32gather_ps(base + 12 + k, rec, 4));
+                    }
+                }
+            }
+#endif
+
+            // one SIMD batch of random numbers at a time; lanes past count are drawn and dropped
+            for (; i < count; i += SURFACE_SIMD_WIDTH) {
+                float u[4][SURFACE_SIMD_WIDTH];
+                for (int k = 0; k < 4; k++)
+                    rng.next(u[k]);
+                size_t lanes = count - i < SURFACE_SIMD_WIDTH ? count - i : SURFACE_SIMD_WIDTH;
+                for (size_t l = 0; l < lanes; l++)
+                    sampleOne(u[0][l], u[1][l], u[2][l], u[3][l], i + l, px, py, pz, nx, ny, nz);
+            }
+        }
+
+        /**
+         * @brief Packs the triangles and the alias table for a shader storage buffer: the records as they are, per triangle vec4(corner, prob), vec4(edge1, alias bits), vec4(edge2, 0), vec4(normal, 0)
+         */
+        vector<float> packed() const {
+            vector<float> data((size_t)triangleCount * SURFACE_PACKED_FLOATS, 0.0f);
+            if (triangleCount > 0)
+                memcpy(&data[0], &records[0], data.size() * sizeof(float));
+            return data;
+        }
+
+        // the triangle records, for hashing; empty until build()
+        const vector<SurfaceTriangle>& getRecords() const {
+            return records;
+        }
+
+    private:
+        vector<glm::vec3> triangles;    // corners of the added triangles, until build()
+
+        vector<SurfaceTriangle> records;
+
+        // scalar version of one lane of sample()
+        void sampleOne(float u0, float u1, float u2, float u3, size_t i, float* px, float* py, float* pz, float* nx, float* ny, float* nz) const {
+            unsigned int t = (unsigned int)(u0 * (float)triangleCount);
+            if (t > triangleCount - 1)
+                t = triangleCount - 1;
+            if (!(u1 < records[t].prob))
+                t = records[t].alias;
+            if (u2 + u3 > 1.0f) {
+                u2 = 1.0f - u2;
+                u3 = 1.0f - u3;
+            }
+            const SurfaceTriangle& r = records[t];
+            px[i] = r.corner[0] + r.edge1[0] * u2 + r.edge2[0] * u3;
+            py[i] = r.corner[1] + r.edge1[1] * u2 + r.edge2[1] * u3;
+            pz[i] = r.corner[2] + r.edge1[2] * u2 + r.edge2[2] * u3;
+            nx[i] = r.normal[0];
+            ny[i] = r.normal[1];
+            nz[i] = r.normal[2];
+        }
+};
+
+#endif
@@ -0,0 +1,357 @@
+/**
+ * @file flipbook.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Trimmed sprite outlines and light tables for flipbook atlases. At import, each frame's non-transparent pixels are wrapped in a tight convex polygon of 4 to 8 vertices, so sprites rasterize that polygon instead of a mostly transparent quad, and the light each frame gives off is measured so lights can follow the footage. Both are cached in a small binary file next to the atlas
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef FLIPBOOK_H
+#define FLIPBOOK_H
+
+#include <cstdint>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <string>
+using std::vector;
+using std::string;
+
+#include <SDL2/SDL_image.h>
+#include <glm/glm.hpp>
+
+// Bounds on the vertices of a trimmed outline
+#define FLIPBOOK_MIN_VERTICES 4
+#define FLIPBOOK_MAX_VERTICES 8
+
+// Cache file header
+#define FLIPBOOK_MAGIC 0x42504c46u     // "FLPB"
+#define FLIPBOOK_VERSION 2u
+
+/**
+ * @brief Convex outlines of every frame of an atlas, in sprite corner space ([-1, 1] on both axes, y up, as in shaders/particle.vert). Every frame has the same vertex count (short outlines repeat their last vertex), so one sprite is always a fan of vertexCount - 2 triangles
+ */
+class Flipbook {
+    public:
+        int cols = 1, rows = 1;
+        int vertexCount = 0;
+        vector<glm::vec2> vertices;     // vertexCount per frame, counterclockwise, frames row-major from the top left
+        float coverage = 1.0f;          // mean outline area as a fraction of the full quad
+        vector<float> luminance;        // mean linear luminance of each frame, alpha weighted, over the whole frame
+        vector<glm::vec2> chromaticity; // mean (r, g) / (r + g + b) of each frame's emitted light; b is the remainder
+        float meanLuminance = 0.0f;     // luminance averaged over all frames
+
+        int frameCount() { return cols * rows; }
+
+        /**
+         * @brief Builds the outlines and light tables of an RGBA8 atlas
+         *
+         * @param rgba Pixels, rows top to bottom, 4 bytes per pixel with alpha last
+         * @param width Atlas width in pixels
+         * @param height Atlas height in pixels
+         * @param pitch Bytes per row
+         * @param cols Frames across
+         * @param rows Frames down
+         * @param maxVertices Vertices per outline, clamped to [FLIPBOOK_MIN_VERTICES, FLIPBOOK_MAX_VERTICES]
+         * @param alphaThreshold Pixels with alpha above this are kept inside the outline. Defaults to 0
+         */
+        void build(const uint8_t* rgba, int width, int height, int pitch, int cols, int rows, int maxVertices, uint8_t alphaThreshold = 0) {
+            this->cols = cols;
+            this->rows = rows;
+            vertexCount = std::min(std::max(maxVertices, FLIPBOOK_MIN_VERTICES), FLIPBOOK_MAX_VERTICES);
+            vertices.assign(cols * rows * vertexCount, glm::vec2(0.0f));
+
+            int fw = width / cols, fh = height / rows;
+            double area = 0.0;
+            for (int f = 0; f < cols * rows; f++) {
+                int x0 = (f % cols) * fw, y0 = (f / cols) * fh;
+
+                // the outer corners of the first and last covered pixel of each row bound the frame's coverage
+                vector<glm::vec2> points;
+                for (int y = 0; y < fh; y++) {
+                    const uint8_t* row = rgba + (size_t)(y0 + y) * pitch + x0 * 4;
+                    int first = -1, last = -1;
+                    for (int x = 0; x < fw; x++) {
+                        if (row[x * 4 + 3] > alphaThreshold) {
+                            if (first < 0)
+                                first = x;
+                            last = x;
+                        }
+                    }
+                    if (first < 0)
+                        continue;
+                    points.push_back(toCorner(first, y, fw, fh));
+                    points.push_back(toCorner(first, y + 1, fw, fh));
+                    points.push_back(toCorner(last + 1, y, fw, fh));
+                    points.push_back(toCorner(last + 1, y + 1, fw, fh));
+                }
+
+                // fully transparent frames keep a degenerate outline and draw nothing
+                if (points.empty())
+                    continue;
+
+                vector<glm::vec2> outline = convexHull(points);
+                if (!reduce(outline, vertexCount))
+                    outline = {glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1)};
+
+                area += polygonArea(outline);
+                for (int i = 0; i < vertexCount; i++)
+                    vertices[f * vertexCount + i] = outline[std::min(i, (int)outline.size() - 1)];
+            }
+            coverage = (float)(area / (4.0 * cols * rows));
+
+            measureLight(rgba, width, height, pitch);
+        }
+
+        /**
+         * @brief Luminance of the footage relative to its mean, at a playback position. O(1), interpolating between frames
+         *
+         * @param frame Playback position in frames; wraps around the flipbook
+         * @return float 1 on average, or exactly 1 without a light table
+         */
+        float relativeLuminance(float frame) {
+            if (luminance.empty() || meanLuminance <= 0.0f)
+                return 1.0f;
+            int f0, f1;
+            float t = framePair(frame, f0, f1);
+            return (luminance[f0] + (luminance[f1] - luminance[f0]) * t) / meanLuminance;
+        }
+
+        /**
+         * @brief Color of the footage's light at a playback position, scaled to unit luminance. O(1), interpolating between frames
+         *
+         * @param frame Playback position in frames; wraps around the flipbook
+         * @return glm::vec3 linear RGB, or white without a light table
+         */
+        glm::vec3 lightColor(float frame) {
+            if (chromaticity.empty())
+                return glm::vec3(1.0f);
+            int f0, f1;
+            float t = framePair(frame, f0, f1);
+            glm::vec2 c = chromaticity[f0] + (chromaticity[f1] - chromaticity[f0]) * t;
+            glm::vec3 rgb(c.x, c.y, 1.0f - c.x - c.y);
+            float y = 0.2126f * rgb.x + 0.7152f * rgb.y + 0.0722f * rgb.z;
+            return y > 0.0f ? rgb / y : glm::vec3(1.0f);
+        }
+
+        /**
+         * @brief Writes the outlines and light tables to a cache file
+         *
+         * @return bool representing the success of the operation
+         */
+        bool save(const string& path) {
+            FILE* file = fopen(path.c_str(), "wb");
+            if (file == NULL)
+                return false;
+            uint32_t header[6] = {FLIPBOOK_MAGIC, FLIPBOOK_VERSION, (uint32_t)cols, (uint32_t)rows, (uint32_t)vertexCount, 0};
+            memcpy(&header[5], &coverage, sizeof(float));
+            bool ok = fwrite(header, sizeof(header), 1, file) == 1
+                   && fwrite(&vertices[0], sizeof(glm::vec2), vertices.size(), file) == vertices.size()
+                   && fwrite(&luminance[0], sizeof(float), luminance.size(), file) == luminance.size()
+                   && fwrite(&chromaticity[0], sizeof(glm::vec2), chromaticity.size(), file) == chromaticity.size();
+            fclose(file);
+            return ok;
+        }
+
+        /**
+         * @brief Reads outlines and light tables from a cache file, if it exists and was built with the same grid and vertex count
+         *
+         * @return bool representing the success of the operation
+         */
+        bool load(const string& path, int cols, int rows, int maxVertices) {
+            FILE* file = fopen(path.c_str(), "rb");
+            if (file == NULL)
+                return false;
+
+            int count = std::min(std::max(maxVertices, FLIPBOOK_MIN_VERTICES), FLIPBOOK_MAX_VERTICES);
+            uint32_t header[6];
+            bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == FLIPBOOK_MAGIC && header[1] == FLIPBOOK_VERSION
+                   && header[2] == (uint32_t)cols && header[3] == (uint32_t)rows && header[4] == (uint32_t)count;
+            if (ok) {
+                this->cols = cols;
+                this->rows = rows;
+                vertexCount = count;
+                memcpy(&coverage, &header[5], sizeof(float));
+                vertices.resize(cols * rows * count);
+                luminance.resize(cols * rows);
+                chromaticity.resize(cols * rows);
+                ok = fread(&vertices[0], sizeof(glm::vec2), vertices.size(), file) == vertices.size()
+                  && fread(&luminance[0], sizeof(float), luminance.size(), file) == luminance.size()
+                  && fread(&chromaticity[0], sizeof(glm::vec2), chromaticity.size(), file) == chromaticity.size();
+                meanLuminance = 0.0f;
+                for (unsigned int f = 0; f < luminance.size(); f++)
+                    meanLuminance += luminance[f] / luminance.size();
+            }
+            fclose(file);
+            return ok;
+        }
+
+        /**
+         * @brief Loads the outlines and light tables of an atlas from its cache (path + ".trim"), building and caching them from the image if needed. Prints the fill saved
+         *
+         * @return bool representing the success of the operation
+         */
+        bool import(const string& path, int cols, int rows, int maxVertices, uint8_t alphaThreshold = 0) {
+            string cache = path + ".trim";
+            if (!load(cache, cols, rows, maxVertices)) {
+                SDL_Surface* surf = IMG_Load(path.c_str());
+                if (surf == NULL) {
+                    std::cout << "Flipbook failed to load at path: " << path << std::endl;
+                    return false;
+                }
+                SDL_Surface* converted = SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_RGBA32, 0);
+                SDL_FreeSurface(surf);
+                if (converted == NULL)
+                    return false;
+
+                SDL_LockSurface(converted);
+                build((const uint8_t*)converted->pixels, converted->w, converted->h, converted->pitch, cols, rows, maxVertices, alphaThreshold);
+                SDL_UnlockSurface(converted);
+                SDL_FreeSurface(converted);
+
+                if (!save(cache))
+                    std::cout << "Flipbook could not write cache: " << cache << std::endl;
+            }
+
+            std::cout << "flipbook " << path << ": " << frameCount() << " frames, " << vertexCount << "-gon outlines cover "
+                      << coverage * 100.0f << "% of the quad (" << (1.0f - coverage) * 100.0f << "% less overdraw), mean luminance " << meanLuminance << std::endl;
+            return true;
+        }
+
+    private:
+        /**
+         * @brief Fills the light tables: the mean of each frame's sRGB-decoded color weighted by alpha, which is the light the frame adds under premultiplied blending
+         */
+        void measureLight(const uint8_t* rgba, int width, int height, int pitch) {
+            float linear[256];
+            for (int i = 0; i < 256; i++) {
+                float c = i / 255.0f;
+                linear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+            }
+
+            int fw = width / cols, fh = height / rows;
+            luminance.assign(cols * rows, 0.0f);
+            chromaticity.assign(cols * rows, glm::vec2(1.0f / 3.0f));
+            meanLuminance = 0.0f;
+            for (int f = 0; f < cols * rows; f++) {
+                int x0 = (f % cols) * fw, y0 = (f / cols) * fh;
+                double r = 0.0, g = 0.0, b = 0.0;
+                for (int y = 0; y < fh; y++) {
+                    const uint8_t* row = rgba + (size_t)(y0 + y) * pitch + x0 * 4;
+                    for (int x = 0; x < fw; x++) {
+                        float a = row[x * 4 + 3] / 255.0f;
+                        r += linear[row[x * 4]] * a;
+                        g += linear[row[x * 4 + 1]] * a;
+                        b += linear[row[x * 4 + 2]] * a;
+                    }
+                }
+                double pixels = (double)fw * fh, sum = r + g + b;
+                luminance[f] = (float)((0.2126 * r + 0.7152 * g + 0.0722 * b) / pixels);
+                if (sum > 0.0)
+                    chromaticity[f] = glm::vec2((float)(r / sum), (float)(g / sum));
+                meanLuminance += luminance[f] / (cols * rows);
+            }
+        }
+
+        // the frames either side of a wrapped playback position, and the blend between them
+        float framePair(float frame, int& f0, int& f1) {
+            int count = frameCount();
+            float wrapped = fmodf(frame, (float)count);
+            if (wrapped < 0.0f)
+                wrapped += count;
+            f0 = std::min((int)wrapped, count - 1);
+            f1 = (f0 + 1) % count;
+            return wrapped - f0;
+        }
+
+        static float cross(glm::vec2 a, glm::vec2 b) {
+            return a.x * b.y - a.y * b.x;
+        }
+
+        // pixel-edge coordinates of a frame (origin top left, y down) to corner space
+        static glm::vec2 toCorner(int x, int y, int fw, int fh) {
+            return glm::vec2((float)x / fw * 2.0f - 1.0f, 1.0f - (float)y / fh * 2.0f);
+        }
+
+        static float polygonArea(const vector<glm::vec2>& poly) {
+            float a = 0.0f;
+            for (unsigned int i = 0; i < poly.size(); i++)
+                a += cross(poly[i], poly[(i + 1) % poly.size()]);
+            return 0.5f * a;
+        }
+
+        // counterclockwise convex hull (monotone chain), without collinear points
+        static vector<glm::vec2> convexHull(vector<glm::vec2> points) {
+            std::sort(points.begin(), points.end(), [](glm::vec2 a, glm::vec2 b) {
+                return a.x < b.x || (a.x == b.x && a.y < b.y);
+            });
+            points.erase(std::unique(points.begin(), points.end()), points.end());
+            if (points.size() < 3)
+                return points;
+
+            vector<glm::vec2> hull(2 * points.size());
+            int k = 0;
+            for (unsigned int i = 0; i < points.size(); i++) {
+                while (k >= 2 && cross(hull[k - 1] - hull[k - 2], points[i] - hull[k - 2]) <= 0.0f)
+                    k--;
+                hull[k++] = points[i];
+            }
+            for (int i = (int)points.size() - 2, lower = k + 1; i >= 0; i--) {
+                while (k >= lower && cross(hull[k - 1] - hull[k - 2], points[i] - hull[k - 2]) <= 0.0f)
+                    k--;
+                hull[k++] = points[i];
+            }
+            hull.resize(k - 1);
+            return hull;
+        }
+
+        /**
+         * @brief Cuts a convex outline down to at most n vertices while still containing it. Each step removes the edge whose neighbours, extended to meet, add the least area, as long as the meeting point stays inside the frame
+         *
+         * @return false if no edge could be removed (the caller falls back to the full quad)
+         */
+        static bool reduce(vector<glm::vec2>& poly, int n) {
+            while ((int)poly.size() > n) {
+                int count = poly.size();
+                int best = -1;
+                float bestArea = INFINITY;
+                glm::vec2 bestPoint;
+                for (int i = 0; i < count; i++) {
+                    glm::vec2 a = poly[i], b = poly[(i + 1) % count];
+                    glm::vec2 d0 = a - poly[(i + count - 1) % count];
+                    glm::vec2 d1 = poly[(i + 2) % count] - b;
+
+                    // the neighbouring edges only meet beyond this one if they converge
+                    float denom = cross(d0, d1);
+                    if (denom <= 1e-9f)
+                        continue;
+                    float t = cross(b - a, d1) / denom;
+                    if (t < 0.0f)
+                        continue;
+                    glm::vec2 p = a + d0 * t;
+                    if (fabsf(p.x) > 1.0001f || fabsf(p.y) > 1.0001f)
+                        continue;
+
+                    float added = 0.5f * fabsf(cross(b - a, p - a));
+                    if (added < bestArea) {
+                        bestArea = added;
+                        best = i;
+                        bestPoint = p;
+                    }
+                }
+                if (best < 0)
+                    return false;
+
+                poly[best] = glm::clamp(bestPoint, glm::vec2(-1.0f), glm::vec2(1.0f));
+                poly.erase(poly.begin() + (best + 1) % count);
+            }
+            return true;
+        }
+};
+
+#endif
@@ -0,0 +1,409 @@
+/**
+ * @file fluid.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Stable-fluids smoke on the CPU (Stam 1999, with Fedkiw et al. 2001's vorticity confinement). Density, temperature and velocity live on a fixed cubic grid; every step adds sources and buoyancy, confines vorticity, advects semi-Lagrangian, and projects with red-black Gauss-Seidel. Kernels run on AVX2/SSE (scalar fallback), tiled into z slabs across a JobSystem
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef FLUID_H
+#define FLUID_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+using std::vector;
+
+#include <glm/glm.hpp>
+
+#include "../util/jobs/jobs.h"
+#include "../util/timer.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FLUID_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FLUID_SIMD_WIDTH 4
+#else
+#define FLUID_SIMD_WIDTH 1
+#endif
+
+// Thin wrappers over one SIMD register of cells along x, so each kernel is written once for every width
+#if FLUID_SIMD_WIDTH == 8
+typedef __m256 FluidVec;
+inline FluidVec fvLoad(const float* p) { return _mm256_loadu_ps(p); }
+inline void fvStore(float* p, FluidVec v) { _mm256_storeu_ps(p, v); }
+inline FluidVec fvSet(float x) { return _mm256_set1_ps(x); }
+inline FluidVec fvAdd(FluidVec a, FluidVec b) { return _mm256_add_ps(a, b); }
+inline FluidVec fvSub(FluidVec a, FluidVec b) { return _mm256_sub_ps(a, b); }
+inline FluidVec fvMul(FluidVec a, FluidVec b) { return _mm256_mul_ps(a, b); }
+inline FluidVec fvDiv(FluidVec a, FluidVec b) { return _mm256_div_ps(a, b); }
+inline FluidVec fvSqrt(FluidVec a) { return _mm256_sqrt_ps(a); }
+inline FluidVec fvSelect(FluidVec mask, FluidVec a, FluidVec b) { return _mm256_blendv_ps(a, b, mask); }
+// lanes whose x index is even / odd
+inline FluidVec fvParityMask(int parity) { return _mm256_castsi256_ps(parity ? _mm256_set_epi32(-1, 0, -1, 0, -1, 0, -1, 0) : _mm256_set_epi32(0, -1, 0, -1, 0, -1, 0, -1)); }
+#elif FLUID_SIMD_WIDTH == 4
+typedef __m128 FluidVec;
+inline FluidVec fvLoad(const float* p) { return _mm_loadu_ps(p); }
+inline void fvStore(float* p, FluidVec v) { _mm_storeu_ps(p, v); }
+inline FluidVec fvSet(float x) { return _mm_set1_ps(x); }
+inline FluidVec fvAdd(FluidVec a, FluidVec b) { return _mm_add_ps(a, b); }
+inline FluidVec fvSub(FluidVec a, FluidVec b) { return _mm_sub_ps(a, b); }
+inline FluidVec fvMul(FluidVec a, FluidVec b) { return _mm_mul_ps(a, b); }
+inline FluidVec fvDiv(FluidVec a, FluidVec b) { return _mm_div_ps(a, b); }
+inline FluidVec fvSqrt(FluidVec a) { return _mm_sqrt_ps(a); }
+inline FluidVec fvSelect(FluidVec mask, FluidVec a, FluidVec b) { return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a)); }
+inline FluidVec fvParityMask(int parity) { return _mm_castsi128_ps(parity ? _mm_set_epi32(-1, 0, -1, 0) : _mm_set_epi32(0, -1, 0, -1)); }
+#else
+typedef float FluidVec;
+inline FluidVec fvLoad(const float* p) { return *p; }
+inline void fvStore(float* p, FluidVec v) { *p = v; }
+inline FluidVec fvSet(float x) { return x; }
+inline FluidVec fvAdd(FluidVec a, FluidVec b) { return a + b; }
+inline FluidVec fvSub(FluidVec a, FluidVec b) { return a - b; }
+inline FluidVec fvMul(FluidVec a, FluidVec b) { return a * b; }
+inline FluidVec fvDiv(FluidVec a, FluidVec b) { return a / b; }
+inline FluidVec fvSqrt(FluidVec a) { return sqrtf(a); }
+inline FluidVec fvSelect(FluidVec mask, FluidVec a, FluidVec b) { return mask != 0.0f ? b : a; }
+inline FluidVec fvParityMask(int parity) { return parity ? 0.0f : 1.0f; }
+#endif
+
+/**
+ * @brief Smoke over a size^3 grid of unit cells, with one ghost layer on every side. Ghost cells hold zero velocity, density and pressure: the box is open, and smoke leaves through its faces. Usage: step(dt) per frame, then copyDensity() for rendering
+ */
+class SmokeFluid {
+    public:
+        int size;                           // cells per side, a multiple of the SIMD width
+        float vorticity = 0.3f;             // confinement strength
+        float buoyancy = 0.6f;              // upward acceleration per unit temperature, in box heights / s^2
+        float weight = 0.05f;               // downward acceleration per unit density, in box heights / s^2
+        float densityDecay = 0.25f;         // fraction of density lost per second
+        float cooling = 1.0f;               // fraction of temperature lost per second
+        glm::vec3 source = glm::vec3(0.5f, 0.08f, 0.5f);    // center of the source, as a fraction of the box
+        float sourceRadius = 0.07f;         // as a fraction of the box
+        float sourceDensity = 3.0f;         // added per second at the source's center
+        float sourceHeat = 4.0f;
+        int pressureIterations = 24;        // red-black sweeps per step; the previous step's pressure is the first guess
+
+        // timings of the last step, in milliseconds
+        double lastMs = 0.0, forceMs = 0.0, advectMs = 0.0, projectMs = 0.0;
+
+        /**
+         * @brief Construct a new SmokeFluid object, at rest and empty
+         *
+         * @param size Cells per side; rounded up to a multiple of the SIMD width
+         * @param jobs Job system to run on
+         */
+        SmokeFluid(int size, JobSystem* jobs) : jobs(jobs) {
+            this->size = (size + FLUID_SIMD_WIDTH - 1) / FLUID_SIMD_WIDTH * FLUID_SIMD_WIDTH;
+            stride = this->size + 2;
+            cells = (size_t)stride * stride * stride;
+            vector<float>* fields[] = {&density, &temperature, &u, &v, &w, &density2, &temperature2, &u2, &v2, &w2,
+                                       &pressure, &divergence, &curlX, &curlY, &curlZ, &curlLength};
+            for (unsigned int i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+                fields[i]->assign(cells, 0.0f);
+        }
+
+        /**
+         * @brief Advances the smoke by dt seconds
+         *
+         * @param dt Time step in seconds
+         */
+        void step(float dt) {
+            Timer total, timer;
+            addSources(dt);
+            confineVorticity(dt);
+            forceMs = timer.elapsedMs();
+
+            timer.reset();
+            {
+                const float* src[3] = {&u[0], &v[0], &w[0]};
+                float* dst[3] = {&u2[0], &v2[0], &w2[0]};
+                const float fade[3] = {1.0f, 1.0f, 1.0f};
+                advect(src, dst, fade, 3, dt);
+                u.swap(u2); v.swap(v2); w.swap(w2);
+            }
+            advectMs = timer.elapsedMs();
+
+            timer.reset();
+            project();
+            projectMs = timer.elapsedMs();
+
+            // scalars ride the divergence-free velocity
+            timer.reset();
+            {
+                const float* src[2] = {&density[0], &temperature[0]};
+                float* dst[2] = {&density2[0], &temperature2[0]};
+                const float fade[2] = {expf(-densityDecay * dt), expf(-cooling * dt)};
+                advect(src, dst, fade, 2, dt);
+                density.swap(density2); temperature.swap(temperature2);
+            }
+            advectMs += timer.elapsedMs();
+            lastMs = total.elapsedMs();
+        }
+
+        /**
+         * @brief Copies the density without ghost cells, x fastest, then y, then z (for a 3D texture)
+         *
+         * @param dst size^3 floats
+         */
+        void copyDensity(float* dst) const {
+            for (int z = 1; z <= size; z++)
+                for (int y = 1; y <= size; y++)
+                    memcpy(dst + ((size_t)(z - 1) * size + (y - 1)) * size, &density[index(1, y, z)], size * sizeof(float));
+        }
+
+        /**
+         * @brief Root mean square divergence of the velocity, in 1 / s. Should be near zero right after a step
+         */
+        float rmsDivergence() {
+            computeDivergence();
+            double sum = 0.0;
+            for (int z = 1; z <= size; z++)
+                for (int y = 1; y <= size; y++)
+                    for (int x = 1; x <= size; x++)
+                        sum += (double)divergence[index(x, y, z)] * divergence[index(x, y, z)];
+            return (float)sqrt(sum / ((double)size * size * size));
+        }
+
+    private:
+        JobSystem* jobs;
+        int stride;         // size + 2
+        size_t cells;       // stride^3
+
+        vector<float> density, temperature, u, v, w;
+        vector<float> density2, temperature2, u2, v2, w2;     // advection targets, swapped in
+        vector<float> pressure, divergence;
+        vector<float> curlX, curlY, curlZ, curlLength;
+
+        size_t index(int x, int y, int z) const {
+            return ((size_t)z * stride + y) * stride + x;
+        }
+
+        // runs f(z) for every interior slice, across the job system
+        template <class F>
+        void forSlices(F f) {
+            jobs->parallelFor(size, 1, [&](size_t begin, size_t end) {
+                for (size_t z = begin; z < end; z++)
+                    f((int)z + 1);
+            });
+        }
+
+        /**
+         * @brief Injects density and heat in a sphere around the source, then applies buoyancy everywhere
+         */
+        void addSources(float dt) {
+            glm::vec3 c = source * (float)size + glm::vec3(0.5f);
+            float r = sourceRadius * size;
+            int lo[3], hi[3];
+            for (int a = 0; a < 3; a++) {
+                lo[a] = std::max((int)(c[a] - r), 1);
+                hi[a] = std::min((int)(c[a] + r) + 1, size);
+            }
+            for (int z = lo[2]; z <= hi[2]; z++) {
+                for (int y = lo[1]; y <= hi[1]; y++) {
+                    for (int x = lo[0]; x <= hi[0]; x++) {
+                        float d = glm::length(glm::vec3((float)x, (float)y, (float)z) - c) / r;
+                        if (d >= 1.0f)
+                            continue;
+                        float falloff = 1.0f - d * d;
+                        size_t i = index(x, y, z);
+                        density[i] += sourceDensity * falloff * dt;
+                        temperature[i] += sourceHeat * falloff * dt;
+                    }
+                }
+            }
+
+            // velocity is kept in cells per second
+            const FluidVec up = fvSet(buoyancy * size * dt), down = fvSet(weight * size * dt);
+            forSlices([&](int z) {
+                for (int y = 1; y <= size; y++) {
+                    for (int x = 1; x <= size; x += FLUID_SIMD_WIDTH) {
+                        size_t i = index(x, y, z);
+                        FluidVec lift = fvSub(fvMul(fvLoad(&temperature[i]), up), fvMul(fvLoad(&density[i]), down));
+                        fvStore(&v[i], fvAdd(fvLoad(&v[i]), lift));
+                    }
+                }
+            });
+        }
+
+        /**
+         * @brief Adds back the small-scale swirl that advection smooths away: a force along N x omega, where N points up the gradient of |omega|
+         */
+        void confineVorticity(float dt) {
+            if (vorticity <= 0.0f)
+                return;
+            const size_t sy = stride, sz = (size_t)stride * stride;
+            const FluidVec half = fvSet(0.5f);
+
+            forSlices([&](int z) {
+                for (int y = 1; y <= size; y++) {
+                    for (int x = 1; x <= size; x += FLUID_SIMD_WIDTH) {
+                        size_t i = index(x, y, z);
+                        FluidVec ox = fvMul(half, fvSub(fvSub(fvLoad(&w[i + sy]), fvLoad(&w[i - sy])), fvSub(fvLoad(&v[i + sz]), fvLoad(&v[i - sz]))));
+                        FluidVec oy = fvMul(half, fvSub(fvSub(fvLoad(&u[i + sz]), fvLoad(&u[i - sz])), fvSub(fvLoad(&w[i + 1]), fvLoad(&w[i - 1]))));
+                        FluidVec oz = fvMul(half, fvSub(fvSub(fvLoad(&v[i + 1]), fvLoad(&v[i - 1])), fvSub(fvLoad(&u[i + sy]), fvLoad(&u[i - sy]))));
+                        fvStore(&curlX[i], ox);
+                        fvStore(&curlY[i], oy);
+                        fvStore(&curlZ[i], oz);
+                        fvStore(&curlLength[i], fvSqrt(fvAdd(fvAdd(fvMul(ox, ox), fvMul(oy, oy)), fvMul(oz, oz))));
+                    }
+                }
+            });
+
+            const FluidVec strength = fvSet(vorticity * dt), tiny = fvSet(1e-5f);
+            forSlices([&](int z) {
+                for (int y = 1; y <= size; y++) {
+                    for (int x = 1; x <= size; x += FLUID_SIMD_WIDTH) {
+                        size_t i = index(x, y, z);
+                        FluidVec gx = fvSub(fvLoad(&curlLength[i + 1]), fvLoad(&curlLength[i - 1]));
+                        FluidVec gy = fvSub(fvLoad(&curlLength[i + sy]), fvLoad(&curlLength[i - sy]));
+                        FluidVec gz = fvSub(fvLoad(&curlLength[i + sz]), fvLoad(&curlLength[i - sz]));
+                        FluidVec scale = fvDiv(strength, fvAdd(fvSqrt(fvAdd(fvAdd(fvMul(gx, gx), fvMul(gy, gy)), fvMul(gz, gz))), tiny));
+                        gx = fvMul(gx, scale); gy = fvMul(gy, scale); gz = fvMul(gz, scale);
+                        FluidVec ox = fvLoad(&curlX[i]), oy = fvLoad(&curlY[i]), oz = fvLoad(&curlZ[i]);
+                        fvStore(&u[i], fvAdd(fvLoad(&u[i]), fvSub(fvMul(gy, oz), fvMul(gz, oy))));
+                        fvStore(&v[i], fvAdd(fvLoad(&v[i]), fvSub(fvMul(gz, ox), fvMul(gx, oz))));
+                        fvStore(&w[i], fvAdd(fvLoad(&w[i]), fvSub(fvMul(gx, oy), fvMul(gy, ox))));
+                    }
+                }
+            });
+        }
+
+        // trilinear sample of a padded field at cell coordinates already clamped into the grid
+        float trilinear(const float* f, float x, float y, float z) const {
+            int ix = (int)x, iy = (int)y, iz = (int)z;
+            float tx = x - ix, ty = y - iy, tz = z - iz;
+            size_t i = index(ix, iy, iz), sy = stride, sz = (size_t)stride * stride;
+            float a = f[i] + (f[i + 1] - f[i]) * tx;
+            float b = f[i + sy] + (f[i + sy + 1] - f[i + sy]) * tx;
+            float c = f[i + sz] + (f[i + sz + 1] - f[i + sz]) * tx;
+            float d = f[i + sz + sy] + (f[i + sz + sy + 1] - f[i + sz + sy]) * tx;
+            float e = a + (b - a) * ty, g = c + (d - c) * ty;
+            return e + (g - e) * tz;
+        }
+
+        /**
+         * @brief Semi-Lagrangian advection of several fields by the current velocity: each cell traces back by dt and samples there. Vectorized with AVX2 gathers when available (SSE2 has no gather, so it takes the scalar path)
+         *
+         * @param src Fields to advect
+         * @param dst Where to write them; must not alias src or the velocity
+         * @param fade Multiplier applied to each field
+         * @param count Number of fields
+         * @param dt Time step in seconds
+         */
+        void advect(const float* const* src, float* const* dst, const float* fade, int count, float dt) {
+            const float limit = (float)size + 0.999f;   // the far ghost layer is the last one a sample may touch
+            forSlices([&](int z) {
+                for (int y = 1; y <= size; y++) {
+                    int x = 1;
+#if FLUID_SIMD_WIDTH == 8
+                    const __m256 vdt = _mm256_set1_ps(dt), lo = _mm256_setzero_ps(), hi = _mm256_set1_ps(limit);
+                    const __m256 fy = _mm256_set1_ps((float)y), fz = _mm256_set1_ps((float)z);
+                    const __m256 lane = _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0);
+                    const __m256i sy = _mm256_set1_epi32(stride), sz = _mm256_set1_epi32(stride * stride), one = _mm256_set1_epi32(1);
+                    for (; x + 8 <= size + 1; x += 8) {
+                        size_t i = index(x, y, z);
+                        __m256 px = _mm256_sub_ps(_mm256_add_ps(_mm256_set1_ps((float)x), lane), _mm256_mul_ps(vdt, _mm256_loadu_ps(&u[i])));
+                        __m256 py = _mm256_sub_ps(fy, _mm256_mul_ps(vdt, _mm256_loadu_ps(&v[i])));
+                        __m256 pz = _mm256_sub_ps(fz, _mm256_mul_ps(vdt, _mm256_loadu_ps(&w[i])));
+                        px = _mm256_min_ps(_mm256_max_ps(px, lo), hi);
+                        py = _mm256_min_ps(_mm256_max_ps(py, lo), hi);
+                        pz = _mm256_min_ps(_mm256_max_ps(pz, lo), hi);
+                        __m256 bx = _mm256_floor_ps(px), by = _mm256_floor_ps(py), bz = _mm256_floor_ps(pz);
+                        __m256 tx = _mm256_sub_ps(px, bx), ty = _mm256_sub_ps(py, by), tz = _mm256_sub_ps(pz, bz);
+                        __m256i c000 = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(_mm256_cvttps_epi32(bz), sz), _mm256_mullo_epi32(_mm256_cvttps_epi32(by), sy)), _mm256_cvttps_epi32(bx));
+                        __m256i c010 = _mm256_add_epi32(c000, sy), c001 = _mm256_add_epi32(c000, sz), c011 = _mm256_add_epi32(c001, sy);
+
+                        for (int f = 0; f < count; f++) {
+                            const float* s = src[f];
+                            __m256 a0 = _mm256_i32gather_ps(s, c000, 4), a1 = _mm256_i32gather_ps(s, _mm256_add_epi32(c000, one), 4);
+                            __m256 b0 = _mm256_i32gather_ps(s, c010, 4), b1 = _mm256_i32gather_ps(s, _mm256_add_epi32(c010, one), 4);
+                            __m256 d0 = _mm256_i32gather_ps(s, c001, 4), d1 = _mm256_i32gather_ps(s, _mm256_add_epi32(c001, one), 4);
+                            __m256 e0 = _mm256_i32gather_ps(s, c011, 4), e1 = _mm256_i32gather_ps(s, _mm256_add_epi32(c011, one), 4);
+                            __m256 a = _mm256_add_ps(a0, _mm256_mul_ps(_mm256_sub_ps(a1, a0), tx));
+                            __m256 b = _mm256_add_ps(b0, _mm256_mul_ps(_mm256_sub_ps(b1, b0), tx));
+                            __m256 d = _mm256_add_ps(d0, _mm256_mul_ps(_mm256_sub_ps(d1, d0), tx));
+                            __m256 e = _mm256_add_ps(e0, _mm256_mul_ps(_mm256_sub_ps(e1, e0), tx));
+                            __m256 ab = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), ty));
+                            __m256 de = _mm256_add_ps(d, _mm256_mul_ps(_mm256_sub_ps(e, d), ty));
+                            __m256 r = _mm256_add_ps(ab, _mm256_mul_ps(_mm256_sub_ps(de, ab), tz));
+                            _mm256_storeu_ps(&dst[f][i], _mm256_mul_ps(r, _mm256_set1_ps(fade[f])));
+                        }
+                    }
+#endif
+                    // scalar fallback, and the tail of the vector loop
+                    for (; x <= size; x++) {
+                        size_t i = index(x, y, z);
+                        float px = glm::clamp(x - dt * u[i], 0.0f, limit);
+                        float py = glm::clamp(y - dt * v[i], 0.0f, limit);
+                        float pz = glm::clamp(z - dt * w[i], 0.0f, limit);
+                        for (int f = 0; f < count; f++)
+                            dst[f][i] = trilinear(src[f], px, py, pz) * fade[f];
+                    }
+                }
+            });
+        }
+
+        // central-difference divergence of the velocity into divergence
+        void computeDivergence() {
+            const size_t sy = stride, sz = (size_t)stride * stride;
+            const FluidVec half = fvSet(0.5f);
+            forSlices([&](int z) {
+                for (int y = 1; y <= size; y++) {
+                    for (int x = 1; x <= size; x += FLUID_SIMD_WIDTH) {
+                        size_t i = index(x, y, z);
+                        FluidVec d = fvAdd(fvAdd(fvSub(fvLoad(&u[i + 1]), fvLoad(&u[i - 1])), fvSub(fvLoad(&v[i + sy]), fvLoad(&v[i - sy]))), fvSub(fvLoad(&w[i + sz]), fvLoad(&w[i - sz])));
+                        fvStore(&divergence[i], fvMul(half, d));
+                    }
+                }
+            });
+        }
+
+        /**
+         * @brief Makes the velocity divergence-free: solves for pressure with red-black Gauss-Seidel, then subtracts its gradient.
+         * A red cell's neighbors are all black (in x, y and z), so one color updates in place without races between slices. Whole
+         * registers along x are computed, and a lane mask keeps only the cells of the color being updated
+         */
+        void project() {
+            computeDivergence();
+
+            const size_t sy = stride, sz = (size_t)stride * stride;
+            const FluidVec sixth = fvSet(1.0f / 6.0f);
+            const FluidVec masks[2] = {fvParityMask(0), fvParityMask(1)};
+            for (int it = 0; it < pressureIterations; it++) {
+                for (int color = 0; color < 2; color++) {
+                    forSlices([&](int z) {
+                        for (int y = 1; y <= size; y++) {
+                            for (int x = 1; x <= size; x += FLUID_SIMD_WIDTH) {
+                                size_t i = index(x, y, z);
+                                FluidVec sum = fvAdd(fvAdd(fvLoad(&pressure[i - 1]), fvLoad(&pressure[i + 1])), fvAdd(fvLoad(&pressure[i - sy]), fvLoad(&pressure[i + sy])));
+                                sum = fvAdd(sum, fvAdd(fvLoad(&pressure[i - sz]), fvLoad(&pressure[i + sz])));
+                                FluidVec solved = fvMul(fvSub(sum, fvLoad(&divergence[i])), sixth);
+                                // lane k is cell x + k, which is this color when (x + k + y + z) % 2 == color
+                                fvStore(&pressure[i], fvSelect(masks[(x + y + z + color) & 1], fvLoad(&pressure[i]), solved));
+                            }
+                        }
+                    });
+                }
+            }
+
+            const FluidVec half = fvSet(0.5f);
+            forSlices([&](int z) {
+                for (int y = 1; y <= size; y++) {
+                    for (int x = 1; x <= size; x += FLUID_SIMD_WIDTH) {
+                        size_t i = index(x, y, z);
+                        fvStore(&u[i], fvSub(fvLoad(&u[i]), fvMul(half, fvSub(fvLoad(&pressure[i + 1]), fvLoad(&pressure[i - 1])))));
+                        fvStore(&v[i], fvSub(fvLoad(&v[i]), fvMul(half, fvSub(fvLoad(&pressure[i + sy]), fvLoad(&pressure[i - sy])))));
+                        fvStore(&w[i], fvSub(fvLoad(&w[i]), fvMul(half, fvSub(fvLoad(&pressure[i + sz]), fvLoad(&pressure[i - sz])))));
+                    }
+                }
+            });
+        }
+};
+
+#endif
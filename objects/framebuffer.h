@@ -0,0 +1,181 @@
+/**
+ * @file framebuffer.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Offscreen render targets (a framebuffer object with texture attachments) and a fullscreen triangle for post passes
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "helper.h"
+
+/**
+ * @brief Creates an immutable 2D texture with linear filtering and clamped edges
+ *
+ * @param width Width in pixels
+ * @param height Height in pixels
+ * @param internalFormat Sized internal format (e.g. GL_RGBA16F)
+ * @param levels Mip levels. Defaults to 1
+ * @return unsigned int texture ID
+ */
+inline unsigned int createTexture2D(int width, int height, GLenum internalFormat, int levels = 1) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+/**
+ * @brief Creates an immutable 3D texture with trilinear filtering
+ *
+ * @param size Width, height and depth in texels
+ * @param internalFormat Sized internal format (e.g. GL_RGBA16F)
+ * @param format Format of the data (e.g. GL_RGBA)
+ * @param type Type of the data (e.g. GL_FLOAT)
+ * @param data Texels, x fastest, then y, then z; NULL leaves them undefined
+ * @param wrap Wrap mode on every axis. Defaults to GL_REPEAT, for tiling noise
+ * @return unsigned int texture ID
+ */
+inline unsigned int createTexture3D(int size, GLenum internalFormat, GLenum format, GLenum type, const void* data, GLenum wrap = GL_REPEAT) {
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_3D, texture);
+    glTexStorage3D(GL_TEXTURE_3D, 1, internalFormat, size, size, size);
+    if (data != NULL)
+        glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, size, size, size, format, type, data);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, wrap);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    return texture;
+}
+
+/**
+ * @brief Draws a single triangle covering the viewport. The vertex shader is expected to build it from gl_VertexID (see shaders/fullscreen.vert)
+ */
+inline void drawFullscreenTriangle() {
+    static unsigned int emptyVAO = 0;
+    if (emptyVAO == 0)
+        glGenVertexArrays(1, &emptyVAO);
+
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+}
+
+/**
+ * @brief A framebuffer object with any number of color textures, and an optional depth-stencil attachment (owned, or borrowed from elsewhere)
+ */
+class RenderTarget {
+    public:
+        unsigned int fbo;
+        vector<unsigned int> colors;
+        unsigned int depth = 0;
+        int width, height;
+
+        /**
+         * @brief Construct a new RenderTarget object
+         *
+         * @param width Width in pixels
+         * @param height Height in pixels
+         * @param colorFormats Sized internal format of each color attachment, in attachment order
+         * @param depthFormat Sized internal format of an owned depth texture, or 0 for none. Defaults to 0
+         */
+        RenderTarget(int width, int height, vector<GLenum> colorFormats, GLenum depthFormat = 0) : width(width), height(height) {
+            glGenFramebuffers(1, &fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+            vector<GLenum> drawBuffers;
+            for (unsigned int i = 0; i < colorFormats.size(); i++) {
+                colors.push_back(createTexture2D(width, height, colorFormats[i]));
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colors[i], 0);
+                drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+            }
+            if (drawBuffers.empty())
+                glDrawBuffer(GL_NONE);
+            else
+                glDrawBuffers(drawBuffers.size(), &drawBuffers[0]);
+
+            if (depthFormat != 0) {
+                depth = createTexture2D(width, height, depthFormat);
+                ownsDepth = true;
+                glFramebufferTexture2D(GL_FRAMEBUFFER, depthAttachment(depthFormat), GL_TEXTURE_2D, depth, 0);
+            }
+
+            checkStatus();
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+
+        ~RenderTarget() {
+            if (!colors.empty())
+                glDeleteTextures(colors.size(), &colors[0]);
+            if (ownsDepth)
+                glDeleteTextures(1, &depth);
+            glDeleteFramebuffers(1, &fbo);
+        }
+
+        /**
+         * @brief Attaches a depth texture owned by someone else (e.g. to depth test against the scene). Must match this target's size
+         *
+         * @param texture Depth texture
+         * @param format Its internal format
+         */
+        void attachDepth(unsigned int texture, GLenum format) {
+            if (ownsDepth)
+                glDeleteTextures(1, &depth);
+            depth = texture;
+            ownsDepth = false;
+
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, depthAttachment(format), GL_TEXTURE_2D, texture, 0);
+            checkStatus();
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+
+        // binds the target for drawing and sets the viewport to cover it
+        void bind() {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glViewport(0, 0, width, height);
+        }
+
+        // framebuffer the scene is drawn into: the window's (0) unless an HDR target has replaced it
+        static GLuint& sceneFbo() {
+            static GLuint fbo = 0;
+            return fbo;
+        }
+
+        // binds the scene framebuffer and restores a full-window viewport
+        static void bindScene(int rx, int ry) {
+            glBindFramebuffer(GL_FRAMEBUFFER, sceneFbo());
+            glViewport(0, 0, rx, ry);
+        }
+
+    private:
+        bool ownsDepth = false;
+
+        static GLenum depthAttachment(GLenum format) {
+            if (format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8)
+                return GL_DEPTH_STENCIL_ATTACHMENT;
+            return GL_DEPTH_ATTACHMENT;
+        }
+
+        void checkStatus() {
+            GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+            if (status != GL_FRAMEBUFFER_COMPLETE)
+                std::cout << "ERROR::FRAMEBUFFER:: incomplete (0x" << std::hex << status << std::dec << ")" << std::endl;
+        }
+};
+
+#endif
@@ -0,0 +1,254 @@
+/**
+ * @file gpuparticles.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Compute-shader particle backend. Emission pops slots off an SSBO free list with atomic counters, integration runs in compute, and sprites are drawn indirectly from the same SSBO, so particle data never round-trips through the CPU
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef GPUPARTICLES_H
+#define GPUPARTICLES_H
+
+#include "helper.h"
+#include "particles.h"
+#include "particlerenderer.h"
+
+// Work group size of the particle compute shaders
+#define GPU_PARTICLE_GROUP 256
+
+// Texture unit of the turbulence field (see shaders/particle_simulate.comp)
+#define GPU_PARTICLE_TURBULENCE_UNIT 5
+
+// Texture unit of the depth buffer particles collide against
+#define GPU_PARTICLE_DEPTH_UNIT 6
+
+/* ----- GPU PARTICLE COUNTERS ----- *\
+The counter buffer doubles as the indirect draw command of the sprite pass
+Offset      0           4               8       12              16
+            count (6)   instanceCount   first   baseInstance    freeCount
+                        = alive count
+count is vertices per sprite; the renderer rewrites it when sprites are trimmed to flipbook outlines
+\* --------------------------------- */
+
+/**
+ * @brief Uploads the shared parts of an emitter description as uniforms of a particle compute shader (struct uniform "emitter")
+ *
+ * @param shader Compute shader in use
+ * @param desc Emitter description
+ */
+inline void setEmitterUniforms(ComputeShader* shader, const EmitterDesc& desc) {
+    shader->setUInt("capacity", desc.capacity);
+    shader->setVec3("emitter.position", desc.position);
+    shader->setFloat("emitter.radius", desc.radius);
+    shader->setFloat("emitter.lifeMin", desc.lifeMin);
+    shader->setFloat("emitter.lifeMax", desc.lifeMax);
+    shader->setVec3("emitter.velocity", desc.velocity);
+    shader->setFloat("emitter.velocitySpread", desc.velocitySpread);
+    shader->setVec3("emitter.acceleration", desc.acceleration);
+    shader->setFloat("emitter.drag", desc.drag);
+    shader->setFloat("emitter.turbulence", desc.turbulence);
+    shader->setFloat("emitter.turbulenceScale", desc.turbulenceScale);
+    shader->setBool("emitter.collide", desc.collide);
+    shader->setFloat("emitter.restitution", desc.restitution);
+    shader->setFloat("emitter.friction", desc.friction);
+    shader->setFloat("emitter.sizeStart", desc.sizeStart);
+    shader->setFloat("emitter.sizeEnd", desc.sizeEnd);
+    shader->setUInt("emitter.frameCount", desc.frameCount > 0 ? desc.frameCount : 1);
+}
+
+/**
+ * @brief A single emitter simulated entirely on the GPU
+ */
+class GpuParticleEmitter {
+    public:
+        EmitterDesc desc;
+        EmitterLod lod;
+        EmitterClock clock;
+
+        GpuParticleEmitter(const EmitterDesc& desc) : desc(desc) {
+            unsigned int capacity = desc.capacity;
+
+            // streams start dead (life 0)
+            glGenBuffers(1, &dataBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, dataBuffer);
+            vector<float> zeros(PARTICLE_STREAMS * capacity, 0.0f);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, zeros.size() * sizeof(float), &zeros[0], GL_DYNAMIC_COPY);
+
+            glGenBuffers(1, &drawList);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawList);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+
+            // every slot starts free
+            vector<uint32_t> slots(capacity);
+            for (unsigned int i = 0; i < capacity; i++)
+                slots[i] = capacity - 1 - i;
+            glGenBuffers(1, &freeList);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, freeList);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(uint32_t), &slots[0], GL_DYNAMIC_COPY);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+            uint32_t counters[5] = {6, 0, 0, 0, capacity};
+            glGenBuffers(1, &counterBuffer);
+            glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, counterBuffer);
+            glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(counters), counters, GL_DYNAMIC_COPY);
+            glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+            // the same triangles and alias table the CPU samples, for the emission shader
+            if (desc.surface != NULL && desc.surface->triangleCount > 0) {
+                vector<float> packed = desc.surface->packed();
+                glGenBuffers(1, &surfaceBuffer);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, surfaceBuffer);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, packed.size() * sizeof(float), &packed[0], GL_STATIC_DRAW);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            }
+        }
+
+        ~GpuParticleEmitter() {
+            glDeleteBuffers(1, &dataBuffer);
+            glDeleteBuffers(1, &drawList);
+            glDeleteBuffers(1, &freeList);
+            glDeleteBuffers(1, &counterBuffer);
+            glDeleteBuffers(1, &surfaceBuffer);
+        }
+
+        /**
+         * @brief Emits and integrates one step of dt seconds. At a reduced lod.interval most frames only bank the time, and the draw list of the last step is kept
+         *
+         * @param emit Emission compute shader
+         * @param simulate Integration compute shader
+         * @param dt Time step in seconds
+         */
+        void update(ComputeShader* emit, ComputeShader* simulate, float dt) {
+            float step;
+            if (!clock.tick(dt, lod.interval, step))
+                return;
+            EmitterDesc desc = lod.apply(this->desc);
+
+            spawnAccumulator += desc.spawnRate * step;
+            unsigned int spawnCount = (unsigned int)spawnAccumulator;
+            spawnAccumulator -= spawnCount;
+            if (spawnCount > desc.capacity)
+                spawnCount = desc.capacity;
+            // a surface emitter whose surface had no triangles has nowhere to spawn
+            if (desc.surface != NULL && surfaceBuffer == 0)
+                spawnCount = 0;
+            frameSeed++;
+
+            // the draw list is rebuilt from scratch every step
+            uint32_t zero = 0;
+            glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, counterBuffer);
+            glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 4, sizeof(uint32_t), &zero);
+            glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, 0);
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, dataBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, drawList);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, freeList);
+            glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, counterBuffer);
+
+            if (spawnCount > 0) {
+                emit->use();
+                setEmitterUniforms(emit, desc);
+                emit->setUInt("spawnCount", spawnCount);
+                emit->setUInt("seed", desc.seed * 0x9E3779B9u + frameSeed);
+                emit->setUInt("surfaceTriangles", surfaceBuffer != 0 ? desc.surface->triangleCount : 0);
+                emit->setFloat("normalSpeed", desc.normalSpeed);
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, surfaceBuffer);
+                emit->dispatch(spawnCount, GPU_PARTICLE_GROUP);
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+            }
+
+            simulate->use();
+            setEmitterUniforms(simulate, desc);
+            simulate->setFloat("dt", step);
+            simulate->dispatch(desc.capacity, GPU_PARTICLE_GROUP);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+        }
+
+        // draw description; the sprite count comes from the alive counter without a readback
+        ParticleDrawSource drawSource() {
+            ParticleDrawSource src;
+            src.dataBuffer = dataBuffer;
+            src.drawList = drawList;
+            src.capacity = desc.capacity;
+            src.indirectBuffer = counterBuffer;
+            src.layer = desc.layer;
+            return src;
+        }
+
+    private:
+        GLuint dataBuffer, drawList, freeList, counterBuffer;
+        GLuint surfaceBuffer = 0;       // packed EmissionSurface, if the emitter has one
+        float spawnAccumulator = 0.0f;
+        unsigned int frameSeed = 0;
+};
+
+/**
+ * @brief Owns the GPU emitters and the compute shaders that step them. Mirrors ParticleSystem, so the two paths can run the same descriptions
+ */
+class GpuParticleSystem {
+    public:
+        vector<GpuParticleEmitter*> emitters;
+        unsigned int turbulenceTexture = 0;     // 3D curl field for emitters with turbulence (see noise.h)
+        float collisionThickness = 0.3f;        // how far behind the depth buffer a particle still counts as colliding, in world units
+
+        GpuParticleSystem(const char* emitPath, const char* simulatePath) {
+            emit = new ComputeShader(emitPath);
+            simulate = new ComputeShader(simulatePath);
+        }
+
+        ~GpuParticleSystem() {
+            for (unsigned int i = 0; i < emitters.size(); i++)
+                delete emitters[i];
+            delete emit;
+            delete simulate;
+        }
+
+        // creates an emitter owned by this system
+        GpuParticleEmitter* addEmitter(const EmitterDesc& desc) {
+            GpuParticleEmitter* e = new GpuParticleEmitter(desc);
+            emitters.push_back(e);
+            return e;
+        }
+
+        /**
+         * @brief Sets the depth buffer colliding emitters bounce off in the next update. Pass the frame just drawn: by the time particles step it is the previous frame's, so its own matrices go with it
+         *
+         * @param depthTexture Window depth of the opaque scene, or 0 to disable depth collision
+         * @param viewProjection Projection times view matrix the depth was drawn with
+         * @param eye Camera position the depth was drawn from
+         */
+        void setCollisionDepth(unsigned int depthTexture, const glm::mat4& viewProjection, const glm::vec3& eye) {
+            collisionDepth = depthTexture;
+            collisionViewProjection = viewProjection;
+            collisionEye = eye;
+        }
+
+        // advances every emitter by dt seconds
+        void update(float dt) {
+            glActiveTexture(GL_TEXTURE0 + GPU_PARTICLE_TURBULENCE_UNIT);
+            glBindTexture(GL_TEXTURE_3D, turbulenceTexture);
+            glActiveTexture(GL_TEXTURE0 + GPU_PARTICLE_DEPTH_UNIT);
+            glBindTexture(GL_TEXTURE_2D, collisionDepth);
+            glActiveTexture(GL_TEXTURE0);
+
+            simulate->use();
+            simulate->setBool("depthCollision", collisionDepth != 0);
+            simulate->setMat4("collisionViewProjection", collisionViewProjection);
+            simulate->setMat4("collisionInverse", glm::inverse(collisionViewProjection));
+            simulate->setVec3("collisionEye", collisionEye);
+            simulate->setFloat("collisionThickness", collisionThickness);
+            for (unsigned int i = 0; i < emitters.size(); i++)
+                emitters[i]->update(emit, simulate, dt);
+        }
+
+    private:
+        ComputeShader* emit;
+        ComputeShader* simulate;
+        unsigned int collisionDepth = 0;
+        glm::mat4 collisionViewProjection = glm::mat4(1.0f);
+        glm::vec3 collisionEye = glm::vec3(0.0f);
+};
+
+#endif
@@ -0,0 +1,202 @@
+/**
+ * @file gpusort.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Back-to-front ordering of GPU particles without readback. (depth, index) pairs are sorted in compute, with a bitonic sort for small emitters and an 8-bit onesweep radix sort for large ones, and the sorted index buffer becomes the draw list of the indirect sprite draw
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef GPUSORT_H
+#define GPUSORT_H
+
+#include "helper.h"
+#include "particlerenderer.h"
+
+// Pairs per shared-memory block of the bitonic sort (see sort_bitonic.comp)
+#define GPU_SORT_BITONIC_BLOCK 1024
+
+// Emitters up to this capacity use the bitonic sort; larger ones use the radix sort
+#define GPU_SORT_BITONIC_MAX 16384
+
+// Pairs per tile of the onesweep pass (see sort_radix_onesweep.comp)
+#define GPU_SORT_TILE 256
+
+// Work groups of the histogram pass
+#define GPU_SORT_HIST_GROUPS 64
+
+// Which algorithm sorted the last emitter
+enum GpuSortPath {
+    GPU_SORT_BITONIC=0, GPU_SORT_ONESWEEP=1
+};
+
+/**
+ * @brief Sorts the particles of GPU emitters by depth. Scratch buffers are sized once for the largest capacity, so each sorted list is only valid until the next call to sort()
+ */
+class GpuParticleSorter {
+    public:
+        GpuSortPath lastPath = GPU_SORT_BITONIC;
+
+        GpuParticleSorter(unsigned int maxCapacity) {
+            keysProgram = new ComputeShader("shaders/sort_keys.comp");
+            bitonicProgram = new ComputeShader("shaders/sort_bitonic.comp");
+            histProgram = new ComputeShader("shaders/sort_radix_hist.comp");
+            scanProgram = new ComputeShader("shaders/sort_radix_scan.comp");
+            onesweepProgram = new ComputeShader("shaders/sort_radix_onesweep.comp");
+
+            // big enough for both a power-of-two bitonic sort and whole radix tiles
+            unsigned int bitonicCount = bitonicSize(maxCapacity < GPU_SORT_BITONIC_MAX ? maxCapacity : GPU_SORT_BITONIC_MAX);
+            unsigned int radixCount = radixSize(maxCapacity);
+            maxCount = bitonicCount > radixCount ? bitonicCount : radixCount;
+            maxTiles = radixCount / GPU_SORT_TILE;
+
+            glGenBuffers(4, pairs);
+            for (int i = 0; i < 4; i++) {
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, pairs[i]);
+                glBufferData(GL_SHADER_STORAGE_BUFFER, maxCount * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+            }
+
+            glGenBuffers(1, &histogram);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, histogram);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, 4 * 256 * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+
+            glGenBuffers(1, &status);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, status);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, (4 + 4 * maxTiles * 256) * sizeof(uint32_t), NULL, GL_DYNAMIC_COPY);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        ~GpuParticleSorter() {
+            glDeleteBuffers(4, pairs);
+            glDeleteBuffers(1, &histogram);
+            glDeleteBuffers(1, &status);
+            delete keysProgram;
+            delete bitonicProgram;
+            delete histProgram;
+            delete scanProgram;
+            delete onesweepProgram;
+        }
+
+        /**
+         * @brief Sorts the alive list of a GPU emitter back to front. The alive count stays on the GPU, so the sort covers the whole capacity with padding keys that sort last
+         *
+         * @param src Draw source of a GPU emitter (indirectBuffer is its counter buffer)
+         * @param eye Camera position
+         * @return ParticleDrawSource the same draw with the sorted index buffer as its draw list
+         */
+        ParticleDrawSource sort(const ParticleDrawSource& src, glm::vec3 eye) {
+            bool bitonic = src.capacity <= GPU_SORT_BITONIC_MAX;
+            unsigned int count = bitonic ? bitonicSize(src.capacity) : radixSize(src.capacity);
+            lastPath = bitonic ? GPU_SORT_BITONIC : GPU_SORT_ONESWEEP;
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, src.dataBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, src.drawList);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, src.indirectBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, pairs[0]);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, pairs[1]);
+
+            keysProgram->use();
+            keysProgram->setUInt("capacity", src.capacity);
+            keysProgram->setUInt("sortCount", count);
+            keysProgram->setVec3("eye", eye);
+            keysProgram->dispatch(count, 256);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            if (bitonic)
+                sortBitonic(count);
+            else
+                sortOnesweep(count);
+
+            // both sorts leave the result in the first pair of buffers
+            ParticleDrawSource sorted = src;
+            sorted.drawList = pairs[1];
+            return sorted;
+        }
+
+    private:
+        ComputeShader* keysProgram;
+        ComputeShader* bitonicProgram;
+        ComputeShader* histProgram;
+        ComputeShader* scanProgram;
+        ComputeShader* onesweepProgram;
+
+        GLuint pairs[4];        // keys A, values A, keys B, values B
+        GLuint histogram;
+        GLuint status;
+        unsigned int maxCount, maxTiles;
+
+        // power of two, and at least one block
+        static unsigned int bitonicSize(unsigned int n) {
+            unsigned int size = GPU_SORT_BITONIC_BLOCK;
+            while (size < n)
+                size <<= 1;
+            return size;
+        }
+
+        // whole tiles
+        static unsigned int radixSize(unsigned int n) {
+            return (n + GPU_SORT_TILE - 1) / GPU_SORT_TILE * GPU_SORT_TILE;
+        }
+
+        void sortBitonic(unsigned int count) {
+            bitonicProgram->use();
+
+            bitonicProgram->setUInt("stage", 0);
+            glDispatchCompute(count / GPU_SORT_BITONIC_BLOCK, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            for (unsigned int k = GPU_SORT_BITONIC_BLOCK * 2; k <= count; k <<= 1) {
+                bitonicProgram->setUInt("k", k);
+                bitonicProgram->setUInt("stage", 1);
+                for (unsigned int j = k / 2; j >= GPU_SORT_BITONIC_BLOCK; j >>= 1) {
+                    bitonicProgram->setUInt("j", j);
+                    glDispatchCompute(count / 2 / (GPU_SORT_BITONIC_BLOCK / 2), 1, 1);
+                    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+                }
+
+                bitonicProgram->setUInt("stage", 2);
+                glDispatchCompute(count / GPU_SORT_BITONIC_BLOCK, 1, 1);
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            }
+        }
+
+        void sortOnesweep(unsigned int count) {
+            unsigned int tiles = count / GPU_SORT_TILE;
+            uint32_t zero = 0;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, histogram);
+            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, status);
+            glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, histogram);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, status);
+
+            histProgram->use();
+            histProgram->setUInt("sortCount", count);
+            glDispatchCompute(GPU_SORT_HIST_GROUPS, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            scanProgram->use();
+            glDispatchCompute(1, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            onesweepProgram->use();
+            onesweepProgram->setUInt("tileCount", tiles);
+            for (unsigned int pass = 0; pass < 4; pass++) {
+                // ping-pong; four passes end back in A
+                int in = (pass & 1) * 2, out = 2 - in;
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, pairs[in]);
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, pairs[in + 1]);
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, pairs[out]);
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, pairs[out + 1]);
+
+                onesweepProgram->setUInt("pass", pass);
+                glDispatchCompute(tiles, 1, 1);
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            }
+        }
+};
+
+#endif
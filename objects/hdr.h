@@ -0,0 +1,142 @@
+/**
+ * @file hdr.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief High dynamic range scene target, so additive fire can exceed 1 without clipping, and its tonemapping resolve to the window. R11F_G11F_B10F is the default (4 bytes per pixel, no alpha), with RGBA16F (8 bytes per pixel) as an option
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef HDR_H
+#define HDR_H
+
+#include "helper.h"
+#include "framebuffer.h"
+
+/**
+ * @brief Scene color and depth-stencil at window resolution. While bound with begin(), it is the scene framebuffer every other pass reads and draws into
+ */
+class HdrTarget {
+    public:
+        GLenum format;
+        RenderTarget* target = NULL;
+        float exposure = 1.0f;
+
+        /**
+         * @brief Construct a new HdrTarget object
+         *
+         * @param rx Width of the window in pixels
+         * @param ry Height of the window in pixels
+         * @param format Color format, GL_R11F_G11F_B10F or GL_RGBA16F. Defaults to GL_R11F_G11F_B10F
+         */
+        HdrTarget(int rx, int ry, GLenum format = GL_R11F_G11F_B10F) : rx(rx), ry(ry) {
+            tonemapShader = new Shader("shaders/fullscreen.vert", "shaders/tonemap.frag");
+            setFormat(format);
+        }
+
+        ~HdrTarget() {
+            if (RenderTarget::sceneFbo() == target->fbo)
+                RenderTarget::sceneFbo() = 0;
+            delete target;
+            delete tonemapShader;
+        }
+
+        // reallocates the target in another color format
+        void setFormat(GLenum f) {
+            format = f;
+            bool current = target != NULL && RenderTarget::sceneFbo() == target->fbo;
+            delete target;
+            target = new RenderTarget(rx, ry, {format}, GL_DEPTH24_STENCIL8);
+            if (current)
+                RenderTarget::sceneFbo() = target->fbo;
+        }
+
+        unsigned int color() { return target->colors[0]; }
+
+        // bytes per pixel of the color format
+        static int bytesPerPixel(GLenum format) {
+            return format == GL_RGBA16F ? 8 : 4;
+        }
+
+        // makes this the scene framebuffer, binds it and clears it
+        void begin() {
+            RenderTarget::sceneFbo() = target->fbo;
+            RenderTarget::bindScene(rx, ry);
+            glStencilMask(0xFF);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+        }
+
+        /**
+         * @brief Tonemaps the scene into the window, which becomes the scene framebuffer again
+         *
+         * @param bloom Bloom texture added before tonemapping (level 0 is sampled), or 0 for none. Defaults to 0
+         * @param bloomIntensity Scale of the bloom. Defaults to 1
+         */
+        void resolve(unsigned int bloom = 0, float bloomIntensity = 1.0f) {
+            RenderTarget::sceneFbo() = 0;
+            RenderTarget::bindScene(rx, ry);
+
+            tonemapShader->use();
+            tonemapShader->setInt("hdrTexture", 0);
+            tonemapShader->setInt("bloomTexture", 1);
+            tonemapShader->setBool("useBloom", bloom != 0);
+            tonemapShader->setFloat("bloomIntensity", bloomIntensity);
+            tonemapShader->setFloat("exposure", exposure);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, color());
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, bloom);
+
+            glDisable(GL_DEPTH_TEST);
+            drawFullscreenTriangle();
+            glEnable(GL_DEPTH_TEST);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        /**
+         * @brief Measures the blend bandwidth of a color format: fullscreen additive passes read and write every pixel, like heavy particle overdraw. Blocks until the GPU is done
+         *
+         * @param format Color format to test
+         * @param width Target width in pixels
+         * @param height Target height in pixels
+         * @param passes Fullscreen passes to time. Defaults to 64
+         * @return float effective bandwidth in GB/s (one read and one write per pixel per pass)
+         */
+        static float measureBandwidth(GLenum format, int width, int height, int passes = 64) {
+            RenderTarget target(width, height, {format});
+            Shader shader("shaders/fullscreen.vert", "shaders/bandwidth.frag");
+
+            target.bind();
+            glDisable(GL_DEPTH_TEST);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+            shader.use();
+
+            // warm up, then time
+            drawFullscreenTriangle();
+            glFinish();
+            GLuint query;
+            glGenQueries(1, &query);
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            for (int i = 0; i < passes; i++)
+                drawFullscreenTriangle();
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 ns = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+            glDeleteQueries(1, &query);
+
+            glDisable(GL_BLEND);
+            glEnable(GL_DEPTH_TEST);
+            RenderTarget::bindScene(width, height);
+
+            double bytes = 2.0 * bytesPerPixel(format) * width * height * passes;
+            return ns > 0 ? (float)(bytes / ns) : 0.0f;
+        }
+
+    private:
+        int rx, ry;
+        Shader* tonemapShader;
+};
+
+#endif
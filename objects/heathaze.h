@@ -0,0 +1,120 @@
+/**
+ * @file heathaze.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Heat shimmer above fires. Flame sprites accumulate screen-space offsets into a reduced-resolution distortion buffer, scrolled through the shared 3D curl-noise field (see noise.h), and one fullscreen pass resamples the scene through it
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef HEATHAZE_H
+#define HEATHAZE_H
+
+#include "helper.h"
+#include "framebuffer.h"
+
+/**
+ * @brief Distortion buffer and composite pass. Usage: setNoise() once, then per frame begin(), draw fire layers with the haze sprite shader at (width(), height()), end(), apply()
+ */
+class HeatHaze {
+    public:
+        Shader* particleShader;     // sprite shader writing distortion
+        RenderTarget* distortion;   // RG16F offsets, at 1 / factor resolution
+        RenderTarget* sceneCopy;    // scene color, resampled by the composite
+        float strength = 0.015f;
+        int factor;
+
+        /**
+         * @brief Construct a new HeatHaze object
+         *
+         * @param rx Width of the scene in pixels
+         * @param ry Height of the scene in pixels
+         * @param sceneFormat Color format of the scene framebuffer, so the copy keeps its range. Defaults to GL_RGBA8
+         * @param factor Resolution divisor of the distortion buffer. Defaults to 4
+         */
+        HeatHaze(int rx, int ry, GLenum sceneFormat = GL_RGBA8, int factor = 4) : factor(factor), rx(rx), ry(ry) {
+            particleShader = new Shader("shaders/particle.vert", "shaders/particle_haze.frag");
+            compositeShader = new Shader("shaders/fullscreen.vert", "shaders/haze_composite.frag");
+
+            distortion = new RenderTarget((rx + factor - 1) / factor, (ry + factor - 1) / factor, {GL_RG16F});
+            sceneCopy = new RenderTarget(rx, ry, {sceneFormat});
+        }
+
+        ~HeatHaze() {
+            delete distortion;
+            delete sceneCopy;
+            delete particleShader;
+            delete compositeShader;
+        }
+
+        // size of the distortion buffer, in pixels
+        int width() { return distortion->width; }
+        int height() { return distortion->height; }
+
+        /**
+         * @brief Sets the tiling 3D noise the distortion is drawn from. The texture is owned by the caller
+         *
+         * @param texture RGBA 3D texture holding curl in rgb, as built from NoiseField::interleaved()
+         */
+        void setNoise(unsigned int texture) { noise = texture; }
+
+        /**
+         * @brief Clears and binds the distortion buffer, with additive blending
+         *
+         * @param time Seconds since start, scrolls the noise
+         */
+        void begin(float time) {
+            distortion->bind();
+            const float zero[4] = {0, 0, 0, 0};
+            glClearBufferfv(GL_COLOR, 0, zero);
+
+            particleShader->use();
+            particleShader->setInt("noiseTexture", 3);
+            particleShader->setFloat("time", time);
+            particleShader->setFloat("strength", strength);
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_3D, noise);
+            glActiveTexture(GL_TEXTURE0);
+
+            glDisable(GL_DEPTH_TEST);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+        }
+
+        void end() {
+            glDisable(GL_BLEND);
+            glEnable(GL_DEPTH_TEST);
+            RenderTarget::bindScene(rx, ry);
+        }
+
+        /**
+         * @brief Copies the scene framebuffer's color and redraws it through the distortion buffer
+         */
+        void apply() {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, RenderTarget::sceneFbo());
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneCopy->fbo);
+            glBlitFramebuffer(0, 0, rx, ry, 0, 0, rx, ry, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            RenderTarget::bindScene(rx, ry);
+
+            compositeShader->use();
+            compositeShader->setInt("sceneTexture", 0);
+            compositeShader->setInt("distortionTexture", 1);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, sceneCopy->colors[0]);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, distortion->colors[0]);
+
+            glDisable(GL_DEPTH_TEST);
+            drawFullscreenTriangle();
+            glEnable(GL_DEPTH_TEST);
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+    private:
+        int rx, ry;
+        Shader* compositeShader;
+        unsigned int noise = 0;
+};
+
+#endif
@@ -63,20 +63,29 @@ struct Texture {
     string path;
 };
 
+// Floats per light record; see the interpretation table below
+#define LIGHT_FLOATS 10
+
 /**
  * @brief Abstract light class
  */
 class Light {
     public:
-        // returns data to be interpreted by a shader storage buffer object (SSBO; see https://www.khronos.org/opengl/wiki/Shader_Storage_Buffer_Object)
-        virtual vector<float> parseData();
+        int slot = -1;          // record index in a LightBuffer, -1 if not in one
+        float intensity;
+
+        Light(float intensity) : intensity(intensity) {}
+        virtual ~Light() {}
+
+        // writes this light's LIGHT_FLOATS record, as interpreted by a shader storage buffer object (SSBO; see https://www.khronos.org/opengl/wiki/Shader_Storage_Buffer_Object), in place
+        virtual void parseData(float* dst) const = 0;
 };
 
 /* ----- LIGHT INTERPRETATION TABLE ----- *\
 Always      ID      Intensity
 Index       0       1       2       3       4       5       6       7       8       9
 DirLight    0       INTSTY  dir.x   dir.y   dir.z   0       0       0       0       0
-PntLight    1       INTSTY  pos.x   pos.y   pos.z   0       0       0       0       0
+PntLight    1       INTSTY  pos.x   pos.y   pos.z   radius  col.r   col.g   col.b   shadow
 SptLight    2       INTSTY  pos.x   pos.y   pos.z   dir.x   dir.y   dir.z   cutoff  fade
 \* -------------------------------------- */
 
@@ -85,23 +94,94 @@ SptLight    2       INTSTY  pos.x   pos.y   pos.z   dir.x   dir.y   dir.z   cuto
  */
 class DirLight : public Light {
     public:
+        glm::vec3 direction;    // direction the light travels
+
+        DirLight(glm::vec3 direction, float intensity) : Light(intensity), direction(direction) {}
 
+        void parseData(float* dst) const override {
+            dst[0] = 0; dst[1] = intensity;
+            dst[2] = direction.x; dst[3] = direction.y; dst[4] = direction.z;
+            dst[5] = 0; dst[6] = 0; dst[7] = 0; dst[8] = 0; dst[9] = 0;
+        }
 };
 
 /**
  * @brief Point class of light
  */
 class PntLight : public Light {
+    public:
+        glm::vec3 position;
+        float radius;           // distance at which the light has faded to nothing; bounds it for light culling
+        glm::vec3 color = glm::vec3(1.0f);
+        int shadow = -1;        // shadow atlas tile (see shadows.h), -1 if unshadowed
+
+        PntLight(glm::vec3 position, float intensity, float radius = 5.0f) : Light(intensity), position(position), radius(radius) {}
 
+        void parseData(float* dst) const override {
+            dst[0] = 1; dst[1] = intensity;
+            dst[2] = position.x; dst[3] = position.y; dst[4] = position.z;
+            dst[5] = radius; dst[6] = color.x; dst[7] = color.y; dst[8] = color.z; dst[9] = shadow;
+        }
 };
 
 /**
  * @brief Spotlight class of light
  */
 class SptLight : public Light {
-
+    public:
+        glm::vec3 position;
+        glm::vec3 direction;    // direction the cone points
+        float cutoff;           // cosine of the cone's half angle
+        float fade;             // cosine range over which the edge of the cone fades out
+
+        SptLight(glm::vec3 position, glm::vec3 direction, float cutoff, float fade, float intensity) : Light(intensity), position(position), direction(direction), cutoff(cutoff), fade(fade) {}
+
+        void parseData(float* dst) const override {
+            dst[0] = 2; dst[1] = intensity;
+            dst[2] = position.x; dst[3] = position.y; dst[4] = position.z;
+            dst[5] = direction.x; dst[6] = direction.y; dst[7] = direction.z;
+            dst[8] = cutoff; dst[9] = fade;
+        }
 };
 
+/**
+ * @brief Expands #include "file" lines of GLSL source, recursively, with paths relative to the including file. #line directives keep compile errors pointing at the right lines
+ *
+ * @param source Shader source
+ * @param path Path the source was read from
+ * @param depth Include depth, to stop include cycles. Defaults to 0
+ * @return string expanded source
+ */
+inline string expandShaderIncludes(const string& source, const string& path, int depth = 0) {
+    if (source.find("#include") == string::npos)
+        return source;
+
+    string directory = path.substr(0, path.find_last_of("/\\") + 1);
+    std::stringstream in(source), out;
+    string line;
+    int lineNumber = 0;
+    while (std::getline(in, line)) {
+        lineNumber++;
+        size_t start = line.find_first_not_of(" \t");
+        if (start == string::npos || line.compare(start, 8, "#include") != 0) {
+            out << line << "\n";
+            continue;
+        }
+
+        size_t open = line.find('"', start), close = line.find('"', open + 1);
+        string includePath = directory + line.substr(open + 1, close - open - 1);
+        std::ifstream file(includePath);
+        if (open == string::npos || close == string::npos || !file.is_open() || depth > 8) {
+            std::cout << "ERROR::SHADER::INCLUDE_FAILED: " << includePath << " (from " << path << ")" << std::endl;
+            continue;
+        }
+        std::stringstream included;
+        included << file.rdbuf();
+        out << "#line 1\n" << expandShaderIncludes(included.str(), includePath, depth + 1) << "\n#line " << lineNumber + 1 << "\n";
+    }
+    return out.str();
+}
+
 /**
  * @brief Defines a shader class to bind and store information on a set of vertex/fragment/(geometry) shaders. Geometry optional (and default null). (adpated from https://learnopengl.com/code_viewer_gh.php?code=includes/learnopengl/shader.h)
  */
@@ -137,8 +217,8 @@ class Shader {
                 fShaderFile.close();
                 
                 // convert stream into string
-                vertexCode = vShaderStream.str();
-                fragmentCode = fShaderStream.str();			
+                vertexCode = expandShaderIncludes(vShaderStream.str(), vertexPath);
+                fragmentCode = expandShaderIncludes(fShaderStream.str(), fragmentPath);
                 
                 // if geometry shader path is present, also load a geometry shader
                 if(geometryPath != nullptr) {
@@ -146,7 +226,7 @@ class Shader {
                     std::stringstream gShaderStream;
                     gShaderStream << gShaderFile.rdbuf();
                     gShaderFile.close();
-                    geometryCode = gShaderStream.str();
+                    geometryCode = expandShaderIncludes(gShaderStream.str(), geometryPath);
                 }
             } catch (std::ifstream::failure& e) {
                 std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << e.what() << std::endl;
@@ -208,6 +288,10 @@ class Shader {
             glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
         }
         
+        void setIVec3(const std::string &name, int x, int y, int z) const { 
+            glUniform3i(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        }
+        
         void setFloat(const std::string &name, float value) const { 
             glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
         }
@@ -266,6 +350,154 @@ class Shader {
         }
 };
 
+/**
+ * @brief Defines a compute shader program, loaded and compiled from a single file. Mirrors the Shader interface
+ */
+class ComputeShader {
+    public:
+        unsigned int ID;
+
+        ComputeShader(const char* computePath) {
+            string computeCode;
+            std::ifstream cShaderFile;
+            cShaderFile.exceptions (std::ifstream::failbit | std::ifstream::badbit);
+
+            try {
+                cShaderFile.open(computePath);
+                std::stringstream cShaderStream;
+                cShaderStream << cShaderFile.rdbuf();
+                cShaderFile.close();
+                computeCode = expandShaderIncludes(cShaderStream.str(), computePath);
+            } catch (std::ifstream::failure& e) {
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << computePath << " " << e.what() << std::endl;
+            }
+
+            const char* cShaderCode = computeCode.c_str();
+
+            unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+            glShaderSource(compute, 1, &cShaderCode, NULL);
+            glCompileShader(compute);
+            checkCompileErrors(compute, "COMPUTE");
+
+            ID = glCreateProgram();
+            glAttachShader(ID, compute);
+            glLinkProgram(ID);
+            checkCompileErrors(ID, "PROGRAM");
+
+            glDeleteShader(compute);
+        }
+
+        void use() {
+            glUseProgram(ID);
+        }
+
+        // dispatches enough work groups of the given local size to cover count invocations along x
+        void dispatch(unsigned int count, unsigned int localSize) {
+            if (count > 0)
+                glDispatchCompute((count + localSize - 1) / localSize, 1, 1);
+        }
+
+        void setBool(const std::string &name, bool value) const {
+            glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        }
+
+        void setInt(const std::string &name, int value) const {
+            glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        }
+
+        void setUInt(const std::string &name, unsigned int value) const {
+            glUniform1ui(glGetUniformLocation(ID, name.c_str()), value);
+        }
+
+        void setFloat(const std::string &name, float value) const {
+            glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        }
+
+        void setVec2(const std::string &name, const glm::vec2 &value) const {
+            glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        }
+
+        void setVec3(const std::string &name, const glm::vec3 &value) const {
+            glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        }
+
+        void setVec4(const std::string &name, const glm::vec4 &value) const {
+            glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        }
+
+        void setMat4(const std::string &name, const glm::mat4 &mat) const {
+            glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        }
+
+    private:
+        void checkCompileErrors(GLuint shader, string type) {
+            GLint success;
+            GLchar infoLog[1024];
+            if(type != "PROGRAM") {
+                glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+                if(!success) {
+                    glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+                    std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << std::endl;
+                }
+            }
+            else {
+                glGetProgramiv(shader, GL_LINK_STATUS, &success);
+                if(!success) {
+                    glGetProgramInfoLog(shader, 1024, NULL, infoLog);
+                    std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << std::endl;
+                }
+            }
+        }
+};
+
+/**
+ * @brief Measures GPU time between begin() and end() with timestamp queries. Double-buffered, so results lag by one frame and never stall the pipeline
+ */
+class GpuTimer {
+    public:
+        GpuTimer() {
+            glGenQueries(4, &queries[0][0]);
+        }
+
+        ~GpuTimer() {
+            glDeleteQueries(4, &queries[0][0]);
+        }
+
+        void begin() {
+            glQueryCounter(queries[cur][0], GL_TIMESTAMP);
+        }
+
+        void end() {
+            glQueryCounter(queries[cur][1], GL_TIMESTAMP);
+            issued[cur] = true;
+
+            // collect the other pair if the GPU is done with it
+            int prev = cur ^ 1;
+            if (issued[prev]) {
+                GLint available = 0;
+                glGetQueryObjectiv(queries[prev][1], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available) {
+                    GLuint64 t0, t1;
+                    glGetQueryObjectui64v(queries[prev][0], GL_QUERY_RESULT, &t0);
+                    glGetQueryObjectui64v(queries[prev][1], GL_QUERY_RESULT, &t1);
+                    ms = (t1 - t0) / 1000000.0f;
+                }
+            }
+            cur = prev;
+        }
+
+        // most recent completed measurement, in milliseconds
+        float getMs() {
+            return ms;
+        }
+
+    private:
+        GLuint queries[2][2];
+        bool issued[2] = {false, false};
+        int cur = 0;
+        float ms = 0.0f;
+};
+
 /**
  * @brief Defines a mesh including sets of vertices, indices, and texture structs
  */
@@ -556,10 +788,10 @@ inline unsigned int textureFromFile(const char *path, const string &directory, b
     filename = directory + '/' + filename;
 
     SDL_Surface* surf = IMG_Load(filename.c_str());
-    flipSurface(surf);
     if (surf == NULL) {
         SDL_Log("Unable to initialize texture: %s\n", IMG_GetError()); return 0;
     }
+    flipSurface(surf);
 
     unsigned int textureID;
     glGenTextures(1, &textureID);
@@ -570,14 +802,13 @@ inline unsigned int textureFromFile(const char *path, const string &directory, b
     height = surf->h;
 
     GLenum format;
-    // TODO: Reimplement texture format detection accurately
-    /*if (nrComponents == 1)
+    int nrComponents = surf->format->BytesPerPixel;
+    if (nrComponents == 1)
         format = GL_RED;
-    else if (nrComponents == 3)
-        format = GL_RGB;
     else if (nrComponents == 4)
-        format = GL_RGBA;*/
-    format = GL_RGB;
+        format = GL_RGBA;
+    else
+        format = GL_RGB;
 
     glBindTexture(GL_TEXTURE_2D, textureID);
     glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
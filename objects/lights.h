@@ -0,0 +1,173 @@
+/**
+ * @file lights.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Shared light SSBO. Light records (see the interpretation table in helper.h) are packed in place into a CPU copy, and each frame only the range written since a region was last used is copied into a persistently mapped, explicitly flushed buffer. The buffer is split into regions used round robin and fenced, so the CPU never writes a region the GPU may still be reading
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include <cstring>
+#include <algorithm>
+
+#include "helper.h"
+
+// SSBO binding of the current light region
+#define LIGHT_BINDING 4
+
+// Regions (frames in flight) of the light buffer
+#define LIGHT_BUFFER_REGIONS 3
+
+/**
+ * @brief A fixed-capacity set of lights on the GPU. Per frame: write() lights that changed, flush() before drawing, bind(), draw, then endFrame(). Nothing in that path allocates
+ */
+class LightBuffer {
+    public:
+        GLuint buffer;
+        unsigned int capacity;
+        vector<Light*> lights;  // lights by slot
+
+        LightBuffer(unsigned int capacity) : capacity(capacity), shadow(capacity * LIGHT_FLOATS, 0.0f) {
+            lights.reserve(capacity);
+
+            // regions start on the SSBO offset alignment
+            GLint alignment = 256;
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            regionSize = (capacity * LIGHT_FLOATS * sizeof(float) + alignment - 1) / alignment * alignment;
+
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT;
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, regionSize * LIGHT_BUFFER_REGIONS, NULL, flags);
+            mapped = (char*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, regionSize * LIGHT_BUFFER_REGIONS, flags | GL_MAP_FLUSH_EXPLICIT_BIT);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            if (mapped == NULL)
+                std::cout << "ERROR::LIGHTBUFFER:: could not map light buffer" << std::endl;
+
+            for (int r = 0; r < LIGHT_BUFFER_REGIONS; r++) {
+                fences[r] = 0;
+                dirtyBegin[r] = 0;
+                dirtyEnd[r] = 0;
+            }
+        }
+
+        ~LightBuffer() {
+            for (int r = 0; r < LIGHT_BUFFER_REGIONS; r++)
+                if (fences[r] != 0)
+                    glDeleteSync(fences[r]);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+        }
+
+        unsigned int getCount() {
+            return lights.size();
+        }
+
+        /**
+         * @brief Adds a light to the next free slot (the buffer does not take ownership)
+         *
+         * @return bool false if the buffer is full
+         */
+        bool add(Light* light) {
+            if (lights.size() >= capacity)
+                return false;
+            light->slot = lights.size();
+            lights.push_back(light);
+            write(light);
+            return true;
+        }
+
+        /**
+         * @brief Removes a light; the last light moves into its slot
+         */
+        void remove(Light* light) {
+            int slot = light->slot;
+            if (slot < 0 || slot >= (int)lights.size() || lights[slot] != light)
+                return;
+
+            Light* last = lights.back();
+            lights.pop_back();
+            light->slot = -1;
+            if (last != light) {
+                last->slot = slot;
+                lights[slot] = last;
+                write(last);
+            }
+        }
+
+        /**
+         * @brief Packs a light's record after its fields changed. It reaches the GPU on the next flush()
+         */
+        void write(const Light* light) {
+            if (light->slot < 0)
+                return;
+            light->parseData(&shadow[light->slot * LIGHT_FLOATS]);
+            markDirty(light->slot, light->slot + 1);
+        }
+
+        /**
+         * @brief Moves to the next region and brings it up to date: waits until the GPU is done with it, copies the records written since it was last used, and flushes that range
+         */
+        void flush() {
+            region = (region + 1) % LIGHT_BUFFER_REGIONS;
+            if (fences[region] != 0) {
+                glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+                glDeleteSync(fences[region]);
+                fences[region] = 0;
+            }
+
+            unsigned int begin = dirtyBegin[region], end = dirtyEnd[region];
+            if (begin < end && mapped != NULL) {
+                size_t offset = region * regionSize + begin * LIGHT_FLOATS * sizeof(float);
+                size_t bytes = (end - begin) * LIGHT_FLOATS * sizeof(float);
+                memcpy(mapped + offset, &shadow[begin * LIGHT_FLOATS], bytes);
+
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+                glFlushMappedBufferRange(GL_SHADER_STORAGE_BUFFER, offset, bytes);
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            }
+            dirtyBegin[region] = 0;
+            dirtyEnd[region] = 0;
+        }
+
+        // binds the current region as the light SSBO
+        void bind(GLuint binding = LIGHT_BINDING) {
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, buffer, region * regionSize, regionSize);
+        }
+
+        // fences the current region after the last draw that reads it this frame
+        void endFrame() {
+            if (fences[region] != 0)
+                glDeleteSync(fences[region]);
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+    private:
+        vector<float> shadow;       // packed records of every light
+        char* mapped = NULL;
+        size_t regionSize;
+        int region = 0;
+        GLsync fences[LIGHT_BUFFER_REGIONS];
+        unsigned int dirtyBegin[LIGHT_BUFFER_REGIONS], dirtyEnd[LIGHT_BUFFER_REGIONS];  // slots each region is missing
+
+        // every region is missing slots [begin, end) until its next flush
+        void markDirty(unsigned int begin, unsigned int end) {
+            for (int r = 0; r < LIGHT_BUFFER_REGIONS; r++) {
+                if (dirtyBegin[r] >= dirtyEnd[r]) {
+                    dirtyBegin[r] = begin;
+                    dirtyEnd[r] = end;
+                } else {
+                    dirtyBegin[r] = std::min(dirtyBegin[r], begin);
+                    dirtyEnd[r] = std::max(dirtyEnd[r], end);
+                }
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,182 @@
+/**
+ * @file lowres.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Reduced-resolution particle rendering for fill-rate bound layers. Particles are drawn into a 1/2 or 1/4 resolution target depth tested against downsampled scene depth, then upsampled over the scene with nearest-depth upsampling; pixels on depth edges are stenciled and redrawn at full resolution instead
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef LOWRES_H
+#define LOWRES_H
+
+#include "helper.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "depth.h"
+
+// Stencil value marking full-resolution edge pixels in the scene framebuffer
+#define LOWRES_EDGE_STENCIL 1
+
+/**
+ * @brief Low-resolution particle target and its passes. Usage per frame: begin(), then for each particle draw bindLowRes() + draw at (width, height) and beginFixup() + draw at full resolution + endFixup(), then composite()
+ */
+class LowResParticlePass {
+    public:
+        int factor = 1;             // resolution divisor (1, 2 or 4); 1 bypasses the pass
+        float threshold = 0.05f;    // relative depth difference treated as an edge
+        RenderTarget* target = NULL;
+
+        /**
+         * @brief Construct a new LowResParticlePass object
+         *
+         * @param rx Width of the scene in pixels
+         * @param ry Height of the scene in pixels
+         */
+        LowResParticlePass(int rx, int ry) : rx(rx), ry(ry) {
+            depthShader = new Shader("shaders/fullscreen.vert", "shaders/lowres_depth.frag");
+            edgeShader = new Shader("shaders/fullscreen.vert", "shaders/lowres_edges.frag");
+            compositeShader = new Shader("shaders/fullscreen.vert", "shaders/lowres_composite.frag");
+        }
+
+        ~LowResParticlePass() {
+            delete target;
+            delete depthShader;
+            delete edgeShader;
+            delete compositeShader;
+        }
+
+        // sets the resolution divisor, reallocating the target if it changed
+        void setFactor(int f) {
+            if (f == factor && (target != NULL || f == 1))
+                return;
+            factor = f;
+            delete target;
+            target = NULL;
+            if (factor == 1)
+                return;
+
+            // color holds premultiplied particles in rgb and the transmittance left over the scene in alpha
+            target = new RenderTarget((rx + factor - 1) / factor, (ry + factor - 1) / factor, {GL_RGBA16F}, GL_DEPTH24_STENCIL8);
+            glBindTexture(GL_TEXTURE_2D, target->depth);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+
+        // size of the low-resolution target, in pixels
+        int width() { return target->width; }
+        int height() { return target->height; }
+
+        /**
+         * @brief Downsamples scene depth into the target, stencils the full-resolution edge pixels, and clears the target for particles
+         *
+         * @param depth Scene depth, resolved this frame
+         * @param camera Camera the scene was drawn with
+         */
+        void begin(SceneDepth* depth, Camera* camera) {
+            target->bind();
+            depthShader->use();
+            depthShader->setInt("depthTexture", 0);
+            depthShader->setInt("factor", factor);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, depth->full->depth);
+
+            glEnable(GL_DEPTH_TEST);
+            glDepthFunc(GL_ALWAYS);
+            glDepthMask(GL_TRUE);
+            glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+            drawFullscreenTriangle();
+            glDepthFunc(GL_LESS);
+
+            // edges go to the scene framebuffer's stencil, where the full-resolution fix-up draws
+            RenderTarget::bindScene(rx, ry);
+            glStencilMask(0xFF);
+            glClear(GL_STENCIL_BUFFER_BIT);
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_ALWAYS, LOWRES_EDGE_STENCIL, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+            glDisable(GL_DEPTH_TEST);
+
+            edgeShader->use();
+            setDepthUniforms(edgeShader, depth, camera);
+            drawFullscreenTriangle();
+
+            glDisable(GL_STENCIL_TEST);
+            glEnable(GL_DEPTH_TEST);
+            glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+            target->bind();
+            const float clear[4] = {0, 0, 0, 1};
+            glClearBufferfv(GL_COLOR, 0, clear);
+            RenderTarget::bindScene(rx, ry);
+        }
+
+        // binds the low-resolution target for particle draws
+        void bindLowRes() {
+            target->bind();
+        }
+
+        // binds the scene framebuffer, restricted to edge pixels
+        void beginFixup() {
+            RenderTarget::bindScene(rx, ry);
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_EQUAL, LOWRES_EDGE_STENCIL, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+        }
+
+        void endFixup() {
+            glDisable(GL_STENCIL_TEST);
+        }
+
+        /**
+         * @brief Upsamples the low-resolution particles over the scene framebuffer, everywhere but the edge pixels
+         *
+         * @param depth Scene depth, resolved this frame
+         * @param camera Camera the scene was drawn with
+         */
+        void composite(SceneDepth* depth, Camera* camera) {
+            RenderTarget::bindScene(rx, ry);
+            compositeShader->use();
+            setDepthUniforms(compositeShader, depth, camera);
+            compositeShader->setInt("colorTexture", 2);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_2D, target->colors[0]);
+
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_NOTEQUAL, LOWRES_EDGE_STENCIL, 0xFF);
+            glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+            glDisable(GL_DEPTH_TEST);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_SRC_ALPHA);
+            drawFullscreenTriangle();
+            glDisable(GL_BLEND);
+            glEnable(GL_DEPTH_TEST);
+            glDisable(GL_STENCIL_TEST);
+
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+    private:
+        int rx, ry;
+        Shader* depthShader;
+        Shader* edgeShader;
+        Shader* compositeShader;
+
+        // binds full (unit 0) and low-resolution (unit 1) depth
+        void setDepthUniforms(Shader* shader, SceneDepth* depth, Camera* camera) {
+            shader->setInt("depthTexture", 0);
+            shader->setInt("lowDepthTexture", 1);
+            shader->setFloat("nearPlane", camera->nearPlane);
+            shader->setFloat("farPlane", camera->farPlane);
+            shader->setFloat("threshold", threshold);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, depth->full->depth);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, target->depth);
+            glActiveTexture(GL_TEXTURE0);
+        }
+};
+
+#endif
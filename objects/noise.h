@@ -0,0 +1,502 @@
+/**
+ * @file noise.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Tiling 3D noise and curl-noise fields for turbulence. Fields are generated across cores with SIMD kernels, cached on disk under a name built from their parameters, and sampled either as a 3D texture on the GPU or with a vectorized trilinear sampler on the CPU, so both particle paths feel the same flow
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <string>
+using std::vector;
+using std::string;
+
+#include <glm/glm.hpp>
+
+#include "../util/jobs/jobs.h"
+#include "../util/timer.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NOISE_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NOISE_SIMD_WIDTH 4
+#else
+#define NOISE_SIMD_WIDTH 1
+#endif
+
+// Cache file header
+#define NOISE_MAGIC 0x53494f4eu     // "NOIS"
+#define NOISE_VERSION 1u
+
+// SIMD vectors of particles whose corner loads are overlapped (AVX2 curl sampler)
+#define NOISE_BATCH 8
+
+/**
+ * @brief Everything a noise field depends on; two fields with equal parameters are identical, which is what keys the disk cache
+ */
+struct NoiseParams {
+    int size = 64;              // voxels per side, a power of two
+    int period = 4;             // lattice cells per side at the lowest octave
+    int octaves = 4;            // octaves past size / period voxels per cell are skipped
+    float persistence = 0.5f;   // amplitude ratio between successive octaves
+    uint32_t seed = 1;
+
+    // cache file name
+    string cacheName() const {
+        char name[96];
+        snprintf(name, sizeof(name), "noise_%d_%d_%d_%.3f_%u.bin", size, period, octaves, persistence, seed);
+        return name;
+    }
+
+    bool operator==(const NoiseParams& o) const {
+        return size == o.size && period == o.period && octaves == o.octaves && persistence == o.persistence && seed == o.seed;
+    }
+};
+
+/**
+ * @brief Bilinear blend of four lattice rows: out[i] = lerp(lerp(a, b, wy), lerp(c, d, wy), wz)[i]
+ */
+inline void noiseLerpRows(float* out, const float* a, const float* b, const float* c, const float* d, float wy, float wz, int n) {
+    int i = 0;
+#if NOISE_SIMD_WIDTH == 8
+    const __m256 vy = _mm256_set1_ps(wy), vz = _mm256_set1_ps(wz);
+    for (; i + 8 <= n; i += 8) {
+        __m256 va = _mm256_loadu_ps(a + i), vc = _mm256_loadu_ps(c + i);
+        __m256 lo = _mm256_add_ps(va, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(b + i), va), vy));
+        __m256 hi = _mm256_add_ps(vc, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(d + i), vc), vy));
+        _mm256_storeu_ps(out + i, _mm256_add_ps(lo, _mm256_mul_ps(_mm256_sub_ps(hi, lo), vz)));
+    }
+#elif NOISE_SIMD_WIDTH == 4
+    const __m128 vy = _mm_set1_ps(wy), vz = _mm_set1_ps(wz);
+    for (; i + 4 <= n; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i), vc = _mm_loadu_ps(c + i);
+        __m128 lo = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b + i), va), vy));
+        __m128 hi = _mm_add_ps(vc, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(d + i), vc), vy));
+        _mm_storeu_ps(out + i, _mm_add_ps(lo, _mm_mul_ps(_mm_sub_ps(hi, lo), vz)));
+    }
+#endif
+    for (; i < n; i++) {
+        float lo = a[i] + (b[i] - a[i]) * wy, hi = c[i] + (d[i] - c[i]) * wy;
+        out[i] = lo + (hi - lo) * wz;
+    }
+}
+
+/**
+ * @brief Adds one octave along a row of voxels: out[x] += amplitude * lerp(line[xi[x]], line[xi[x] + 1], xw[x])
+ */
+inline void noiseAccumulateRow(float* out, const float* line, const int* xi, const float* xw, float amplitude, int n) {
+    int x = 0;
+#if NOISE_SIMD_WIDTH == 8
+    const __m256 amp = _mm256_set1_ps(amplitude);
+    for (; x + 8 <= n; x += 8) {
+        __m256i i0 = _mm256_loadu_si256((const __m256i*)(xi + x));
+        __m256 v0 = _mm256_i32gather_ps(line, i0, 4);
+        __m256 v1 = _mm256_i32gather_ps(line + 1, i0, 4);
+        __m256 v = _mm256_add_ps(v0, _mm256_mul_ps(_mm256_sub_ps(v1, v0), _mm256_loadu_ps(xw + x)));
+        _mm256_storeu_ps(out + x, _mm256_add_ps(_mm256_loadu_ps(out + x), _mm256_mul_ps(v, amp)));
+    }
+#endif
+    for (; x < n; x++) {
+        float v0 = line[xi[x]], v1 = line[xi[x] + 1];
+        out[x] += amplitude * (v0 + (v1 - v0) * xw[x]);
+    }
+}
+
+/**
+ * @brief A tiling scalar noise field and a divergence-free curl-noise field over the same grid, stored as planar float arrays (x fastest, then y, then z). Positions are measured in tiles: the field repeats every 1 unit
+ */
+class NoiseField {
+    public:
+        NoiseParams params;
+        vector<float> noise;                // fBm in [0, 1]
+        vector<float> curlX, curlY, curlZ;  // curl of a fBm vector potential, scaled to unit RMS magnitude
+        vector<float> records;              // the same voxels as 16-byte (curl.x, curl.y, curl.z, noise) records, for the samplers and the texture
+        double lastMs = 0.0;                // time the last import took
+
+        /**
+         * @brief Builds the fields: four independent fBm fields (three potential components and the scalar noise) in parallel over z slices, then the curl of the potential by central differences
+         *
+         * @param p Parameters; size is rounded up to a power of two
+         * @param jobs Job system to run on
+         */
+        void generate(const NoiseParams& p, JobSystem* jobs) {
+            params = p;
+            int size = 1;
+            while (size < p.size)
+                size <<= 1;
+            params.size = size;
+            size_t voxels = (size_t)size * size * size;
+
+            // the three potential components, then the scalar noise
+            vector<float> fields[4];
+            for (int c = 0; c < 4; c++)
+                fields[c].resize(voxels);
+
+            // periodic lattices of every (field, octave), and where each voxel column falls in them
+            struct Octave {
+                int cells;
+                float amplitude;
+                vector<int> xi;
+                vector<float> xw;
+                vector<float> lattice[4];
+            };
+            vector<Octave> octaves;
+            float amplitude = 1.0f, total = 0.0f;
+            for (int o = 0, cells = params.period; o < params.octaves && cells <= size; o++, cells *= 2, amplitude *= params.persistence) {
+                Octave oct;
+                oct.cells = cells;
+                oct.amplitude = amplitude;
+                oct.xi.resize(size);
+                oct.xw.resize(size);
+                for (int x = 0; x < size; x++) {
+                    float u = (float)x * cells / size;
+                    oct.xi[x] = (int)u;
+                    oct.xw[x] = fade(u - (int)u);
+                }
+                for (int c = 0; c < 4; c++) {
+                    oct.lattice[c].resize((size_t)cells * cells * cells);
+                    uint32_t salt = hash(params.seed * 0x9E3779B9u + c * 0x85EBCA6Bu + o * 0xC2B2AE35u);
+                    for (size_t i = 0; i < oct.lattice[c].size(); i++)
+                        oct.lattice[c][i] = (hash((uint32_t)i ^ salt) & 0xFFFF) / 32767.5f - 1.0f;
+                }
+                octaves.push_back(oct);
+                total += amplitude;
+            }
+
+            jobs->parallelFor(size, 1, [&](size_t zBegin, size_t zEnd) {
+                vector<float> line(size + 1);
+                for (size_t z = zBegin; z < zEnd; z++) {
+                    for (int c = 0; c < 4; c++) {
+                        for (int y = 0; y < size; y++) {
+                            float* row = &fields[c][((size_t)z * size + y) * size];
+                            std::fill(row, row + size, 0.0f);
+                            for (unsigned int o = 0; o < octaves.size(); o++) {
+                                const Octave& oct = octaves[o];
+                                int L = oct.cells;
+                                float v = (float)y * L / size, w = (float)z * L / size;
+                                int y0 = (int)v, z0 = (int)w, y1 = (y0 + 1) % L, z1 = (z0 + 1) % L;
+                                const float* lat = &oct.lattice[c][0];
+
+                                // lattice row across x at this voxel row's (y, z), plus one wrapped entry
+                                noiseLerpRows(&line[0], lat + ((size_t)z0 * L + y0) * L, lat + ((size_t)z0 * L + y1) * L,
+                                              lat + ((size_t)z1 * L + y0) * L, lat + ((size_t)z1 * L + y1) * L, fade(v - y0), fade(w - z0), L);
+                                line[L] = line[0];
+                                noiseAccumulateRow(row, &line[0], &oct.xi[0], &oct.xw[0], oct.amplitude / total, size);
+                            }
+                        }
+                    }
+                }
+            });
+
+            noise.resize(voxels);
+            curlX.resize(voxels);
+            curlY.resize(voxels);
+            curlZ.resize(voxels);
+            vector<double> sumSquares(size, 0.0);
+            jobs->parallelFor(size, 1, [&](size_t zBegin, size_t zEnd) {
+                int mask = size - 1;
+                float inv2h = size * 0.5f;
+                for (size_t z = zBegin; z < zEnd; z++) {
+                    for (int y = 0; y < size; y++) {
+                        size_t row = ((size_t)z * size + y) * size;
+                        size_t rowYp = ((size_t)z * size + ((y + 1) & mask)) * size, rowYm = ((size_t)z * size + ((y - 1) & mask)) * size;
+                        size_t rowZp = ((size_t)((z + 1) & mask) * size + y) * size, rowZm = ((size_t)((z - 1) & mask) * size + y) * size;
+                        const float* px = &fields[0][0];
+                        const float* py = &fields[1][0];
+                        const float* pz = &fields[2][0];
+                        double ss = 0.0;
+                        // branch-free over contiguous rows; only the x neighbours wrap
+                        for (int x = 0; x < size; x++) {
+                            int xp = (x + 1) & mask, xm = (x - 1) & mask;
+                            float cx = (pz[rowYp + x] - pz[rowYm + x] - py[rowZp + x] + py[rowZm + x]) * inv2h;
+                            float cy = (px[rowZp + x] - px[rowZm + x] - pz[row + xp] + pz[row + xm]) * inv2h;
+                            float cz = (py[row + xp] - py[row + xm] - px[rowYp + x] + px[rowYm + x]) * inv2h;
+                            curlX[row + x] = cx;
+                            curlY[row + x] = cy;
+                            curlZ[row + x] = cz;
+                            noise[row + x] = fields[3][row + x] * 0.5f + 0.5f;
+                            ss += cx * cx + cy * cy + cz * cz;
+                        }
+                        sumSquares[z] += ss;
+                    }
+                }
+            });
+
+            double ss = 0.0;
+            for (int z = 0; z < size; z++)
+                ss += sumSquares[z];
+            float scale = ss > 0.0 ? (float)(1.0 / sqrt(ss / voxels)) : 1.0f;
+            jobs->parallelFor(voxels, voxels / jobs->getThreadCount() + 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    curlX[i] *= scale;
+                    curlY[i] *= scale;
+                    curlZ[i] *= scale;
+                }
+            });
+            interleave();
+        }
+
+        /**
+         * @brief Writes the fields to a cache file
+         *
+         * @return bool representing the success of the operation
+         */
+        bool save(const string& path) {
+            FILE* file = fopen(path.c_str(), "wb");
+            if (file == NULL)
+                return false;
+            uint32_t header[2] = {NOISE_MAGIC, NOISE_VERSION};
+            bool ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(&params, sizeof(params), 1, file) == 1;
+            const vector<float>* channels[4] = {&noise, &curlX, &curlY, &curlZ};
+            for (int c = 0; c < 4 && ok; c++)
+                ok = fwrite(&(*channels[c])[0], sizeof(float), channels[c]->size(), file) == channels[c]->size();
+            fclose(file);
+            return ok;
+        }
+
+        /**
+         * @brief Reads the fields from a cache file, if it exists and was built with the same parameters
+         *
+         * @return bool representing the success of the operation
+         */
+        bool load(const string& path, const NoiseParams& p) {
+            FILE* file = fopen(path.c_str(), "rb");
+            if (file == NULL)
+                return false;
+
+            uint32_t header[2];
+            NoiseParams stored;
+            bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == NOISE_MAGIC && header[1] == NOISE_VERSION
+                   && fread(&stored, sizeof(stored), 1, file) == 1 && stored == p;
+            if (ok) {
+                params = stored;
+                size_t voxels = (size_t)p.size * p.size * p.size;
+                vector<float>* channels[4] = {&noise, &curlX, &curlY, &curlZ};
+                for (int c = 0; c < 4 && ok; c++) {
+                    channels[c]->resize(voxels);
+                    ok = fread(&(*channels[c])[0], sizeof(float), voxels, file) == voxels;
+                }
+                if (ok)
+                    interleave();
+            }
+            fclose(file);
+            return ok;
+        }
+
+        /**
+         * @brief Loads the fields from the cache in a directory, generating and caching them if needed. Prints where they came from and how long it took
+         *
+         * @param directory Cache directory
+         * @param p Parameters (size should already be a power of two, or the cache never matches)
+         * @param jobs Job system to generate on
+         */
+        void import(const string& directory, const NoiseParams& p, JobSystem* jobs) {
+            Timer timer;
+            string path = directory + "/" + p.cacheName();
+            bool cached = load(path, p);
+            if (!cached) {
+                generate(p, jobs);
+                if (!save(path))
+                    std::cout << "Noise could not write cache: " << path << std::endl;
+            }
+            lastMs = timer.elapsedMs();
+            std::cout << "noise " << params.size << "^3, " << params.octaves << " octaves: " << (cached ? "loaded" : "generated") << " in " << lastMs << " ms" << std::endl;
+        }
+
+        // voxels interleaved as (curl.x, curl.y, curl.z, noise), for an RGBA texture
+        const vector<float>& interleaved() const {
+            return records;
+        }
+
+        /**
+         * @brief Trilinear sample of both fields, wrapping like a GL_REPEAT texture with texel centers at (i + 0.5) / size
+         *
+         * @param p Position in tiles
+         * @return glm::vec4 (curl, noise)
+         */
+        glm::vec4 sample(glm::vec3 p) const {
+            size_t idx[8];
+            float w[3];
+            corners(p.x, p.y, p.z, idx, w);
+            const vector<float>* channels[4] = {&curlX, &curlY, &curlZ, &noise};
+            float out[4];
+            for (int c = 0; c < 4; c++)
+                out[c] = trilinear(&(*channels[c])[0], idx, w);
+            return glm::vec4(out[0], out[1], out[2], out[3]);
+        }
+
+        /**
+         * @brief Adds the curl field at each of a set of positions to a velocity, for structure-of-arrays particles. Each corner is one 16-byte load from the interleaved records; AVX2 transposes eight particles' corners into vectors, SSE2 blends one particle's four channels at a time
+         *
+         * @param px, py, pz Positions in world units
+         * @param vx, vy, vz Velocities to add to
+         * @param count Number of particles
+         * @param frequency Tiles per world unit
+         * @param scale Multiplier of the curl before it is added
+         */
+        void addCurl(const float* px, const float* py, const float* pz, float* vx, float* vy, float* vz, size_t count, float frequency, float scale) const {
+            size_t i = 0;
+#if NOISE_SIMD_WIDTH == 8
+            int size = params.size, shift = 0;
+            while ((1 << shift) < size)
+                shift++;
+            const __m256 sz = _mm256_set1_ps((float)size), invSz = _mm256_set1_ps(1.0f / size);
+            const __m256 fs = _mm256_set1_ps(frequency * size), half = _mm256_set1_ps(0.5f), s = _mm256_set1_ps(scale);
+            const __m256i mask = _mm256_set1_epi32(size - 1);
+            const __m256i one = _mm256_set1_epi32(1);
+            const float* rec = &records[0];
+
+            // batches of NOISE_BATCH vectors in two passes: the corners of the whole batch are found first, so the record
+            // loads that follow are independent of any arithmetic and their cache misses overlap
+            alignas(32) int idx[NOISE_BATCH][8][8];
+            alignas(32) float w[NOISE_BATCH][3][8];
+            while (i + 8 <= count) {
+                int batch = (int)std::min((count - i) / 8, (size_t)NOISE_BATCH);
+                for (int b = 0; b < batch; b++) {
+                    __m256i i0[3], i1[3];
+                    const float* src[3] = {px + i + b * 8, py + i + b * 8, pz + i + b * 8};
+                    for (int a = 0; a < 3; a++) {
+                        // texel space, wrapped into [0, size), with texel centers on the half
+                        __m256 u = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(src[a]), fs), half);
+                        u = _mm256_sub_ps(u, _mm256_mul_ps(_mm256_floor_ps(_mm256_mul_ps(u, invSz)), sz));
+                        __m256 f = _mm256_floor_ps(u);
+                        _mm256_store_ps(w[b][a], _mm256_sub_ps(u, f));
+                        i0[a] = _mm256_and_si256(_mm256_cvttps_epi32(f), mask);
+                        i1[a] = _mm256_and_si256(_mm256_add_epi32(i0[a], one), mask);
+                    }
+                    for (int c = 0; c < 8; c++) {
+                        __m256i zy = _mm256_add_epi32(_mm256_slli_epi32((c & 4) ? i1[2] : i0[2], 2 * shift), _mm256_slli_epi32((c & 2) ? i1[1] : i0[1], shift));
+                        _mm256_store_si256((__m256i*)idx[b][c], _mm256_add_epi32(zy, (c & 1) ? i1[0] : i0[0]));
+                    }
+                }
+
+                for (int b = 0; b < batch; b++, i += 8) {
+                    __m256 wx = _mm256_load_ps(w[b][0]), wy = _mm256_load_ps(w[b][1]), wz = _mm256_load_ps(w[b][2]);
+                    __m256 yz[2][3];
+                    for (int zy = 0; zy < 4; zy++) {
+                        // the two corners along x, lerped per axis
+                        __m256 c0[3], c1[3];
+                        loadCorner(rec, idx[b][2 * zy], c0);
+                        loadCorner(rec, idx[b][2 * zy + 1], c1);
+                        for (int a = 0; a < 3; a++) {
+                            __m256 x = _mm256_add_ps(c0[a], _mm256_mul_ps(_mm256_sub_ps(c1[a], c0[a]), wx));
+                            if (zy & 1)
+                                yz[zy >> 1][a] = _mm256_add_ps(yz[zy >> 1][a], _mm256_mul_ps(_mm256_sub_ps(x, yz[zy >> 1][a]), wy));
+                            else
+                                yz[zy >> 1][a] = x;
+                        }
+                    }
+                    float* dst[3] = {vx + i, vy + i, vz + i};
+                    for (int a = 0; a < 3; a++) {
+                        __m256 r = _mm256_add_ps(yz[0][a], _mm256_mul_ps(_mm256_sub_ps(yz[1][a], yz[0][a]), wz));
+                        _mm256_storeu_ps(dst[a], _mm256_add_ps(_mm256_loadu_ps(dst[a]), _mm256_mul_ps(r, s)));
+                    }
+                }
+            }
+#elif NOISE_SIMD_WIDTH == 4
+            const __m128 s = _mm_set1_ps(scale);
+            for (; i < count; i++) {
+                size_t idx[8];
+                float w[3], out[4];
+                corners(px[i] * frequency, py[i] * frequency, pz[i] * frequency, idx, w);
+                __m128 v[8];
+                for (int c = 0; c < 8; c++)
+                    v[c] = _mm_loadu_ps(&records[idx[c] * 4]);
+                for (int a = 0, n = 8; a < 3; a++, n /= 2) {
+                    __m128 t = _mm_set1_ps(w[a]);
+                    for (int c = 0; c < n / 2; c++)
+                        v[c] = _mm_add_ps(v[2 * c], _mm_mul_ps(_mm_sub_ps(v[2 * c + 1], v[2 * c]), t));
+                }
+                _mm_storeu_ps(out, _mm_mul_ps(v[0], s));
+                vx[i] += out[0];
+                vy[i] += out[1];
+                vz[i] += out[2];
+            }
+#endif
+            for (; i < count; i++) {
+                size_t idx[8];
+                float w[3];
+                corners(px[i] * frequency, py[i] * frequency, pz[i] * frequency, idx, w);
+                vx[i] += trilinear(&curlX[0], idx, w) * scale;
+                vy[i] += trilinear(&curlY[0], idx, w) * scale;
+                vz[i] += trilinear(&curlZ[0], idx, w) * scale;
+            }
+        }
+
+    private:
+        static uint32_t hash(uint32_t x) {
+            x ^= x >> 16; x *= 0x7feb352dU;
+            x ^= x >> 15; x *= 0x846ca68bU;
+            x ^= x >> 16;
+            return x;
+        }
+
+        // quintic fade, so the fields have continuous second derivatives
+        static float fade(float t) {
+            return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+        }
+
+        // the eight voxels around a position in tiles, ordered x fastest, and the blend weights along each axis
+        void corners(float x, float y, float z, size_t* idx, float* w) const {
+            int size = params.size;
+            float p[3] = {x, y, z};
+            int i0[3], i1[3];
+            for (int a = 0; a < 3; a++) {
+                float u = p[a] * size - 0.5f;
+                u -= floorf(u / size) * size;
+                float f = floorf(u);
+                w[a] = u - f;
+                i0[a] = (int)f & (size - 1);
+                i1[a] = (i0[a] + 1) & (size - 1);
+            }
+            for (int c = 0; c < 8; c++)
+                idx[c] = ((size_t)((c & 4) ? i1[2] : i0[2]) * size + ((c & 2) ? i1[1] : i0[1])) * size + ((c & 1) ? i1[0] : i0[0]);
+        }
+
+        static float trilinear(const float* field, const size_t* idx, const float* w) {
+            float v[4];
+            for (int c = 0; c < 4; c++)
+                v[c] = field[idx[2 * c]] + (field[idx[2 * c + 1]] - field[idx[2 * c]]) * w[0];
+            float a = v[0] + (v[1] - v[0]) * w[1], b = v[2] + (v[3] - v[2]) * w[1];
+            return a + (b - a) * w[2];
+        }
+
+#if NOISE_SIMD_WIDTH == 8
+        // one corner of eight particles: their records, one 16-byte load each, transposed into curl x, y and z vectors
+        static void loadCorner(const float* rec, const int* idx, __m256* xyz) {
+            __m256 r[4];
+            for (int j = 0; j < 4; j++)
+                r[j] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(rec + (size_t)idx[j] * 4)), _mm_loadu_ps(rec + (size_t)idx[j + 4] * 4), 1);
+            __m256 xy01 = _mm256_unpacklo_ps(r[0], r[1]), zn01 = _mm256_unpackhi_ps(r[0], r[1]);
+            __m256 xy23 = _mm256_unpacklo_ps(r[2], r[3]), zn23 = _mm256_unpackhi_ps(r[2], r[3]);
+            xyz[0] = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(1, 0, 1, 0));
+            xyz[1] = _mm256_shuffle_ps(xy01, xy23, _MM_SHUFFLE(3, 2, 3, 2));
+            xyz[2] = _mm256_shuffle_ps(zn01, zn23, _MM_SHUFFLE(1, 0, 1, 0));
+        }
+#endif
+
+        // voxels interleaved as (curl.x, curl.y, curl.z, noise)
+        void interleave() {
+            records.resize(noise.size() * 4);
+            for (size_t i = 0; i < noise.size(); i++) {
+                records[i * 4 + 0] = curlX[i];
+                records[i * 4 + 1] = curlY[i];
+                records[i * 4 + 2] = curlZ[i];
+                records[i * 4 + 3] = noise[i];
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,109 @@
+/**
+ * @file oit.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Weighted blended order-independent transparency for particle layers. Sprites accumulate into a weighted color target and a revealage target in any order, and a fullscreen pass composites them over the scene, so the layer needs no depth sort
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef OIT_H
+#define OIT_H
+
+#include "helper.h"
+#include "framebuffer.h"
+
+// How a transparent particle layer is resolved
+enum TransparencyMode {
+    TRANSPARENCY_SORTED=0, TRANSPARENCY_OIT=1
+};
+
+/**
+ * @brief Accumulation and revealage targets plus the composite pass. Usage per frame: begin(), draw layers with the OIT sprite shader, end(), composite()
+ */
+class WeightedOit {
+    public:
+        Shader* particleShader;     // sprite shader writing accumulation and revealage
+        RenderTarget* target;
+
+        /**
+         * @brief Construct a new WeightedOit object
+         *
+         * @param rx Width of the scene in pixels
+         * @param ry Height of the scene in pixels
+         */
+        WeightedOit(int rx, int ry) {
+            particleShader = new Shader("shaders/particle.vert", "shaders/particle_oit.frag");
+            compositeShader = new Shader("shaders/fullscreen.vert", "shaders/oit_composite.frag");
+
+            // accumulation needs range and precision; revealage is a product of coverages in [0, 1]
+            target = new RenderTarget(rx, ry, {GL_RGBA16F, GL_R8}, GL_DEPTH24_STENCIL8);
+        }
+
+        ~WeightedOit() {
+            delete target;
+            delete particleShader;
+            delete compositeShader;
+        }
+
+        /**
+         * @brief Binds and clears the OIT targets, and sets the blend state for accumulation. Depth is tested against the scene depth currently in the scene framebuffer, but not written
+         *
+         * @param rx Width of the scene in pixels
+         * @param ry Height of the scene in pixels
+         */
+        void begin(int rx, int ry) {
+            // copy scene depth so sprites are still occluded by opaque geometry
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, RenderTarget::sceneFbo());
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->fbo);
+            glBlitFramebuffer(0, 0, rx, ry, 0, 0, target->width, target->height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+            target->bind();
+            const float zero[4] = {0, 0, 0, 0};
+            const float one[4] = {1, 1, 1, 1};
+            glClearBufferfv(GL_COLOR, 0, zero);
+            glClearBufferfv(GL_COLOR, 1, one);
+
+            glEnable(GL_DEPTH_TEST);
+            glDepthMask(GL_FALSE);
+            glEnable(GL_BLEND);
+            glBlendFunci(0, GL_ONE, GL_ONE);
+            glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+        }
+
+        // restores default blend and depth state and the scene framebuffer
+        void end(int rx, int ry) {
+            glDisable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ZERO);
+            glDepthMask(GL_TRUE);
+            RenderTarget::bindScene(rx, ry);
+        }
+
+        /**
+         * @brief Composites the accumulated layers over whatever framebuffer is bound
+         */
+        void composite() {
+            compositeShader->use();
+            compositeShader->setInt("accumTexture", 0);
+            compositeShader->setInt("revealTexture", 1);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, target->colors[0]);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, target->colors[1]);
+
+            glDisable(GL_DEPTH_TEST);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+            drawFullscreenTriangle();
+            glDisable(GL_BLEND);
+            glEnable(GL_DEPTH_TEST);
+
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+    private:
+        Shader* compositeShader;
+};
+
+#endif
@@ -0,0 +1,201 @@
+/**
+ * @file particlelod.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Emitter level of detail. Each frame, every emitter is rated by distance to the camera, screen coverage and whether the camera is looking at it, and a global particle budget is shared out between emitters by that rating
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef PARTICLELOD_H
+#define PARTICLELOD_H
+
+#include <cmath>
+#include <vector>
+using std::vector;
+
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "particles.h"
+
+/**
+ * @brief How the budget went to one emitter in the last update
+ */
+struct EmitterLodReport {
+    float distance;             // camera to the center of the emitter's bounds
+    float coverage;             // fraction of the screen's height its bounds span, squared
+    bool visible;               // bounds intersect the view frustum
+    bool focused;               // bounds overlap the center of view
+    unsigned int demand;        // steady-state particle count at full detail
+    unsigned int granted;       // steady-state particle count at the level chosen
+    unsigned int interval;      // frames per simulation step
+};
+
+/**
+ * @brief Chooses an EmitterLod for every emitter. Usage per frame: update(camera, aspect, emitters) before stepping the emitters; works on both ParticleEmitter and GpuParticleEmitter
+ */
+class ParticleLod {
+    public:
+        bool enabled = true;
+        unsigned int budget = 16384;        // steady-state particles shared by all emitters
+        float fullDetailDistance = 6.0f;    // emitters closer than this ask for their full spawn rate
+        float minSpawnScale = 0.1f;         // no emitter drops below this fraction of its spawn rate, budget or not
+        float offscreenSpawnScale = 0.25f;  // spawn rate kept by emitters out of view, so they are primed when turned to
+        float maxSizeScale = 2.0f;
+        float focusAngle = 15.0f;           // degrees from the view direction within which an emitter is looked at
+        float focusWeight = 8.0f;           // budget priority of a looked-at emitter over one merely in view
+        unsigned int distantInterval = 2;   // frames per step of visible emitters covering under minCoverage
+        unsigned int offscreenInterval = 4; // frames per step of emitters out of view
+        float minCoverage = 0.01f;
+
+        vector<EmitterLodReport> reports;   // per emitter, from the last update
+        unsigned int granted = 0;           // total over reports
+
+        /**
+         * @brief Rates every emitter against the camera and shares the budget out between them, setting each emitter's lod
+         *
+         * @tparam Emitter ParticleEmitter or GpuParticleEmitter
+         * @param camera Camera the scene is drawn from
+         * @param aspect Width over height of the viewport
+         * @param emitters Emitters to set the lod of
+         */
+        template <class Emitter>
+        void update(Camera* camera, float aspect, vector<Emitter*>& emitters) {
+            unsigned int n = emitters.size();
+            reports.resize(n);
+            wants.resize(n);
+            weights.resize(n);
+            granted = 0;
+
+            float tanY = tanf(glm::radians(camera->zoom) * 0.5f);
+            float tanX = tanY * aspect;
+            float cosFocus = cosf(glm::radians(focusAngle));
+
+            for (unsigned int i = 0; i < n; i++) {
+                const EmitterDesc& desc = emitters[i]->desc;
+                EmitterLodReport& r = reports[i];
+
+                glm::vec3 center;
+                float radius;
+                emitterBounds(desc, center, radius);
+                glm::vec3 toCenter = center - camera->position;
+                r.distance = glm::length(toCenter);
+                r.demand = steadyCount(desc);
+
+                // view-space sphere test against the frustum's side planes, then near and far
+                float z = glm::dot(toCenter, camera->front);
+                float x = fabsf(glm::dot(toCenter, camera->right));
+                float y = fabsf(glm::dot(toCenter, camera->up));
+                r.visible = z + radius > camera->nearPlane && z - radius < camera->farPlane
+                         && (x - z * tanX) / sqrtf(1.0f + tanX * tanX) < radius
+                         && (y - z * tanY) / sqrtf(1.0f + tanY * tanY) < radius;
+
+                float extent = radius / (fmaxf(r.distance, radius) * tanY);
+                r.coverage = fminf(extent * extent, 1.0f);
+
+                // looked at if the view direction passes within focusAngle of the bounds
+                float angular = r.distance > radius ? asinf(radius / r.distance) : 3.14159265f;
+                float toAxis = r.distance > 0.0f ? acosf(fminf(fmaxf(z / r.distance, -1.0f), 1.0f)) : 0.0f;
+                r.focused = r.visible && cosf(fmaxf(toAxis - angular, 0.0f)) >= cosFocus;
+
+                float scale = r.visible ? fminf(fmaxf(fullDetailDistance / fmaxf(r.distance, 1e-3f), minSpawnScale), 1.0f) : offscreenSpawnScale;
+                if (!enabled || r.focused)
+                    scale = 1.0f;
+                wants[i] = r.demand * scale;
+                weights[i] = r.visible ? (r.coverage + 1e-4f) * (r.focused ? focusWeight : 1.0f) : 0.0f;
+
+                if (!enabled)
+                    r.interval = 1;
+                else if (!r.visible)
+                    r.interval = offscreenInterval;
+                else if (!r.focused && r.coverage < minCoverage)
+                    r.interval = distantInterval;
+                else
+                    r.interval = 1;
+            }
+
+            share();
+
+            for (unsigned int i = 0; i < n; i++) {
+                EmitterLodReport& r = reports[i];
+                EmitterLod& lod = emitters[i]->lod;
+                lod.interval = r.interval;
+                lod.spawnScale = r.demand > 0 ? (float)r.granted / r.demand : 1.0f;
+                // fewer particles of the same coverage: area goes with size squared
+                lod.sizeScale = fminf(1.0f / sqrtf(fmaxf(lod.spawnScale, 1e-3f)), maxSizeScale);
+                granted += r.granted;
+            }
+        }
+
+    private:
+        // per-frame scratch, kept as members so their storage is reused between frames
+        vector<float> wants;
+        vector<float> weights;
+        vector<float> grants;
+        vector<bool> open;
+
+        // live particles once spawning and dying balance
+        static unsigned int steadyCount(const EmitterDesc& desc) {
+            float count = desc.spawnRate * 0.5f * (desc.lifeMin + desc.lifeMax);
+            return count < desc.capacity ? (unsigned int)count : desc.capacity;
+        }
+
+        /**
+         * @brief Grants every emitter its floor, then shares what is left of the budget by weight (water-filling): emitters whose share covers what they want are capped there, and the excess goes around again
+         */
+        void share() {
+            unsigned int n = reports.size();
+            float total = 0.0f;
+            for (unsigned int i = 0; i < n; i++)
+                total += wants[i];
+
+            // under budget, or not limiting: everyone gets what they want
+            if (!enabled || total <= budget) {
+                for (unsigned int i = 0; i < n; i++)
+                    reports[i].granted = (unsigned int)wants[i];
+                return;
+            }
+
+            vector<float>& want = wants;
+            vector<float>& grant = grants;
+            grant.resize(n);
+            open.assign(n, false);
+            float left = (float)budget;
+            for (unsigned int i = 0; i < n; i++) {
+                float floor = fminf(reports[i].demand * minSpawnScale, want[i]);
+                grant[i] = floor;
+                left -= floor;
+                open[i] = weights[i] > 0.0f && want[i] > floor;
+            }
+
+            while (left > 0.5f) {
+                float weightSum = 0.0f;
+                for (unsigned int i = 0; i < n; i++)
+                    if (open[i])
+                        weightSum += weights[i];
+                if (weightSum <= 0.0f)
+                    break;
+
+                float spent = 0.0f;
+                for (unsigned int i = 0; i < n; i++) {
+                    if (!open[i])
+                        continue;
+                    float add = fminf(left * weights[i] / weightSum, want[i] - grant[i]);
+                    grant[i] += add;
+                    spent += add;
+                    if (grant[i] >= want[i] - 0.5f)
+                        open[i] = false;
+                }
+                left -= spent;
+                if (spent < 0.5f)
+                    break;
+            }
+
+            for (unsigned int i = 0; i < n; i++)
+                reports[i].granted = (unsigned int)grant[i];
+        }
+};
+
+#endif
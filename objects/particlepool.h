@@ -0,0 +1,349 @@
+/**
+ * @file particlepool.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Allocation-free particle storage. Pools are structure-of-arrays with O(1) spawn and swap-with-last kill, so live particles are always dense for the SIMD kernels. Pools either own a fixed allocation or grow and shrink inside a ParticleSlab, a buddy allocator over one arena made up front
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef PARTICLEPOOL_H
+#define PARTICLEPOOL_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
+using std::vector;
+
+// Alignment of every particle stream (one cache line)
+#define PARTICLE_ALIGN 64
+
+// Streams per particle: px py pz vx vy vz age life size frame (see the buffer layout in particlerenderer.h)
+#define PARTICLE_STREAMS 10
+
+// Particles in the smallest slab block; every block holds all streams for a power of two times this many
+#define SLAB_BLOCK_PARTICLES 256
+
+// Returned by ParticlePool::spawn when the pool is full
+#define PARTICLE_NONE 0xffffffffu
+
+/**
+ * @brief Buddy allocator for particle pools. One arena is allocated at construction; blocks are power-of-two multiples of SLAB_BLOCK_PARTICLES and merge with their buddy when released, so pools can grow and shrink for the lifetime of the program without fragmenting it. Thread safe
+ */
+class ParticleSlab {
+    public:
+        // stats, in particles
+        unsigned int capacity;              // arena size
+        unsigned int used = 0;              // handed out in live blocks
+        unsigned int peak = 0;              // most ever handed out at once
+        unsigned int failures = 0;          // allocations that found no free block
+
+        /**
+         * @brief Allocates the arena
+         *
+         * @param particles Minimum arena size, in particles. Rounded up to a power of two blocks
+         */
+        ParticleSlab(unsigned int particles) {
+            unsigned int blocks = 1;
+            levels = 1;
+            while (blocks * SLAB_BLOCK_PARTICLES < particles) {
+                blocks *= 2;
+                levels++;
+            }
+            capacity = blocks * SLAB_BLOCK_PARTICLES;
+
+            size_t bytes = (size_t)capacity * PARTICLE_STREAMS * sizeof(float);
+            memory = (char*)std::aligned_alloc(PARTICLE_ALIGN, bytes);
+            memset(memory, 0, bytes);
+
+            // per-block bookkeeping, sized once; free lists are threaded through it
+            next.assign(blocks, -1);
+            prev.assign(blocks, -1);
+            order.assign(blocks, 0);
+            isFree.assign(blocks, 0);
+            heads.assign(levels, -1);
+            push(0, levels - 1);
+        }
+
+        ~ParticleSlab() {
+            std::free(memory);
+        }
+
+        ParticleSlab(const ParticleSlab&) = delete;
+        ParticleSlab& operator=(const ParticleSlab&) = delete;
+
+        // particles in the smallest block that holds n
+        static unsigned int roundUp(unsigned int n) {
+            unsigned int p = SLAB_BLOCK_PARTICLES;
+            while (p < n)
+                p *= 2;
+            return p;
+        }
+
+        /**
+         * @brief Allocates a block for the streams of at least n particles
+         *
+         * @param n Particles needed
+         * @param granted Set to the particles the block holds (roundUp(n))
+         * @return char* Start of the block, 64-byte aligned, or null if no block is free
+         */
+        char* allocate(unsigned int n, unsigned int& granted) {
+            std::lock_guard<std::mutex> lock(mutex);
+            int k = 0;
+            while (((unsigned int)SLAB_BLOCK_PARTICLES << k) < n)
+                k++;
+
+            int j = k;
+            while (j < levels && heads[j] < 0)
+                j++;
+            if (j >= levels) {
+                failures++;
+                return NULL;
+            }
+
+            // split down to the requested order, freeing the upper halves
+            int b = heads[j];
+            unlink(b, j);
+            while (j > k) {
+                j--;
+                push(b + (1 << j), j);
+            }
+            order[b] = (uint8_t)k;
+
+            granted = SLAB_BLOCK_PARTICLES << k;
+            used += granted;
+            if (used > peak)
+                peak = used;
+            return memory + (size_t)b * SLAB_BLOCK_PARTICLES * PARTICLE_STREAMS * sizeof(float);
+        }
+
+        /**
+         * @brief Returns a block from allocate(), merging it with its free buddies
+         */
+        void release(char* block) {
+            std::lock_guard<std::mutex> lock(mutex);
+            int b = (int)((block - memory) / (SLAB_BLOCK_PARTICLES * PARTICLE_STREAMS * sizeof(float)));
+            int k = order[b];
+            used -= SLAB_BLOCK_PARTICLES << k;
+
+            while (k < levels - 1) {
+                int buddy = b ^ (1 << k);
+                if (!isFree[buddy] || order[buddy] != k)
+                    break;
+                unlink(buddy, k);
+                b = b < buddy ? b : buddy;
+                k++;
+            }
+            push(b, k);
+        }
+
+    private:
+        char* memory;
+        int levels;                 // block orders 0 .. levels - 1; the top order is the whole arena
+        std::mutex mutex;
+
+        // indexed by smallest-block offset; only meaningful at the first block of a free or live block
+        vector<int> next, prev;     // free list links
+        vector<uint8_t> order;
+        vector<uint8_t> isFree;
+        vector<int> heads;          // free list per order
+
+        void push(int b, int k) {
+            order[b] = (uint8_t)k;
+            isFree[b] = 1;
+            prev[b] = -1;
+            next[b] = heads[k];
+            if (heads[k] >= 0)
+                prev[heads[k]] = b;
+            heads[k] = b;
+        }
+
+        void unlink(int b, int k) {
+            if (prev[b] >= 0)
+                next[prev[b]] = next[b];
+            else
+                heads[k] = next[b];
+            if (next[b] >= 0)
+                prev[next[b]] = prev[b];
+            isFree[b] = 0;
+        }
+};
+
+/**
+ * @brief Structure-of-arrays particle storage. Every stream is 64-byte aligned and the live particles are always [0, count). Without a slab the pool makes one allocation at construction and never resizes; with a slab it starts empty and reserve() moves it between slab blocks as demand changes. Spawning and killing never allocate
+ */
+class ParticlePool {
+    public:
+        float* px; float* py; float* pz;    // position
+        float* vx; float* vy; float* vz;    // velocity
+        float* age;                         // seconds since birth
+        float* life;                        // lifetime in seconds
+        float* size;                        // billboard size
+        uint32_t* frame;                    // flipbook frame index
+
+        unsigned int maxCapacity;           // most particles the pool will ever hold
+        unsigned int capacity;              // particles it can hold now
+        unsigned int count = 0;
+
+        // stats for capacity planning
+        unsigned int peakCount = 0;         // most live particles at once
+        unsigned int spawnFailures = 0;     // spawns dropped because the pool was full
+
+        /**
+         * @brief Creates a pool
+         *
+         * @param capacity Most particles the pool will hold
+         * @param slab Slab to grow and shrink in. Defaults to null (one fixed allocation of the full capacity)
+         */
+        ParticlePool(unsigned int capacity, ParticleSlab* slab = NULL) : slab(slab) {
+            // pad every stream to a whole number of cache lines so the next stream stays aligned
+            maxCapacity = (capacity + 15) & ~15u;
+            if (slab != NULL) {
+                this->capacity = 0;
+                stride = 0;
+                setStreams(NULL);
+                return;
+            }
+
+            this->capacity = maxCapacity;
+            stride = maxCapacity;
+            size_t bytes = (size_t)stride * PARTICLE_STREAMS * sizeof(float);
+            memory = (char*)std::aligned_alloc(PARTICLE_ALIGN, bytes);
+            memset(memory, 0, bytes);
+            setStreams(memory);
+        }
+
+        ~ParticlePool() {
+            if (slab == NULL)
+                std::free(memory);
+            else if (memory != NULL)
+                slab->release(memory);
+        }
+
+        ParticlePool(const ParticlePool&) = delete;
+        ParticlePool& operator=(const ParticlePool&) = delete;
+
+        /**
+         * @brief Makes room for n particles in a slab pool, and gives back most of the room when far fewer are needed. Growth takes the smallest block that fits; the pool only shrinks once n falls to a quarter of its capacity, so it does not thrash around a block boundary. Fixed pools ignore this
+         *
+         * @param n Particles about to be live
+         * @return true if the pool can hold min(n, maxCapacity) particles
+         */
+        bool reserve(unsigned int n) {
+            if (n > maxCapacity)
+                n = maxCapacity;
+            if (slab == NULL)
+                return true;
+
+            if (n > capacity)
+                return resize(n);
+            unsigned int least = n > count ? n : count;
+            if (stride > SLAB_BLOCK_PARTICLES && least * 4 <= stride)
+                resize(least == 0 ? 0 : least * 2);
+            return true;
+        }
+
+        /**
+         * @brief Appends a particle; its streams are left for the caller to fill
+         *
+         * @return unsigned int Index of the new particle, or PARTICLE_NONE if the pool is full
+         */
+        unsigned int spawn() {
+            if (count >= capacity) {
+                spawnFailures++;
+                return PARTICLE_NONE;
+            }
+            unsigned int i = count++;
+            if (count > peakCount)
+                peakCount = count;
+            return i;
+        }
+
+        /**
+         * @brief Appends up to n particles at once; the rest are counted as failures
+         *
+         * @param n Particles wanted
+         * @param granted Set to the particles appended
+         * @return unsigned int Index of the first; the new particles are [first, first + granted)
+         */
+        unsigned int spawn(unsigned int n, unsigned int& granted) {
+            unsigned int first = count;
+            granted = capacity - count < n ? capacity - count : n;
+            spawnFailures += n - granted;
+            count += granted;
+            if (count > peakCount)
+                peakCount = count;
+            return first;
+        }
+
+        // removes particle i by moving the last particle into its place
+        void kill(unsigned int i) {
+            count--;
+            if (i != count)
+                move(i, count);
+        }
+
+        // copies particle src over particle dst
+        void move(unsigned int dst, unsigned int src) {
+            px[dst] = px[src]; py[dst] = py[src]; pz[dst] = pz[src];
+            vx[dst] = vx[src]; vy[dst] = vy[src]; vz[dst] = vz[src];
+            age[dst] = age[src]; life[dst] = life[src];
+            size[dst] = size[src]; frame[dst] = frame[src];
+        }
+
+        // exchanges particles a and b
+        void swap(unsigned int a, unsigned int b) {
+            std::swap(px[a], px[b]); std::swap(py[a], py[b]); std::swap(pz[a], pz[b]);
+            std::swap(vx[a], vx[b]); std::swap(vy[a], vy[b]); std::swap(vz[a], vz[b]);
+            std::swap(age[a], age[b]); std::swap(life[a], life[b]);
+            std::swap(size[a], size[b]); std::swap(frame[a], frame[b]);
+        }
+
+    private:
+        ParticleSlab* slab;
+        char* memory = NULL;
+        unsigned int stride;                // stream length, in particles
+
+        void setStreams(char* base) {
+            float* s = (float*)base;
+            px = s; py = s + stride; pz = s + 2 * stride;
+            vx = s + 3 * stride; vy = s + 4 * stride; vz = s + 5 * stride;
+            age = s + 6 * stride;
+            life = s + 7 * stride;
+            size = s + 8 * stride;
+            frame = (uint32_t*)(s + 9 * stride);
+        }
+
+        /**
+         * @brief Moves the live particles into a slab block for n particles (none if n is 0)
+         *
+         * @return true if the block was available; otherwise the pool is unchanged
+         */
+        bool resize(unsigned int n) {
+            char* block = NULL;
+            unsigned int granted = 0;
+            if (n > 0) {
+                block = slab->allocate(n, granted);
+                if (block == NULL)
+                    return false;
+            }
+
+            float* src[PARTICLE_STREAMS] = {px, py, pz, vx, vy, vz, age, life, size, (float*)frame};
+            for (int s = 0; s < PARTICLE_STREAMS && count > 0; s++)
+                memcpy(block + (size_t)s * granted * sizeof(float), src[s], count * sizeof(float));
+
+            if (memory != NULL)
+                slab->release(memory);
+            memory = block;
+            stride = granted;
+            capacity = granted < maxCapacity ? granted : maxCapacity;
+            setStreams(memory);
+            return true;
+        }
+};
+
+#endif
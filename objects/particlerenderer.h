@@ -0,0 +1,284 @@
+/**
+ * @file particlerenderer.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Billboard sprite renderer for particles. Sprites are built by vertex pulling straight out of a structure-of-arrays SSBO, so the CPU and GPU particle paths share a single draw
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef PARTICLERENDERER_H
+#define PARTICLERENDERER_H
+
+#include "helper.h"
+#include "camera.h"
+#include "particles.h"
+#include "flipbook.h"
+
+/* ----- PARTICLE BUFFER LAYOUT ----- *\
+binding 0   float data[10 * capacity]; stream s of particle i at data[s * capacity + i]
+Stream      0    1    2    3    4    5    6    7     8     9
+            px   py   pz   vx   vy   vz   age  life  size  frame (uint bits)
+binding 1   uint drawList[]; particle index of every sprite, in draw order
+binding 2   vec2 outlines[]; trimmed flipbook outlines (render only)
+\* ---------------------------------- */
+
+/**
+ * @brief Everything the sprite draw needs to know about a set of particles
+ */
+struct ParticleDrawSource {
+    GLuint dataBuffer = 0;          // SoA particle streams
+    GLuint drawList = 0;            // particle indices, in draw order
+    unsigned int capacity = 0;      // stream stride, in particles
+    GLuint indirectBuffer = 0;      // if nonzero, sprite count is read on the GPU from a DrawArraysIndirectCommand at offset 0
+    unsigned int count = 0;         // sprite count when indirectBuffer is 0
+    ParticleLayer layer = LAYER_FIRE;
+    EmitterSlicing slicing;         // for CPU pools, how far behind each slice is drawn from (see ParticleEmitter::drawSlicing)
+};
+
+/**
+ * @brief Draws particle sprites as camera-facing billboards textured from a flipbook atlas. Six vertices per sprite are pulled from the particle SSBO; no vertex attributes are used
+ */
+class ParticleRenderer {
+    public:
+        Shader* shader;
+
+        unsigned int atlas = 0;
+        int atlasCols = 1, atlasRows = 1;
+        int outlineVertices = 0;        // vertices of each trimmed frame outline; 0 draws full quads
+
+        unsigned int sceneDepth = 0;    // resolved scene depth for soft particles; 0 disables the fade
+        bool sceneDepthLinear = false;
+        float softDistance = 0.3f;      // view-space distance over which sprites fade into geometry
+
+        ParticleRenderer(const char* vertexPath, const char* fragmentPath) {
+            shader = new Shader(vertexPath, fragmentPath);
+
+            // core profile requires a bound VAO even without attributes
+            glGenVertexArrays(1, &emptyVAO);
+        }
+
+        ~ParticleRenderer() {
+            glDeleteVertexArrays(1, &emptyVAO);
+            glDeleteBuffers(1, &outlineBuffer);
+            delete shader;
+        }
+
+        // sets the flipbook atlas (a grid of cols x rows frames, row-major from the top left). A texture of 0 draws soft round sprites instead
+        void setAtlas(unsigned int texture, int cols, int rows) {
+            atlas = texture;
+            atlasCols = cols;
+            atlasRows = rows;
+        }
+
+        /**
+         * @brief Draws a set of particles with premultiplied-alpha blending and depth test, without depth writes
+         *
+         * @param src Particle buffers to draw
+         * @param camera Camera to face
+         * @param rx Viewport width in pixels
+         * @param ry Viewport height in pixels
+         * @param override Shader to draw with instead of the sprite shader (must accept the same uniforms). Blend and depth state are then left to the caller. Defaults to null
+         */
+        void draw(const ParticleDrawSource& src, Camera* camera, int rx, int ry, Shader* override = NULL) {
+            if (src.indirectBuffer == 0 && src.count == 0)
+                return;
+
+            Shader* s = override != NULL ? override : shader;
+            s->use();
+            s->setMat4("view", camera->getViewMatrix());
+            s->setMat4("projection", camera->getProjectionMatrix((float)rx / (float)ry));
+            s->setInt("capacity", src.capacity);
+            s->setInt("atlasCols", atlasCols);
+            s->setInt("atlasRows", atlasRows);
+            s->setInt("outlineVertices", atlas != 0 ? outlineVertices : 0);
+            s->setInt("atlas", 0);
+            s->setBool("useAtlas", atlas != 0);
+            s->setVec3("tint", layerTint(src.layer));
+            s->setFloat("additive", layerAdditive(src.layer));
+            s->setBool("softParticles", sceneDepth != 0);
+            s->setInt("sceneDepth", 1);
+            s->setBool("sceneDepthLinear", sceneDepthLinear);
+            s->setFloat("softDistance", softDistance);
+            s->setFloat("nearPlane", camera->nearPlane);
+            s->setFloat("farPlane", camera->farPlane);
+            s->setVec2("viewportSize", glm::vec2(rx, ry));
+            static const char* sliceEnds[PARTICLE_MAX_SLICES] = {"sliceEnd[0]", "sliceEnd[1]", "sliceEnd[2]", "sliceEnd[3]"};
+            static const char* sliceLags[PARTICLE_MAX_SLICES] = {"sliceLag[0]", "sliceLag[1]", "sliceLag[2]", "sliceLag[3]"};
+            s->setInt("slices", src.slicing.slices);
+            for (unsigned int k = 0; k < src.slicing.slices; k++) {
+                s->setInt(sliceEnds[k], src.slicing.start[k + 1]);
+                s->setFloat(sliceLags[k], src.slicing.lag[k]);
+            }
+
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, sceneDepth);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, atlas);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, src.dataBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, src.drawList);
+            if (outlineBuffer != 0)
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, outlineBuffer);
+
+            if (override == NULL) {
+                glEnable(GL_DEPTH_TEST);
+                glDepthMask(GL_FALSE);
+                glEnable(GL_BLEND);
+                // alpha accumulates the transmittance left behind, for offscreen targets cleared to alpha 1
+                glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+            }
+
+            GLuint vertices = spriteVertices();
+            glBindVertexArray(emptyVAO);
+            if (src.indirectBuffer != 0) {
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, src.indirectBuffer);
+                glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(GLuint), &vertices);
+                glDrawArraysIndirect(GL_TRIANGLES, 0);
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            } else {
+                glDrawArraysInstanced(GL_TRIANGLES, 0, vertices, src.count);
+            }
+            glBindVertexArray(0);
+
+            if (override == NULL) {
+                glDisable(GL_BLEND);
+                glDepthMask(GL_TRUE);
+            }
+        }
+
+        /**
+         * @brief Trims sprites of the current atlas to its frame outlines, which must share its grid
+         *
+         * @param flipbook Outlines of the atlas, or null to draw full quads
+         */
+        void setFlipbook(Flipbook* flipbook) {
+            outlineVertices = 0;
+            if (flipbook == NULL || flipbook->cols != atlasCols || flipbook->rows != atlasRows)
+                return;
+
+            if (outlineBuffer == 0)
+                glGenBuffers(1, &outlineBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, outlineBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, flipbook->vertices.size() * sizeof(glm::vec2), &flipbook->vertices[0], GL_STATIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            outlineVertices = flipbook->vertexCount;
+        }
+
+        // vertices drawn per sprite
+        int spriteVertices() {
+            return atlas != 0 && outlineVertices > 0 ? (outlineVertices - 2) * 3 : 6;
+        }
+
+        /**
+         * @brief Sets the scene depth that sprites fade against (see SceneDepth)
+         *
+         * @param texture Depth texture, or 0 to disable soft particles
+         * @param linear Whether it holds linear view depth rather than window depth
+         */
+        void setSceneDepth(unsigned int texture, bool linear) {
+            sceneDepth = texture;
+            sceneDepthLinear = linear;
+        }
+
+    private:
+        unsigned int emptyVAO;
+        GLuint outlineBuffer = 0;
+
+        // color multiplier of each layer
+        glm::vec3 layerTint(ParticleLayer layer) {
+            if (layer == LAYER_EMBER)
+                return glm::vec3(4.0f, 1.6f, 0.4f);
+            if (layer == LAYER_SMOKE)
+                return glm::vec3(0.15f, 0.14f, 0.13f);
+            return glm::vec3(1.0f, 1.0f, 1.0f);
+        }
+
+        // how additive each layer is, from 0 (over) to 1 (additive); premultiplied alpha covers both with one blend state
+        float layerAdditive(ParticleLayer layer) {
+            if (layer == LAYER_EMBER)
+                return 1.0f;
+            if (layer == LAYER_SMOKE)
+                return 0.0f;
+            return 0.7f;
+        }
+};
+
+/**
+ * @brief GPU copy of a CPU particle pool, in the shared particle buffer layout
+ */
+class CpuParticleBuffer {
+    public:
+        GLuint dataBuffer, drawList, identityList;
+        unsigned int capacity;
+        unsigned int count = 0;
+        EmitterSlicing slicing;     // of the emitter uploaded (its drawSlicing()), passed on to the draw
+
+        CpuParticleBuffer(unsigned int capacity) : capacity(capacity) {
+            glGenBuffers(1, &dataBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, dataBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, PARTICLE_STREAMS * capacity * sizeof(float), NULL, GL_STREAM_DRAW);
+
+            glGenBuffers(1, &drawList);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawList);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(uint32_t), NULL, GL_STREAM_DRAW);
+
+            // pools are dense, so unsorted particles are drawn in pool order
+            vector<uint32_t> identity(capacity);
+            for (unsigned int i = 0; i < capacity; i++)
+                identity[i] = i;
+            glGenBuffers(1, &identityList);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, identityList);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(uint32_t), &identity[0], GL_STATIC_DRAW);
+
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        ~CpuParticleBuffer() {
+            glDeleteBuffers(1, &dataBuffer);
+            glDeleteBuffers(1, &drawList);
+            glDeleteBuffers(1, &identityList);
+        }
+
+        /**
+         * @brief Uploads the live particles of a pool (whose maxCapacity must not exceed the buffer's capacity)
+         *
+         * @param pool Pool to upload
+         * @param order Optional draw order of count particle indices. Defaults to null (pool order)
+         */
+        void upload(ParticlePool* pool, const uint32_t* order = NULL) {
+            count = pool->count;
+            ordered = order != NULL;
+            if (count == 0)
+                return;
+
+            float* streams[PARTICLE_STREAMS] = {pool->px, pool->py, pool->pz, pool->vx, pool->vy, pool->vz, pool->age, pool->life, pool->size, (float*)pool->frame};
+
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, dataBuffer);
+            for (int s = 0; s < PARTICLE_STREAMS; s++)
+                glBufferSubData(GL_SHADER_STORAGE_BUFFER, s * capacity * sizeof(float), count * sizeof(float), streams[s]);
+
+            if (ordered) {
+                glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawList);
+                glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(uint32_t), order);
+            }
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        // draw description of the last upload
+        ParticleDrawSource drawSource(ParticleLayer layer) {
+            ParticleDrawSource src;
+            src.dataBuffer = dataBuffer;
+            src.drawList = ordered ? drawList : identityList;
+            src.capacity = capacity;
+            src.count = count;
+            src.layer = layer;
+            src.slicing = slicing;
+            return src;
+        }
+
+    private:
+        bool ordered = false;
+};
+
+#endif
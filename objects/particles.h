@@ -0,0 +1,890 @@
+/**
+ * @file particles.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief CPU particle system for fire, embers and smoke. Particles are stored as a structure of arrays in allocation-free pools (see particlepool.h), and are integrated with AVX2/SSE kernels (scalar fallback) split across cores by a JobSystem
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+using std::vector;
+using std::string;
+
+#include <glm/glm.hpp>
+
+#include "../util/jobs/jobs.h"
+#include "../util/timer.h"
+#include "particlepool.h"
+#include "emissionsurface.h"
+#include "noise.h"
+#include "sdf.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PARTICLE_SIMD_WIDTH 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PARTICLE_SIMD_WIDTH 4
+#else
+#define PARTICLE_SIMD_WIDTH 1
+#endif
+
+// Particles per parallel-for chunk; a multiple of every SIMD width
+#define PARTICLE_GRAIN 16384
+
+// Snapshot file header
+#define PARTICLE_SNAPSHOT_MAGIC 0x50534e53u   // "SNSP"
+#define PARTICLE_SNAPSHOT_VERSION 1u
+
+// Streams stored per particle in a snapshot; size and frame follow from age and life, so they are rebuilt on load
+#define PARTICLE_SNAPSHOT_STREAMS 8
+
+// Most slices an emitter's pool can be stepped in (see EmitterDesc::updateSlices); also the size of the slice uniforms in particle.vert
+#define PARTICLE_MAX_SLICES 4
+
+// Render layer a particle belongs to (fire and smoke are drawn as separate layers)
+enum ParticleLayer {
+    LAYER_FIRE=0, LAYER_EMBER=1, LAYER_SMOKE=2
+};
+
+/**
+ * @brief Describes an emitter. Plain data, so the same description drives both the CPU and the GPU particle paths
+ */
+struct EmitterDesc {
+    ParticleLayer layer = LAYER_FIRE;
+    unsigned int capacity = 4096;                       // maximum number of live particles
+
+    glm::vec3 position = glm::vec3(0, 0, 0);            // center of the spawn sphere
+    float radius = 0.1f;                                // radius of the spawn sphere; on a surface, how far above it particles start
+    const EmissionSurface* surface = NULL;              // if set, particles spawn on these triangles instead of in the sphere
+    float normalSpeed = 0.0f;                           // speed along the surface normal added at birth
+    float spawnRate = 512.0f;                           // particles per second
+
+    float lifeMin = 1.0f, lifeMax = 2.0f;               // lifetime range in seconds
+    glm::vec3 velocity = glm::vec3(0, 1, 0);            // mean initial velocity
+    float velocitySpread = 0.25f;                       // random velocity added per axis, in [-spread, spread]
+    glm::vec3 acceleration = glm::vec3(0, 0.5f, 0);     // gravity plus buoyancy
+    float drag = 0.5f;                                  // fraction of velocity lost per second
+    float turbulence = 0.0f;                            // curl-noise acceleration (see noise.h); 0 disables it
+    float turbulenceScale = 0.5f;                       // noise tiles per world unit
+    bool collide = false;                               // bounce off the scene (SDF on the CPU, depth buffer on the GPU)
+    float restitution = 0.4f;                           // fraction of the normal speed kept on a bounce
+    float friction = 0.3f;                              // fraction of the tangential speed lost on a bounce
+
+    float sizeStart = 0.2f, sizeEnd = 0.05f;            // billboard size at birth and at death
+    unsigned int frameCount = 1;                        // flipbook frames played over a particle's lifetime
+
+    unsigned int updateSlices = 1;                      // CPU only: each step integrates one of this many slices of the pool (up to PARTICLE_MAX_SLICES), round robin, by the time since that slice was last stepped
+    bool extrapolate = true;                            // particles are drawn moved on by their velocity for the time since they were last stepped (slices, LOD intervals)
+
+    unsigned int seed = 1;
+};
+
+/**
+ * @brief Bounding sphere of everything an emitter's particles can reach over their lifetime
+ *
+ * @param desc Emitter to bound
+ * @param center Set to the center of the sphere
+ * @param radius Set to its radius
+ */
+inline void emitterBounds(const EmitterDesc& desc, glm::vec3& center, float& radius) {
+    glm::vec3 spawnCenter = desc.position;
+    float spawnRadius = desc.radius;
+    float speed = 0.0f;
+    if (desc.surface != NULL) {
+        spawnCenter = desc.surface->center;
+        spawnRadius = desc.surface->radius + desc.radius;
+        speed = desc.normalSpeed;
+    }
+
+    float life = desc.lifeMax;
+    glm::vec3 drift = desc.velocity * life + desc.acceleration * (0.5f * life * life);
+    center = spawnCenter + drift * 0.5f;
+    radius = spawnRadius + glm::length(drift) * 0.5f + (desc.velocitySpread + speed) * life + fmaxf(desc.sizeStart, desc.sizeEnd);
+}
+
+/**
+ * @brief Level of detail an emitter runs at, set each frame by a ParticleLod (see particlelod.h). Shared by the CPU and the GPU emitters
+ */
+struct EmitterLod {
+    float spawnScale = 1.0f;        // multiplier of the spawn rate
+    float sizeScale = 1.0f;         // multiplier of billboard size, so fewer particles still cover the same area
+    unsigned int interval = 1;      // the emitter is stepped once every interval frames, with the time accumulated since
+
+    // the description with this level applied
+    EmitterDesc apply(const EmitterDesc& desc) const {
+        EmitterDesc d = desc;
+        d.spawnRate *= spawnScale;
+        d.sizeStart *= sizeScale;
+        d.sizeEnd *= sizeScale;
+        return d;
+    }
+};
+
+/**
+ * @brief Accumulates frame time for an emitter stepped at a reduced frequency
+ */
+struct EmitterClock {
+    float pending = 0.0f;
+    unsigned int frame = 0;
+
+    /**
+     * @brief Advances by one frame
+     *
+     * @param dt Frame time in seconds
+     * @param interval Frames per step
+     * @param step Set to the time to step by, when a step is due
+     * @return true if the emitter should be stepped this frame
+     */
+    bool tick(float dt, unsigned int interval, float& step) {
+        pending += dt;
+        if (++frame < interval)
+            return false;
+        step = pending;
+        pending = 0.0f;
+        frame = 0;
+        return true;
+    }
+};
+
+/**
+ * @brief How an emitter stepped in slices (see EmitterDesc::updateSlices) splits its pool. Slice s is particles [start[s], start[s + 1]), and a particle stays in its slice for life, so every particle is stepped exactly once per round, by exactly the time since its last step. The renderer uses the lags to extrapolate the slices left behind
+ */
+struct EmitterSlicing {
+    unsigned int slices = 0;                            // 0 until the pool is split; the pool is then current
+    unsigned int current = 0;                           // slice stepped last
+    unsigned int start[PARTICLE_MAX_SLICES + 1] = {};   // first particle of each slice; start[slices] is one past the last
+    float lag[PARTICLE_MAX_SLICES] = {};                // time since each slice was last stepped
+};
+
+/**
+ * @brief Particles [begin, end) of a pool, to be stepped by dt seconds
+ */
+struct StepRange {
+    unsigned int begin, end;
+    float dt;
+};
+
+/**
+ * @brief FNV-1a over the inputs a snapshot depends on; two systems with equal keys evolve identically
+ */
+struct SnapshotKey {
+    uint64_t hash = 14695981039346656037ULL;
+
+    void add(const void* data, size_t bytes) {
+        const unsigned char* b = (const unsigned char*)data;
+        for (size_t i = 0; i < bytes; i++)
+            hash = (hash ^ b[i]) * 1099511628211ULL;
+    }
+
+    template <class T>
+    void add(const T& value) {
+        add(&value, sizeof(T));
+    }
+};
+
+/**
+ * @brief Per-frame constants of the integration kernel, derived from an EmitterDesc
+ */
+struct ParticleKernelParams {
+    float dt;
+    float ax, ay, az;
+    float damping;          // velocity multiplier for this step
+    float sizeStart, sizeDelta;
+    float lastFrame;        // frameCount - 1
+    float turbulence;       // curl-noise velocity change for this step
+    float turbulenceScale;
+    bool collide;
+    float collisionRadius;  // distance kept from surfaces
+    float restitution, friction;
+};
+
+/**
+ * @brief Integrates particles [begin, end) of a pool: velocity, position, age, size and flipbook frame. Vectorized with AVX2 or SSE when available, with a scalar tail
+ *
+ * @param p Pool to integrate
+ * @param k Kernel constants
+ * @param begin First particle
+ * @param end One past the last particle
+ */
+inline void integrateParticles(ParticlePool* p, const ParticleKernelParams& k, size_t begin, size_t end) {
+    size_t i = begin;
+
+#if PARTICLE_SIMD_WIDTH == 8
+    const __m256 dt = _mm256_set1_ps(k.dt);
+    const __m256 ax = _mm256_set1_ps(k.ax * k.dt), ay = _mm256_set1_ps(k.ay * k.dt), az = _mm256_set1_ps(k.az * k.dt);
+    const __m256 damp = _mm256_set1_ps(k.damping);
+    const __m256 s0 = _mm256_set1_ps(k.sizeStart), sd = _mm256_set1_ps(k.sizeDelta);
+    const __m256 lf = _mm256_set1_ps(k.lastFrame), nf = _mm256_set1_ps(k.lastFrame + 1.0f);
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+
+    for (; i + 8 <= end; i += 8) {
+        __m256 vx = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(p->vx + i), ax), damp);
+        __m256 vy = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(p->vy + i), ay), damp);
+        __m256 vz = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(p->vz + i), az), damp);
+        _mm256_storeu_ps(p->vx + i, vx);
+        _mm256_storeu_ps(p->vy + i, vy);
+        _mm256_storeu_ps(p->vz + i, vz);
+
+        _mm256_storeu_ps(p->px + i, _mm256_add_ps(_mm256_loadu_ps(p->px + i), _mm256_mul_ps(vx, dt)));
+        _mm256_storeu_ps(p->py + i, _mm256_add_ps(_mm256_loadu_ps(p->py + i), _mm256_mul_ps(vy, dt)));
+        _mm256_storeu_ps(p->pz + i, _mm256_add_ps(_mm256_loadu_ps(p->pz + i), _mm256_mul_ps(vz, dt)));
+
+        __m256 age = _mm256_add_ps(_mm256_loadu_ps(p->age + i), dt);
+        _mm256_storeu_ps(p->age + i, age);
+
+        __m256 t = _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(age, _mm256_loadu_ps(p->life + i)), zero), one);
+        _mm256_storeu_ps(p->size + i, _mm256_add_ps(s0, _mm256_mul_ps(sd, t)));
+        _mm256_storeu_si256((__m256i*)(p->frame + i), _mm256_cvttps_epi32(_mm256_min_ps(_mm256_mul_ps(t, nf), lf)));
+    }
+#elif PARTICLE_SIMD_WIDTH == 4
+    const __m128 dt = _mm_set1_ps(k.dt);
+    const __m128 ax = _mm_set1_ps(k.ax * k.dt), ay = _mm_set1_ps(k.ay * k.dt), az = _mm_set1_ps(k.az * k.dt);
+    const __m128 damp = _mm_set1_ps(k.damping);
+    const __m128 s0 = _mm_set1_ps(k.sizeStart), sd = _mm_set1_ps(k.sizeDelta);
+    const __m128 lf = _mm_set1_ps(k.lastFrame), nf = _mm_set1_ps(k.lastFrame + 1.0f);
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+
+    for (; i + 4 <= end; i += 4) {
+        __m128 vx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(p->vx + i), ax), damp);
+        __m128 vy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(p->vy + i), ay), damp);
+        __m128 vz = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(p->vz + i), az), damp);
+        _mm_storeu_ps(p->vx + i, vx);
+        _mm_storeu_ps(p->vy + i, vy);
+        _mm_storeu_ps(p->vz + i, vz);
+
+        _mm_storeu_ps(p->px + i, _mm_add_ps(_mm_loadu_ps(p->px + i), _mm_mul_ps(vx, dt)));
+        _mm_storeu_ps(p->py + i, _mm_add_ps(_mm_loadu_ps(p->py + i), _mm_mul_ps(vy, dt)));
+        _mm_storeu_ps(p->pz + i, _mm_add_ps(_mm_loadu_ps(p->pz + i), _mm_mul_ps(vz, dt)));
+
+        __m128 age = _mm_add_ps(_mm_loadu_ps(p->age + i), dt);
+        _mm_storeu_ps(p->age + i, age);
+
+        __m128 t = _mm_min_ps(_mm_max_ps(_mm_div_ps(age, _mm_loadu_ps(p->life + i)), zero), one);
+        _mm_storeu_ps(p->size + i, _mm_add_ps(s0, _mm_mul_ps(sd, t)));
+        _mm_storeu_si128((__m128i*)(p->frame + i), _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(t, nf), lf)));
+    }
+#endif
+
+    // scalar fallback, and the tail of the vector loops
+    for (; i < end; i++) {
+        p->vx[i] = (p->vx[i] + k.ax * k.dt) * k.damping;
+        p->vy[i] = (p->vy[i] + k.ay * k.dt) * k.damping;
+        p->vz[i] = (p->vz[i] + k.az * k.dt) * k.damping;
+
+        p->px[i] += p->vx[i] * k.dt;
+        p->py[i] += p->vy[i] * k.dt;
+        p->pz[i] += p->vz[i] * k.dt;
+
+        p->age[i] += k.dt;
+
+        float t = fminf(fmaxf(p->age[i] / p->life[i], 0.0f), 1.0f);
+        p->size[i] = k.sizeStart + k.sizeDelta * t;
+        p->frame[i] = (uint32_t)fminf(t * (k.lastFrame + 1.0f), k.lastFrame);
+    }
+}
+
+/**
+ * @brief Small, fast PCG32 generator for spawning
+ */
+struct ParticleRNG {
+    uint64_t state;
+
+    ParticleRNG(uint64_t seed = 1) : state(seed * 6364136223846793005ULL + 1442695040888963407ULL) {}
+
+    uint32_t next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = (uint32_t)(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+
+    // uniform float in [0, 1)
+    float uniform() {
+        return (next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // uniform float in [a, b)
+    float range(float a, float b) {
+        return a + (b - a) * uniform();
+    }
+};
+
+/**
+ * @brief A single emitter: its description, its pool, and its spawn state
+ */
+class ParticleEmitter {
+    public:
+        EmitterDesc desc;
+        ParticlePool pool;
+        EmitterLod lod;
+        EmitterClock clock;
+        EmitterSlicing slicing;
+
+        /**
+         * @brief Creates an emitter
+         *
+         * @param desc Emitter description
+         * @param slab Slab its pool grows and shrinks in. Defaults to null (a fixed pool of desc.capacity)
+         */
+        ParticleEmitter(const EmitterDesc& desc, ParticleSlab* slab = NULL) : desc(desc), pool(desc.capacity, slab), rng(desc.seed), surfaceRng(desc.seed) {}
+
+        /**
+         * @brief Spawns the particles owed for this step, first fitting the pool to the count about to be live. Spawns beyond capacity are dropped and counted in pool.spawnFailures
+         *
+         * @param dt Time step in seconds
+         */
+        void spawn(float dt) {
+            EmitterDesc desc = lod.apply(this->desc);
+            spawnAccumulator += desc.spawnRate * dt;
+            unsigned int n = (unsigned int)spawnAccumulator;
+            spawnAccumulator -= n;
+
+            // without triangles a surface emitter has nowhere to spawn
+            const EmissionSurface* surface = desc.surface;
+            if (surface != NULL && surface->triangleCount == 0)
+                return;
+
+            pool.reserve(pool.count + n);
+            unsigned int granted;
+            unsigned int first = pool.spawn(n, granted);
+
+            // surface points in one batch; the normals are parked in the velocity streams until the loop below
+            if (surface != NULL)
+                surface->sample(surfaceRng, granted, pool.px + first, pool.py + first, pool.pz + first, pool.vx + first, pool.vy + first, pool.vz + first);
+
+            for (unsigned int i = first; i < first + granted; i++) {
+                if (surface != NULL) {
+                    // lifted off the surface, and pushed away from it
+                    float nx = pool.vx[i], ny = pool.vy[i], nz = pool.vz[i];
+                    float lift = rng.range(0.0f, desc.radius);
+                    pool.px[i] += nx * lift;
+                    pool.py[i] += ny * lift;
+                    pool.pz[i] += nz * lift;
+                    pool.vx[i] = desc.velocity.x + nx * desc.normalSpeed + rng.range(-desc.velocitySpread, desc.velocitySpread);
+                    pool.vy[i] = desc.velocity.y + ny * desc.normalSpeed + rng.range(-desc.velocitySpread, desc.velocitySpread);
+                    pool.vz[i] = desc.velocity.z + nz * desc.normalSpeed + rng.range(-desc.velocitySpread, desc.velocitySpread);
+                } else {
+                    // uniform point in the spawn sphere (rejection sampled)
+                    float x, y, z;
+                    do {
+                        x = rng.range(-1, 1); y = rng.range(-1, 1); z = rng.range(-1, 1);
+                    } while (x * x + y * y + z * z > 1.0f);
+
+                    pool.px[i] = desc.position.x + x * desc.radius;
+                    pool.py[i] = desc.position.y + y * desc.radius;
+                    pool.pz[i] = desc.position.z + z * desc.radius;
+                    pool.vx[i] = desc.velocity.x + rng.range(-desc.velocitySpread, desc.velocitySpread);
+                    pool.vy[i] = desc.velocity.y + rng.range(-desc.velocitySpread, desc.velocitySpread);
+                    pool.vz[i] = desc.velocity.z + rng.range(-desc.velocitySpread, desc.velocitySpread);
+                }
+                pool.age[i] = 0.0f;
+                pool.life[i] = rng.range(desc.lifeMin, desc.lifeMax);
+                pool.size[i] = desc.sizeStart;
+                pool.frame[i] = 0;
+            }
+        }
+
+        /**
+         * @brief Builds the integration kernel constants for a step of dt seconds
+         */
+        ParticleKernelParams kernelParams(float dt) {
+            EmitterDesc desc = lod.apply(this->desc);
+            ParticleKernelParams k;
+            k.dt = dt;
+            k.ax = desc.acceleration.x; k.ay = desc.acceleration.y; k.az = desc.acceleration.z;
+            k.damping = expf(-desc.drag * dt);
+            k.sizeStart = desc.sizeStart;
+            k.sizeDelta = desc.sizeEnd - desc.sizeStart;
+            k.lastFrame = (float)(desc.frameCount > 0 ? desc.frameCount - 1 : 0);
+            k.turbulence = desc.turbulence * dt;
+            k.turbulenceScale = desc.turbulenceScale;
+            k.collide = desc.collide;
+            k.collisionRadius = 0.5f * desc.sizeStart;
+            k.restitution = desc.restitution;
+            k.friction = desc.friction;
+            return k;
+        }
+
+        /**
+         * @brief Plans one step of the pool after spawn(): the slice due this step, by the time since it was last stepped, and the particles spawned this step, by the step. When desc.updateSlices has changed (or the pool was refilled outside update()), every slice is stepped up to now instead and the pool is split afresh in finishStep()
+         *
+         * @param step Length of this step in seconds
+         * @param fresh Pool count before spawn(); particles from here on are new
+         * @param ranges Ranges to step are appended here
+         */
+        void planStep(float step, unsigned int fresh, vector<StepRange>& ranges) {
+            EmitterSlicing& sl = slicing;
+
+            // presimulate() and snapshots leave the whole pool current
+            if (sl.slices == 0 || sl.start[sl.slices] != fresh) {
+                sl.slices = 1;
+                sl.current = 0;
+                sl.start[0] = 0;
+                sl.start[1] = fresh;
+                sl.lag[0] = 0.0f;
+            }
+            for (unsigned int s = 0; s < sl.slices; s++)
+                sl.lag[s] += step;
+
+            resplit = wantedSlices() != sl.slices;
+            if (resplit) {
+                for (unsigned int s = 0; s < sl.slices; s++)
+                    addRange(ranges, sl.start[s], sl.start[s + 1], sl.lag[s]);
+            } else {
+                sl.current = (sl.current + 1) % sl.slices;
+                addRange(ranges, sl.start[sl.current], sl.start[sl.current + 1], sl.lag[sl.current]);
+            }
+            addRange(ranges, fresh, pool.count, step);
+        }
+
+        /**
+         * @brief Settles a step planned by planStep(), once its ranges are stepped. Particles that died in the stepped slice are refilled from the end of that slice, shifting each later slice down by one, so no particle changes slice. The new particles then join the slice just stepped, which is as current as they are
+         */
+        void finishStep() {
+            EmitterSlicing& sl = slicing;
+            if (resplit) {
+                compact();
+                split(wantedSlices());
+                return;
+            }
+
+            unsigned int c = sl.current;
+            for (unsigned int i = sl.start[c]; i < sl.start[c + 1];) {
+                if (pool.age[i] >= pool.life[i])
+                    killInSlice(i, c);
+                else
+                    i++;
+            }
+            for (unsigned int i = sl.start[sl.slices]; i < pool.count;) {
+                if (pool.age[i] >= pool.life[i])
+                    pool.kill(i);
+                else
+                    i++;
+            }
+            while (sl.start[sl.slices] < pool.count)
+                joinSlice(c);
+            sl.lag[c] = 0.0f;
+        }
+
+        /**
+         * @brief How to draw the pool now: each slice's lag plus the time the clock has accumulated toward the next step. No slices when extrapolation is off or the pool is not split
+         */
+        EmitterSlicing drawSlicing() const {
+            EmitterSlicing sl = slicing;
+            if (!desc.extrapolate)
+                sl.slices = 0;
+            for (unsigned int s = 0; s < sl.slices; s++)
+                sl.lag[s] += clock.pending;
+            return sl;
+        }
+
+        /**
+         * @brief Removes particles that have outlived their lifetime. Each is swapped with the last live particle, so the pool stays dense at one move per death. This reorders the pool, so the slices are dropped until the next step
+         */
+        void compact() {
+            for (unsigned int i = 0; i < pool.count;) {
+                if (pool.age[i] >= pool.life[i])
+                    pool.kill(i);
+                else
+                    i++;
+            }
+            slicing.slices = 0;
+        }
+
+        /**
+         * @brief Adds everything the emitter's evolution depends on to a snapshot key. The description is added field by field, since it holds a pointer and padding; its surface counts by every triangle
+         */
+        void addKey(SnapshotKey& key) const {
+            key.add(desc.layer); key.add(desc.capacity);
+            key.add(desc.position); key.add(desc.radius); key.add(desc.spawnRate);
+            key.add(desc.lifeMin); key.add(desc.lifeMax);
+            key.add(desc.velocity); key.add(desc.velocitySpread); key.add(desc.acceleration); key.add(desc.drag);
+            key.add(desc.turbulence); key.add(desc.turbulenceScale);
+            key.add(desc.collide); key.add(desc.restitution); key.add(desc.friction);
+            key.add(desc.sizeStart); key.add(desc.sizeEnd); key.add(desc.frameCount); key.add(desc.seed);
+            key.add(desc.normalSpeed);
+            if (desc.surface != NULL && desc.surface->triangleCount > 0) {
+                const vector<SurfaceTriangle>& r = desc.surface->getRecords();
+                key.add(&r[0], r.size() * sizeof(SurfaceTriangle));
+            }
+        }
+
+        /**
+         * @brief Writes the live particles and the spawn state
+         *
+         * @return bool representing the success of the operation
+         */
+        bool writeState(FILE* file) const {
+            uint32_t header[2] = {pool.count, clock.frame};
+            float timing[2] = {spawnAccumulator, clock.pending};
+            bool ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(timing, sizeof(timing), 1, file) == 1
+                   && fwrite(&rng.state, sizeof(rng.state), 1, file) == 1 && fwrite(surfaceRng.s, sizeof(surfaceRng.s), 1, file) == 1;
+            const float* streams[PARTICLE_SNAPSHOT_STREAMS] = {pool.px, pool.py, pool.pz, pool.vx, pool.vy, pool.vz, pool.age, pool.life};
+            for (int s = 0; s < PARTICLE_SNAPSHOT_STREAMS && ok && pool.count > 0; s++)
+                ok = fwrite(streams[s], sizeof(float), pool.count, file) == pool.count;
+            return ok;
+        }
+
+        /**
+         * @brief Reads what writeState() wrote, then rebuilds each particle's size and flipbook frame. On failure the pool is left empty
+         *
+         * @return bool representing the success of the operation
+         */
+        bool readState(FILE* file) {
+            uint32_t header[2];
+            float timing[2];
+            bool ok = fread(header, sizeof(header), 1, file) == 1 && fread(timing, sizeof(timing), 1, file) == 1
+                   && fread(&rng.state, sizeof(rng.state), 1, file) == 1 && fread(surfaceRng.s, sizeof(surfaceRng.s), 1, file) == 1
+                   && header[0] <= pool.maxCapacity;
+            pool.count = 0;
+            if (ok) {
+                unsigned int granted;
+                pool.reserve(header[0]);
+                pool.spawn(header[0], granted);
+                ok = granted == header[0];
+            }
+            float* streams[PARTICLE_SNAPSHOT_STREAMS] = {pool.px, pool.py, pool.pz, pool.vx, pool.vy, pool.vz, pool.age, pool.life};
+            for (int s = 0; s < PARTICLE_SNAPSHOT_STREAMS && ok && pool.count > 0; s++)
+                ok = fread(streams[s], sizeof(float), pool.count, file) == pool.count;
+            if (!ok) {
+                pool.count = 0;
+                return false;
+            }
+
+            spawnAccumulator = timing[0];
+            clock.pending = timing[1];
+            clock.frame = header[1];
+            slicing.slices = 0;
+            // a step of no time moves nothing, and recomputes size and frame from age
+            integrateParticles(&pool, kernelParams(0.0f), 0, pool.count);
+            return true;
+        }
+
+    private:
+        bool resplit = false;       // the step planned changes the slice count
+
+        // desc.updateSlices, clamped to what the slicing can hold
+        unsigned int wantedSlices() const {
+            return desc.updateSlices < 1 ? 1 : desc.updateSlices > PARTICLE_MAX_SLICES ? PARTICLE_MAX_SLICES : desc.updateSlices;
+        }
+
+        static void addRange(vector<StepRange>& ranges, unsigned int begin, unsigned int end, float dt) {
+            if (begin >= end)
+                return;
+            // adjacent ranges stepped by the same time run as one
+            if (!ranges.empty() && ranges.back().end == begin && ranges.back().dt == dt)
+                ranges.back().end = end;
+            else
+                ranges.push_back(StepRange{begin, end, dt});
+        }
+
+        // splits the pool, all of it current, into slices of whole SIMD groups; the next step takes slice 0
+        void split(unsigned int slices) {
+            EmitterSlicing& sl = slicing;
+            unsigned int size = ((pool.count + slices - 1) / slices + 15) & ~15u;
+            sl.slices = slices;
+            sl.current = slices - 1;
+            for (unsigned int s = 0; s < slices; s++) {
+                sl.start[s] = s * size < pool.count ? s * size : pool.count;
+                sl.lag[s] = 0.0f;
+            }
+            sl.start[slices] = pool.count;
+        }
+
+        // removes particle i of slice c: the last of slice c takes its place, and every later slice (the new particles
+        // last) moves its last particle into the gap before it
+        void killInSlice(unsigned int i, unsigned int c) {
+            EmitterSlicing& sl = slicing;
+            unsigned int hole = sl.start[c + 1] - 1;
+            if (i != hole)
+                pool.move(i, hole);
+            for (unsigned int j = c + 1; j <= sl.slices; j++) {
+                unsigned int last = (j < sl.slices ? sl.start[j + 1] : pool.count) - 1;
+                if (last != hole)
+                    pool.move(hole, last);
+                hole = last;
+                sl.start[j]--;
+            }
+            pool.count--;
+        }
+
+        // moves the first new particle into slice c, past the slices after it, by swapping it with the first particle of each
+        void joinSlice(unsigned int c) {
+            EmitterSlicing& sl = slicing;
+            unsigned int p = sl.start[sl.slices];
+            for (unsigned int j = sl.slices; j > c + 1; j--) {
+                unsigned int q = sl.start[j - 1];
+                if (q != p)
+                    pool.swap(p, q);
+                sl.start[j]++;
+                p = q;
+            }
+            sl.start[c + 1]++;
+        }
+
+        ParticleRNG rng;
+        SurfaceRNG surfaceRng;
+        float spawnAccumulator = 0.0f;
+};
+
+/**
+ * @brief Owns a set of emitters and steps them with the job system
+ */
+class ParticleSystem {
+    public:
+        vector<ParticleEmitter*> emitters;
+        const NoiseField* turbulenceField = NULL;   // curl field for emitters with turbulence; null disables it
+        const SignedDistanceField* collisionField = NULL;   // static scene for emitters that collide; null disables it
+
+        ParticleSlab* slab;     // shared by the pools of every emitter; null gives each a fixed pool instead
+        double lastWarmMs = 0.0;    // time the last warmStart() took
+
+        /**
+         * @brief Creates an empty system
+         *
+         * @param jobs Job system to step on
+         * @param slab Slab for the emitters' pools. Defaults to null (fixed pools)
+         */
+        ParticleSystem(JobSystem* jobs, ParticleSlab* slab = NULL) : slab(slab), jobs(jobs) {}
+
+        ~ParticleSystem() {
+            for (unsigned int i = 0; i < emitters.size(); i++)
+                delete emitters[i];
+        }
+
+        // creates an emitter owned by this system
+        ParticleEmitter* addEmitter(const EmitterDesc& desc) {
+            ParticleEmitter* e = new ParticleEmitter(desc, slab);
+            emitters.push_back(e);
+            return e;
+        }
+
+        /**
+         * @brief Advances every emitter by dt seconds: spawn, add turbulence, integrate and collide (in parallel chunks across all emitters), then compact (in parallel across emitters). Emitters whose lod.interval is above 1 are only stepped every few frames, by the time accumulated since. Emitters with desc.updateSlices above 1 spawn every step but integrate only one slice of their pool, by the time since that slice was last stepped (see EmitterSlicing)
+         *
+         * @param dt Time step in seconds
+         */
+        void update(float dt) {
+            chunks.clear();
+            params.clear();
+            stepped.assign(emitters.size(), 0);
+            for (unsigned int e = 0; e < emitters.size(); e++) {
+                ParticleEmitter* em = emitters[e];
+                float step;
+                if (!em->clock.tick(dt, em->lod.interval, step))
+                    continue;
+                unsigned int fresh = em->pool.count;
+                em->spawn(step);
+                stepRanges.clear();
+                em->planStep(step, fresh, stepRanges);
+                stepped[e] = 1;
+
+                for (unsigned int r = 0; r < stepRanges.size(); r++) {
+                    params.push_back(em->kernelParams(stepRanges[r].dt));
+                    addChunks(e, params.size() - 1, stepRanges[r].begin, stepRanges[r].end);
+                }
+            }
+
+            jobs->parallelFor(chunks.size(), 1, [this](size_t begin, size_t end) {
+                for (size_t c = begin; c < end; c++) {
+                    const Chunk& ch = chunks[c];
+                    stepParticles(&emitters[ch.emitter]->pool, params[ch.param], ch.begin, ch.end);
+                }
+            });
+
+            jobs->parallelFor(emitters.size(), 1, [this](size_t begin, size_t end) {
+                for (size_t e = begin; e < end; e++)
+                    if (stepped[e])
+                        emitters[e]->finishStep();
+            });
+        }
+
+        // total number of live particles across all emitters
+        unsigned int getParticleCount() {
+            unsigned int n = 0;
+            for (unsigned int i = 0; i < emitters.size(); i++)
+                n += emitters[i]->pool.count;
+            return n;
+        }
+
+        /**
+         * @brief Runs every emitter forward by a fixed number of steps, as fast as the cores allow. Every step is split into chunks across all emitters, as in update(), so one heavy emitter still uses every core. LOD and update slices are not applied
+         *
+         * @param seconds Time to simulate
+         * @param dt Step length in seconds
+         */
+        void presimulate(float seconds, float dt) {
+            int steps = (int)ceilf(seconds / dt);
+            for (int s = 0; s < steps; s++) {
+                chunks.clear();
+                params.clear();
+                for (unsigned int e = 0; e < emitters.size(); e++) {
+                    ParticleEmitter* em = emitters[e];
+                    em->spawn(dt);
+                    params.push_back(em->kernelParams(dt));
+                    addChunks(e, e, 0, em->pool.count);
+                }
+
+                jobs->parallelFor(chunks.size(), 1, [this](size_t begin, size_t end) {
+                    for (size_t c = begin; c < end; c++) {
+                        const Chunk& ch = chunks[c];
+                        stepParticles(&emitters[ch.emitter]->pool, params[ch.param], ch.begin, ch.end);
+                    }
+                });
+
+                jobs->parallelFor(emitters.size(), 1, [this](size_t begin, size_t end) {
+                    for (size_t e = begin; e < end; e++)
+                        emitters[e]->compact();
+                });
+            }
+        }
+
+        /**
+         * @brief Key of the state presimulate(seconds, dt) reaches from a fresh start: the emitters, the fields they feel, and the SIMD width (which sets the surface generator's state size). Emission surfaces and the collision field are hashed in full, so editing the geometry invalidates old snapshots even when the bounds stay put
+         */
+        uint64_t snapshotKey(float seconds, float dt) const {
+            SnapshotKey key;
+            key.add(seconds); key.add(dt);
+            uint32_t width = SURFACE_SIMD_WIDTH;
+            key.add(width);
+            uint32_t count = emitters.size();
+            key.add(count);
+            for (unsigned int i = 0; i < emitters.size(); i++)
+                emitters[i]->addKey(key);
+            if (turbulenceField != NULL) {
+                const NoiseParams& p = turbulenceField->params;
+                key.add(p.size); key.add(p.period); key.add(p.octaves); key.add(p.persistence); key.add(p.seed);
+            }
+            if (collisionField != NULL) {
+                key.add(collisionField->origin); key.add(collisionField->voxel);
+                key.add(collisionField->nx); key.add(collisionField->ny); key.add(collisionField->nz);
+                if (!collisionField->distance.empty())
+                    key.add(&collisionField->distance[0], collisionField->distance.size() * sizeof(float));
+            }
+            return key.hash;
+        }
+
+        /**
+         * @brief Writes the state of every emitter to a snapshot file
+         *
+         * @param path File to write
+         * @param key Key the state is filed under (see snapshotKey())
+         * @return bool representing the success of the operation
+         */
+        bool save(const string& path, uint64_t key) {
+            FILE* file = fopen(path.c_str(), "wb");
+            if (file == NULL)
+                return false;
+            uint32_t header[3] = {PARTICLE_SNAPSHOT_MAGIC, PARTICLE_SNAPSHOT_VERSION, (uint32_t)emitters.size()};
+            bool ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(&key, sizeof(key), 1, file) == 1;
+            for (unsigned int i = 0; i < emitters.size() && ok; i++)
+                ok = emitters[i]->writeState(file);
+            fclose(file);
+            return ok;
+        }
+
+        /**
+         * @brief Reads the state of every emitter from a snapshot file, if it exists and was filed under the same key. On a failed read partway through, every emitter is left empty
+         *
+         * @return bool representing the success of the operation
+         */
+        bool load(const string& path, uint64_t key) {
+            FILE* file = fopen(path.c_str(), "rb");
+            if (file == NULL)
+                return false;
+
+            uint32_t header[3];
+            uint64_t stored;
+            bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == PARTICLE_SNAPSHOT_MAGIC && header[1] == PARTICLE_SNAPSHOT_VERSION
+                   && header[2] == emitters.size() && fread(&stored, sizeof(stored), 1, file) == 1 && stored == key;
+            bool matched = ok;
+            for (unsigned int i = 0; i < emitters.size() && ok; i++)
+                ok = emitters[i]->readState(file);
+            if (matched && !ok)
+                for (unsigned int i = 0; i < emitters.size(); i++)
+                    emitters[i]->pool.count = 0;
+            fclose(file);
+            return ok;
+        }
+
+        /**
+         * @brief Brings freshly created emitters to steady state: from the snapshot in a directory if one matches, otherwise by presimulate() and then saving a snapshot for next time. Prints where the state came from and how long it took. Call once the fields the emitters feel are set
+         *
+         * @param directory Snapshot directory
+         * @param seconds Time to run the emitters for; the longest lifetime is enough to reach steady state
+         * @param dt Step length in seconds. Defaults to 1/60
+         */
+        void warmStart(const string& directory, float seconds, float dt = 1.0f / 60.0f) {
+            Timer timer;
+            uint64_t key = snapshotKey(seconds, dt);
+            char name[64];
+            snprintf(name, sizeof(name), "particles_%016llx.bin", (unsigned long long)key);
+            string path = directory + "/" + name;
+
+            bool loaded = load(path, key);
+            if (!loaded) {
+                presimulate(seconds, dt);
+                if (!save(path, key))
+                    std::cout << "Particles could not write snapshot: " << path << std::endl;
+            }
+            lastWarmMs = timer.elapsedMs();
+            std::cout << "particles " << getParticleCount() << " at " << seconds << " s: " << (loaded ? "snapshot loaded" : "pre-simulated") << " in " << lastWarmMs << " ms" << std::endl;
+        }
+
+        // spawns dropped across all emitters since they were created
+        unsigned int getSpawnFailures() {
+            unsigned int n = 0;
+            for (unsigned int i = 0; i < emitters.size(); i++)
+                n += emitters[i]->pool.spawnFailures;
+            return n;
+        }
+
+    private:
+        struct Chunk {
+            unsigned int emitter, begin, end;
+            unsigned int param;     // kernel parameters to step with
+        };
+
+        // splits particles [begin, end) of an emitter into chunks of at most PARTICLE_GRAIN
+        void addChunks(unsigned int emitter, unsigned int param, unsigned int begin, unsigned int end) {
+            for (unsigned int b = begin; b < end; b += PARTICLE_GRAIN)
+                chunks.push_back(Chunk{emitter, b, b + PARTICLE_GRAIN < end ? b + PARTICLE_GRAIN : end, param});
+        }
+
+        JobSystem* jobs;
+
+        /**
+         * @brief One step of particles [begin, end) of a pool: turbulence, integration, then collision
+         */
+        void stepParticles(ParticlePool* p, const ParticleKernelParams& k, size_t begin, size_t end) {
+            // turbulence is added to the velocity before the step, as on the GPU
+            if (turbulenceField != NULL && k.turbulence != 0.0f)
+                turbulenceField->addCurl(p->px + begin, p->py + begin, p->pz + begin, p->vx + begin, p->vy + begin, p->vz + begin,
+                                         end - begin, k.turbulenceScale, k.turbulence);
+            integrateParticles(p, k, begin, end);
+            if (collisionField != NULL && k.collide)
+                collisionField->collide(p->px + begin, p->py + begin, p->pz + begin, p->vx + begin, p->vy + begin, p->vz + begin,
+                                        end - begin, k.collisionRadius, k.restitution, k.friction);
+        }
+
+        // per-frame work lists, kept as members so their storage is reused between frames
+        vector<Chunk> chunks;
+        vector<ParticleKernelParams> params;
+        vector<StepRange> stepRanges;   // of the emitter being planned
+        vector<uint8_t> stepped;        // per emitter, whether it stepped this update
+};
+
+#endif
@@ -0,0 +1,265 @@
+/**
+ * @file particlesort.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Back-to-front ordering of CPU particles. Builds 32-bit depth keys from camera distance, and sorts indices with a multithreaded LSD radix sort, or with an insertion sort when last frame's order is still nearly sorted
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef PARTICLESORT_H
+#define PARTICLESORT_H
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using std::vector;
+
+#include <glm/glm.hpp>
+
+#include "particles.h"
+#include "../util/jobs/jobs.h"
+#include "../util/timer.h"
+
+// Radix digit width (four passes over 32-bit keys)
+#define SORT_RADIX_BITS 8
+#define SORT_RADIX_SIZE (1 << SORT_RADIX_BITS)
+
+// Below this many particles the sort runs on the calling thread only
+#define SORT_PARALLEL_MIN 32768
+
+// Most blocks a sort is split into across threads; the per-block scratch is sized for this many up front
+#define SORT_MAX_BLOCKS 64
+
+// Last frame's order is reused when at most 1 / SORT_COHERENT_DIV of adjacent pairs are out of order
+#define SORT_COHERENT_DIV 32
+
+// Adjacent pairs of last frame's order are first sampled this far apart, before every key is gathered
+#define SORT_SAMPLE_STRIDE 64
+
+// Which algorithm produced the last order
+enum SortPath {
+    SORT_NONE=0, SORT_RADIX=1, SORT_INSERTION=2
+};
+
+/**
+ * @brief Depth sorter for one particle pool. All scratch memory is allocated up front for the pool's capacity
+ */
+class ParticleSorter {
+    public:
+        // stats of the last sort
+        double lastMs = 0.0;
+        SortPath lastPath = SORT_NONE;
+        unsigned int lastCount = 0;
+
+        ParticleSorter(unsigned int capacity) : capacity(capacity), depthKeys(capacity), keys(capacity), values(capacity), tempKeys(capacity), tempValues(capacity),
+                                                histograms(SORT_MAX_BLOCKS * SORT_RADIX_SIZE), descents(SORT_MAX_BLOCKS) {}
+
+        /**
+         * @brief Orders the live particles of a pool from farthest to nearest
+         *
+         * @param pool Pool to sort (capacity must not exceed the sorter's)
+         * @param eye Camera position
+         * @param jobs Job system to run on
+         * @return const uint32_t* pool->count particle indices, back to front. Valid until the next call
+         */
+        const uint32_t* sort(ParticlePool* pool, glm::vec3 eye, JobSystem* jobs) {
+            Timer timer;
+            unsigned int count = pool->count;
+
+            // keys in pool order, streamed straight through the position arrays
+            unsigned int blocks = blockCount(count, jobs);
+            size_t grain = (count + blocks - 1) / blocks;
+            jobs->parallelFor(count, grain, [this, pool, eye](size_t begin, size_t end) {
+                buildKeys(pool, eye, begin, end);
+            });
+
+            bool sorted = false, gathered = false;
+            if (lastCount > 0 && count > 0) {
+                // last frame's permutation, patched up to cover exactly [0, count)
+                if (count < lastCount) {
+                    unsigned int n = 0;
+                    for (unsigned int i = 0; i < lastCount; i++)
+                        if (values[i] < count)
+                            values[n++] = values[i];
+                }
+                for (unsigned int i = lastCount; i < count; i++)
+                    values[i] = i;
+
+                if (sampleCoherent(count)) {
+                    // keys in that order, counting descents per block as they are gathered
+                    jobs->parallelFor(count, grain, [this, grain](size_t begin, size_t end) {
+                        gatherKeys(begin, end, begin / grain);
+                    });
+                    unsigned int total = 0;
+                    for (size_t b = 0; b < (count + grain - 1) / grain; b++)
+                        total += descents[b];
+
+                    // if insertion sort bails halfway, keys and values are still a consistent permutation for the radix sort
+                    sorted = total <= count / SORT_COHERENT_DIV && insertionSort(count);
+                    gathered = true;
+                }
+            }
+            if (!gathered) {
+                memcpy(&keys[0], &depthKeys[0], count * sizeof(uint32_t));
+                for (unsigned int i = 0; i < count; i++)
+                    values[i] = i;
+            }
+
+            if (sorted)
+                lastPath = SORT_INSERTION;
+            else {
+                radixSort(count, jobs);
+                lastPath = SORT_RADIX;
+            }
+
+            lastCount = count;
+            lastMs = timer.elapsedMs();
+            return &values[0];
+        }
+
+    private:
+        unsigned int capacity;
+        vector<uint32_t> depthKeys;     // key of every particle, in pool order
+        vector<uint32_t> keys, values;  // (key, particle index) pairs being sorted
+        vector<uint32_t> tempKeys, tempValues;
+        vector<uint32_t> histograms;    // SORT_RADIX_SIZE digit counts per block
+        vector<unsigned int> descents;  // out-of-order adjacent pairs per block, in last frame's order
+
+        // blocks a sort of count particles is split into
+        static unsigned int blockCount(unsigned int count, JobSystem* jobs) {
+            if (count < SORT_PARALLEL_MIN)
+                return 1;
+            return jobs->getThreadCount() < SORT_MAX_BLOCKS ? jobs->getThreadCount() : SORT_MAX_BLOCKS;
+        }
+
+        /**
+         * @brief Writes the key of particles [begin, end). Keys are the bit-inverted squared distance, so an ascending sort is back to front (positive floats order like their bit patterns)
+         */
+        void buildKeys(ParticlePool* pool, glm::vec3 eye, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                float dx = pool->px[i] - eye.x, dy = pool->py[i] - eye.y, dz = pool->pz[i] - eye.z;
+                float d2 = dx * dx + dy * dy + dz * dz;
+                uint32_t bits;
+                memcpy(&bits, &d2, sizeof(bits));
+                depthKeys[i] = ~bits;
+            }
+        }
+
+        // whether every SORT_SAMPLE_STRIDE-th adjacent pair of last frame's order is nearly sorted, which rules out a
+        // scrambled order (a moving camera or fast particles) for a small fraction of the cost of gathering every key
+        bool sampleCoherent(unsigned int count) {
+            unsigned int samples = 0, n = 0;
+            for (unsigned int i = 1; i < count; i += SORT_SAMPLE_STRIDE, samples++)
+                n += depthKeys[values[i - 1]] > depthKeys[values[i]];
+            return n <= samples / SORT_COHERENT_DIV;
+        }
+
+        /**
+         * @brief Gathers the keys of [begin, end) in last frame's order, and counts the adjacent pairs that are out of order, including the one across the block's first edge
+         */
+        void gatherKeys(size_t begin, size_t end, size_t block) {
+            uint32_t prev = begin > 0 ? depthKeys[values[begin - 1]] : 0;
+            unsigned int n = 0;
+            for (size_t i = begin; i < end; i++) {
+                uint32_t k = depthKeys[values[i]];
+                n += prev > k;
+                keys[i] = prev = k;
+            }
+            descents[block] = n;
+        }
+
+        /**
+         * @brief Insertion sort of (key, value) pairs, with a budget on element moves so that a few far-travelling particles cannot make it quadratic
+         *
+         * @return true if the sort completed within budget
+         */
+        bool insertionSort(unsigned int count) {
+            size_t budget = (size_t)count * 8;
+            for (unsigned int i = 1; i < count; i++) {
+                uint32_t k = keys[i], v = values[i];
+                unsigned int j = i;
+                while (j > 0 && keys[j - 1] > k) {
+                    keys[j] = keys[j - 1];
+                    values[j] = values[j - 1];
+                    j--;
+                    if (--budget == 0) {
+                        keys[j] = k;
+                        values[j] = v;
+                        return false;
+                    }
+                }
+                keys[j] = k;
+                values[j] = v;
+            }
+            return true;
+        }
+
+        /**
+         * @brief LSD radix sort of (key, value) pairs. Each pass builds per-block digit histograms in parallel, scans them on the calling thread, then scatters every block in parallel. Passes whose digit is the same for every key are skipped
+         */
+        void radixSort(unsigned int count, JobSystem* jobs) {
+            unsigned int blocks = blockCount(count, jobs);
+            size_t blockSize = (count + blocks - 1) / blocks;
+
+            uint32_t* srcK = &keys[0];
+            uint32_t* srcV = &values[0];
+            uint32_t* dstK = &tempKeys[0];
+            uint32_t* dstV = &tempValues[0];
+
+            for (unsigned int shift = 0; shift < 32; shift += SORT_RADIX_BITS) {
+                uint32_t* hist = &histograms[0];
+
+                jobs->parallelFor(blocks, 1, [=](size_t begin, size_t end) {
+                    for (size_t b = begin; b < end; b++) {
+                        uint32_t* h = hist + b * SORT_RADIX_SIZE;
+                        memset(h, 0, SORT_RADIX_SIZE * sizeof(uint32_t));
+                        size_t first = b * blockSize, last = first + blockSize < count ? first + blockSize : count;
+                        for (size_t i = first; i < last; i++)
+                            h[(srcK[i] >> shift) & (SORT_RADIX_SIZE - 1)]++;
+                    }
+                });
+
+                // exclusive scan in (digit, block) order turns counts into scatter offsets
+                uint32_t sum = 0;
+                bool trivial = false;
+                for (unsigned int d = 0; d < SORT_RADIX_SIZE; d++) {
+                    uint32_t digitTotal = 0;
+                    for (unsigned int b = 0; b < blocks; b++) {
+                        uint32_t c = hist[b * SORT_RADIX_SIZE + d];
+                        hist[b * SORT_RADIX_SIZE + d] = sum;
+                        sum += c;
+                        digitTotal += c;
+                    }
+                    if (digitTotal == count)
+                        trivial = true;
+                }
+                if (trivial)
+                    continue;
+
+                jobs->parallelFor(blocks, 1, [=](size_t begin, size_t end) {
+                    for (size_t b = begin; b < end; b++) {
+                        uint32_t* h = hist + b * SORT_RADIX_SIZE;
+                        size_t first = b * blockSize, last = first + blockSize < count ? first + blockSize : count;
+                        for (size_t i = first; i < last; i++) {
+                            uint32_t o = h[(srcK[i] >> shift) & (SORT_RADIX_SIZE - 1)]++;
+                            dstK[o] = srcK[i];
+                            dstV[o] = srcV[i];
+                        }
+                    }
+                });
+
+                std::swap(srcK, dstK);
+                std::swap(srcV, dstV);
+            }
+
+            // an odd number of scatters leaves the result in the temporaries
+            if (srcK != &keys[0]) {
+                memcpy(&keys[0], srcK, count * sizeof(uint32_t));
+                memcpy(&values[0], srcV, count * sizeof(uint32_t));
+            }
+        }
+};
+
+#endif
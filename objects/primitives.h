@@ -0,0 +1,80 @@
+/**
+ * @file primitives.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Procedural meshes (boxes and ground planes) for scene geometry that does not need a model file
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef PRIMITIVES_H
+#define PRIMITIVES_H
+
+#include "helper.h"
+
+/**
+ * @brief Builds an axis-aligned box centered on the origin, with flat normals and per-face texture coordinates
+ *
+ * @param halfExtents Half the size of the box along each axis
+ * @return Mesh* new mesh (caller owns it)
+ */
+inline Mesh* createBox(glm::vec3 halfExtents) {
+    // outward normal, then the two axes spanning each face
+    static const glm::vec3 faces[6][3] = {
+        {glm::vec3( 1, 0, 0), glm::vec3(0, 0,-1), glm::vec3(0, 1, 0)},
+        {glm::vec3(-1, 0, 0), glm::vec3(0, 0, 1), glm::vec3(0, 1, 0)},
+        {glm::vec3( 0, 1, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0,-1)},
+        {glm::vec3( 0,-1, 0), glm::vec3(1, 0, 0), glm::vec3(0, 0, 1)},
+        {glm::vec3( 0, 0, 1), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0)},
+        {glm::vec3( 0, 0,-1), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0)}
+    };
+    static const glm::vec2 corners[4] = {glm::vec2(-1, -1), glm::vec2(1, -1), glm::vec2(1, 1), glm::vec2(-1, 1)};
+
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    for (int f = 0; f < 6; f++) {
+        unsigned int base = vertices.size();
+        for (int c = 0; c < 4; c++) {
+            Vertex v = {};
+            v.position = (faces[f][0] + faces[f][1] * corners[c].x + faces[f][2] * corners[c].y) * halfExtents;
+            v.normal = faces[f][0];
+            v.texCoords = corners[c] * 0.5f + 0.5f;
+            v.tangent = faces[f][1];
+            v.bitangent = faces[f][2];
+            vertices.push_back(v);
+        }
+        unsigned int quad[6] = {0, 1, 2, 0, 2, 3};
+        for (int i = 0; i < 6; i++)
+            indices.push_back(base + quad[i]);
+    }
+
+    return new Mesh(vertices, indices, vector<Texture>());
+}
+
+/**
+ * @brief Builds a square ground plane at y = 0 facing up
+ *
+ * @param halfSize Half the side length
+ * @param tiling Texture repeats across the plane. Defaults to 1
+ * @return Mesh* new mesh (caller owns it)
+ */
+inline Mesh* createPlane(float halfSize, float tiling = 1.0f) {
+    static const glm::vec2 corners[4] = {glm::vec2(-1, 1), glm::vec2(1, 1), glm::vec2(1, -1), glm::vec2(-1, -1)};
+
+    vector<Vertex> vertices;
+    for (int c = 0; c < 4; c++) {
+        Vertex v = {};
+        v.position = glm::vec3(corners[c].x, 0, corners[c].y) * halfSize;
+        v.normal = glm::vec3(0, 1, 0);
+        v.texCoords = (corners[c] * 0.5f + 0.5f) * tiling;
+        v.tangent = glm::vec3(1, 0, 0);
+        v.bitangent = glm::vec3(0, 0, -1);
+        vertices.push_back(v);
+    }
+    vector<unsigned int> indices = {0, 1, 2, 0, 2, 3};
+
+    return new Mesh(vertices, indices, vector<Texture>());
+}
+
+#endif
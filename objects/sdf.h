@@ -0,0 +1,318 @@
+/**
+ * @file sdf.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Signed distance field of static scene geometry, baked on the CPU when the scene is imported, that CPU particles collide against. Exact distances are computed in a narrow band around every triangle, then swept out to the rest of the grid
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef SDF_H
+#define SDF_H
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <cmath>
+#include <iostream>
+#include <vector>
+using std::vector;
+using std::cout;
+using std::endl;
+
+#include <glm/glm.hpp>
+
+#include "../util/jobs/jobs.h"
+#include "../util/timer.h"
+
+// Voxels around each triangle whose distance is computed exactly; the rest are swept
+#define SDF_BAND 2
+
+/**
+ * @brief A signed distance field over an axis-aligned box: negative inside closed geometry and below open surfaces (facing away from their normals). Usage: addMesh()/addModel() for the static geometry, then bake()
+ */
+class SignedDistanceField {
+    public:
+        glm::vec3 origin = glm::vec3(0.0f);     // corner of voxel (0, 0, 0); samples sit at voxel centers
+        float voxel = 0.1f;                     // side of a voxel, in world units
+        int nx = 0, ny = 0, nz = 0;
+        vector<float> distance;                 // x fastest, then y, then z
+        double lastMs = 0.0;                    // time of the last bake
+
+        /**
+         * @brief Adds the triangles of a mesh (anything with vertices[].position and indices, like Mesh)
+         *
+         * @param mesh Mesh to add
+         * @param transform Model matrix the mesh is drawn with
+         */
+        template <class MeshType>
+        void addMesh(const MeshType& mesh, const glm::mat4& transform) {
+            for (unsigned int i = 0; i + 2 < mesh.indices.size(); i += 3)
+                for (int c = 0; c < 3; c++)
+                    triangles.push_back(glm::vec3(transform * glm::vec4(mesh.vertices[mesh.indices[i + c]].position, 1.0f)));
+        }
+
+        /**
+         * @brief Adds every mesh of a model
+         *
+         * @param model Model to add
+         * @param transform Model matrix the model is drawn with
+         */
+        template <class ModelType>
+        void addModel(const ModelType& model, const glm::mat4& transform) {
+            for (unsigned int i = 0; i < model.meshes.size(); i++)
+                addMesh(model.meshes[i], transform);
+        }
+
+        /**
+         * @brief Bakes the field over the bounds of the added triangles. The triangle list is released afterwards
+         *
+         * @param voxelSize Side of a voxel, in world units
+         * @param padding Space kept around the geometry, in world units
+         * @param jobs Job system to run on
+         */
+        void bake(float voxelSize, float padding, JobSystem* jobs) {
+            Timer timer;
+            voxel = voxelSize;
+            if (triangles.empty()) {
+                nx = ny = nz = 0;
+                distance.clear();
+                return;
+            }
+
+            glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+            for (unsigned int i = 0; i < triangles.size(); i++) {
+                lo = glm::min(lo, triangles[i]);
+                hi = glm::max(hi, triangles[i]);
+            }
+            origin = lo - glm::vec3(padding);
+            glm::vec3 extent = hi - lo + glm::vec3(2.0f * padding);
+            nx = (int)ceilf(extent.x / voxel) + 1;
+            ny = (int)ceilf(extent.y / voxel) + 1;
+            nz = (int)ceilf(extent.z / voxel) + 1;
+
+            size_t voxels = (size_t)nx * ny * nz;
+            distance.assign(voxels, FLT_MAX);
+            nearest.assign(voxels, glm::vec3(0.0f));
+            inside.assign(voxels, 0);
+            align.assign(voxels, 0.0f);
+
+            // exact distances near the surface; slices are independent, so each is written by one job only
+            jobs->parallelFor(nz, 1, [this](size_t begin, size_t end) {
+                for (size_t z = begin; z < end; z++)
+                    bandSlice((int)z);
+            });
+
+            // carry the nearest surface point (and which side it is on) out from the band, in both raster orders, twice
+            for (int pass = 0; pass < 2; pass++) {
+                sweep(false);
+                sweep(true);
+            }
+
+            for (size_t i = 0; i < voxels; i++)
+                distance[i] = inside[i] ? -distance[i] : distance[i];
+
+            nearest.clear(); nearest.shrink_to_fit();
+            inside.clear(); inside.shrink_to_fit();
+            align.clear(); align.shrink_to_fit();
+            size_t count = triangles.size() / 3;
+            triangles.clear(); triangles.shrink_to_fit();
+
+            lastMs = timer.elapsedMs();
+            cout << "Baked SDF " << nx << "x" << ny << "x" << nz << " of " << count << " triangles in " << lastMs << " ms" << endl;
+        }
+
+        /**
+         * @brief Trilinear sample of the field, with the gradient of the same interpolant
+         *
+         * @param p Position in world units
+         * @param gradient Set to the (unnormalized) gradient; left alone outside the grid
+         * @return float Signed distance, or FLT_MAX outside the grid
+         */
+        float sample(glm::vec3 p, glm::vec3& gradient) const {
+            glm::vec3 g = (p - origin) / voxel - glm::vec3(0.5f);
+            if (g.x < 0.0f || g.y < 0.0f || g.z < 0.0f || g.x >= nx - 1 || g.y >= ny - 1 || g.z >= nz - 1)
+                return FLT_MAX;
+
+            int x = (int)g.x, y = (int)g.y, z = (int)g.z;
+            float tx = g.x - x, ty = g.y - y, tz = g.z - z;
+            const float* d = &distance[((size_t)z * ny + y) * nx + x];
+            size_t sy = nx, sz = (size_t)nx * ny;
+            float d000 = d[0], d100 = d[1], d010 = d[sy], d110 = d[sy + 1];
+            float d001 = d[sz], d101 = d[sz + 1], d011 = d[sz + sy], d111 = d[sz + sy + 1];
+
+            float x00 = d000 + (d100 - d000) * tx, x10 = d010 + (d110 - d010) * tx;
+            float x01 = d001 + (d101 - d001) * tx, x11 = d011 + (d111 - d011) * tx;
+            float y0 = x00 + (x10 - x00) * ty, y1 = x01 + (x11 - x01) * ty;
+
+            float dx0 = (d100 - d000) + ((d110 - d010) - (d100 - d000)) * ty;
+            float dx1 = (d101 - d001) + ((d111 - d011) - (d101 - d001)) * ty;
+            gradient.x = dx0 + (dx1 - dx0) * tz;
+            gradient.y = (x10 - x00) + ((x11 - x01) - (x10 - x00)) * tz;
+            gradient.z = y1 - y0;
+            return y0 + (y1 - y0) * tz;
+        }
+
+        /**
+         * @brief Pushes particles that came within radius of the geometry back out to the surface, and bounces their velocity off it, for structure-of-arrays particles
+         *
+         * @param px, py, pz Positions in world units
+         * @param vx, vy, vz Velocities
+         * @param count Number of particles
+         * @param radius Distance particles keep from the surface
+         * @param restitution Fraction of the normal speed kept on a bounce
+         * @param friction Fraction of the tangential speed lost on a bounce
+         */
+        void collide(float* px, float* py, float* pz, float* vx, float* vy, float* vz, size_t count, float radius, float restitution, float friction) const {
+            if (distance.empty())
+                return;
+            for (size_t i = 0; i < count; i++) {
+                glm::vec3 gradient;
+                float d = sample(glm::vec3(px[i], py[i], pz[i]), gradient);
+                if (d >= radius)
+                    continue;
+                float length = glm::length(gradient);
+                if (length < 1e-6f)
+                    continue;
+                glm::vec3 n = gradient / length;
+
+                px[i] += n.x * (radius - d);
+                py[i] += n.y * (radius - d);
+                pz[i] += n.z * (radius - d);
+
+                glm::vec3 v(vx[i], vy[i], vz[i]);
+                float vn = glm::dot(v, n);
+                if (vn >= 0.0f)
+                    continue;
+                glm::vec3 tangent = v - vn * n;
+                v = tangent * (1.0f - friction) - n * (vn * restitution);
+                vx[i] = v.x; vy[i] = v.y; vz[i] = v.z;
+            }
+        }
+
+    private:
+        vector<glm::vec3> triangles;    // three corners per triangle, in world units, until baked
+
+        // bake scratch
+        vector<glm::vec3> nearest;      // closest surface point found so far
+        vector<uint8_t> inside;         // side of the surface, from the triangle the point lies on
+        vector<float> align;            // |cos| between (p - nearest) and that triangle's normal, to break ties at shared edges
+
+        glm::vec3 center(int x, int y, int z) const {
+            return origin + (glm::vec3((float)x, (float)y, (float)z) + glm::vec3(0.5f)) * voxel;
+        }
+
+        // closest point on triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5)
+        static glm::vec3 closestOnTriangle(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+            glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+            float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+            if (d1 <= 0.0f && d2 <= 0.0f)
+                return a;
+            glm::vec3 bp = p - b;
+            float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+            if (d3 >= 0.0f && d4 <= d3)
+                return b;
+            float vc = d1 * d4 - d3 * d2;
+            if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+                return a + ab * (d1 / (d1 - d3));
+            glm::vec3 cp = p - c;
+            float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+            if (d6 >= 0.0f && d5 <= d6)
+                return c;
+            float vb = d5 * d2 - d1 * d6;
+            if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+                return a + ac * (d2 / (d2 - d6));
+            float va = d3 * d6 - d5 * d4;
+            if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+                return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+            float denom = 1.0f / (va + vb + vc);
+            return a + ab * (vb * denom) + ac * (vc * denom);
+        }
+
+        /**
+         * @brief Exact distance from every voxel of slice z to the triangles within SDF_BAND voxels of it
+         */
+        void bandSlice(int z) {
+            float band = SDF_BAND * voxel;
+            float zc = center(0, 0, z).z;
+            for (size_t t = 0; t < triangles.size(); t += 3) {
+                glm::vec3 a = triangles[t], b = triangles[t + 1], c = triangles[t + 2];
+                glm::vec3 lo = glm::min(a, glm::min(b, c)) - glm::vec3(band), hi = glm::max(a, glm::max(b, c)) + glm::vec3(band);
+                if (zc < lo.z || zc > hi.z)
+                    continue;
+                glm::vec3 normal = glm::cross(b - a, c - a);
+                float area = glm::length(normal);
+                if (area < 1e-12f)
+                    continue;
+                normal /= area;
+
+                int x0 = std::max((int)((lo.x - origin.x) / voxel), 0), x1 = std::min((int)((hi.x - origin.x) / voxel), nx - 1);
+                int y0 = std::max((int)((lo.y - origin.y) / voxel), 0), y1 = std::min((int)((hi.y - origin.y) / voxel), ny - 1);
+                for (int y = y0; y <= y1; y++) {
+                    for (int x = x0; x <= x1; x++) {
+                        size_t i = ((size_t)z * ny + y) * nx + x;
+                        glm::vec3 p = center(x, y, z);
+                        glm::vec3 q = closestOnTriangle(p, a, b, c);
+                        glm::vec3 offset = p - q;
+                        float d = glm::length(offset);
+                        float cosine = d > 0.0f ? fabsf(glm::dot(offset, normal)) / d : 1.0f;
+                        // at an edge or corner several triangles are equally close; the one p lies most squarely over decides the side
+                        bool closer = d < distance[i] - 1e-5f * voxel;
+                        bool tie = !closer && d <= distance[i] + 1e-5f * voxel && cosine > align[i];
+                        if (closer || tie) {
+                            distance[i] = d;
+                            nearest[i] = q;
+                            align[i] = cosine;
+                            inside[i] = glm::dot(offset, normal) < 0.0f;
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief One raster pass that lets each voxel adopt the nearest point of its already-visited neighbors. Voxels within the band are already exact and keep their side; beyond it a voxel and its neighbor cannot straddle the surface, so the side is carried with the point
+         *
+         * @param backward Visit from the last voxel to the first
+         */
+        void sweep(bool backward) {
+            int step = backward ? -1 : 1;
+            int zs = backward ? nz - 1 : 0, ys = backward ? ny - 1 : 0, xs = backward ? nx - 1 : 0;
+            size_t sy = nx, sz = (size_t)nx * ny;
+            float band = SDF_BAND * voxel;
+            for (int z = zs; z >= 0 && z < nz; z += step) {
+                for (int y = ys; y >= 0 && y < ny; y += step) {
+                    for (int x = xs; x >= 0 && x < nx; x += step) {
+                        size_t i = ((size_t)z * ny + y) * nx + x;
+                        if (distance[i] <= band)
+                            continue;
+                        glm::vec3 p = center(x, y, z);
+                        // the 13 neighbors that come before this voxel in the pass order
+                        for (int dz = -1; dz <= 0; dz++) {
+                            for (int dy = -1; dy <= 1; dy++) {
+                                for (int dx = -1; dx <= 1; dx++) {
+                                    if (dz == 0 && (dy > 0 || (dy == 0 && dx >= 0)))
+                                        continue;
+                                    int qx = x + dx * step, qy = y + dy * step, qz = z + dz * step;
+                                    if (qx < 0 || qy < 0 || qz < 0 || qx >= nx || qy >= ny || qz >= nz)
+                                        continue;
+                                    size_t j = i + (ptrdiff_t)(dz * step) * sz + (ptrdiff_t)(dy * step) * sy + dx * step;
+                                    if (distance[j] == FLT_MAX)
+                                        continue;
+                                    float d = glm::length(p - nearest[j]);
+                                    if (d < distance[i]) {
+                                        distance[i] = d;
+                                        nearest[i] = nearest[j];
+                                        inside[i] = inside[j];
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+};
+
+#endif
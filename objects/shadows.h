@@ -0,0 +1,288 @@
+/**
+ * @file shadows.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Omnidirectional shadows for point lights. Each shadowed light owns a tile of a shared atlas holding its six cube faces, sized by how large the light is on screen. Static geometry is rendered into a cache only when a light moves or changes tile, and dynamic casters are composited over a copy of the cache each frame they are near
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include <algorithm>
+#include <functional>
+
+#include "helper.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "lights.h"
+
+// Atlas width and height in texels
+#define SHADOW_ATLAS_SIZE 4096
+
+// SSBO binding of the tile table and texture unit of the atlas (see shaders/lights.glsl)
+#define SHADOW_BINDING 8
+#define SHADOW_ATLAS_UNIT 4
+
+// Static cache renders per frame, so a burst of invalidated lights is spread over several frames
+#define SHADOW_REFRESH_BUDGET 8
+
+// Frames a light's tile class must stay wanted before its tile is reallocated, so a light on a class boundary does not re-render every frame
+#define SHADOW_RECLASS_FRAMES 8
+
+// Tile classes by cube face size, and atlas rows given to each (the last class takes what is left)
+#define SHADOW_CLASSES 4
+static const int shadowFaceSizes[SHADOW_CLASSES] = {256, 128, 64, 32};
+static const int shadowClassRows[SHADOW_CLASSES] = {2, 2, 4, 0};
+
+/* ----- SHADOW TILE ----- *\
+Faces are laid out 3 x 2 in a tile of 3s x 2s texels, face f at column f % 3, row f / 3, in the
+order +X -X +Y -Y +Z -Z. Depth is the distance to the light over its radius.
+Tile table (binding 8)  vec4 per tile: atlas uv origin (xy), face size in uv (z), texel size in uv (w)
+\* ----------------------- */
+
+/**
+ * @brief Shadow state of one light
+ */
+struct ShadowCaster {
+    PntLight* light;
+    int cls = -1;                   // tile class, or -1 without a tile
+    int tile = -1;
+    bool cached = false;            // whether the static cache of its tile is current
+    glm::vec3 cachedPosition;       // where the light was when its cache was rendered
+    bool dynamicLast = false;       // whether dynamic casters were composited into its tile last frame
+    int reclassFrames = 0;          // consecutive frames it has wanted a different class than its tile's
+};
+
+/**
+ * @brief Shadow atlas and its caches. Per frame, before the lights are flushed: update(), then bind() for every pass that shades with lights
+ */
+class ShadowAtlas {
+    public:
+        // work done by the last update
+        unsigned int staticRenders = 0;
+        unsigned int dynamicRenders = 0;
+
+        ShadowAtlas() {
+            depthShader = new Shader("shaders/shadow_depth.vert", "shaders/shadow_depth.frag");
+
+            // static cache and the atlas that is sampled, which is the cache plus dynamic casters
+            cacheTarget = new RenderTarget(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, {}, GL_DEPTH_COMPONENT16);
+            atlasTarget = new RenderTarget(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, {}, GL_DEPTH_COMPONENT16);
+            glBindTexture(GL_TEXTURE_2D, atlasTarget->depth);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            // fixed tile layout: rows of equal tiles per class, largest first
+            vector<glm::vec4> table;
+            int y = 0;
+            for (int c = 0; c < SHADOW_CLASSES; c++) {
+                int s = shadowFaceSizes[c];
+                for (int r = 0; shadowClassRows[c] == 0 ? y + 2 * s <= SHADOW_ATLAS_SIZE : r < shadowClassRows[c]; r++, y += 2 * s) {
+                    for (int x = 0; x + 3 * s <= SHADOW_ATLAS_SIZE; x += 3 * s) {
+                        free[c].push_back(tiles.size());
+                        tiles.push_back(glm::ivec3(x, y, s));
+                        table.push_back(glm::vec4(x, y, s, 1) / (float)SHADOW_ATLAS_SIZE);
+                    }
+                }
+            }
+            // hand out the lowest tiles first
+            for (int c = 0; c < SHADOW_CLASSES; c++)
+                std::reverse(free[c].begin(), free[c].end());
+
+            glGenBuffers(1, &tileBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, table.size() * sizeof(glm::vec4), &table[0], GL_STATIC_DRAW);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        }
+
+        ~ShadowAtlas() {
+            glDeleteBuffers(1, &tileBuffer);
+            delete cacheTarget;
+            delete atlasTarget;
+            delete depthShader;
+        }
+
+        // gives a light a shadow; it stays unshadowed until its first cache render
+        void addLight(PntLight* light) {
+            ShadowCaster caster;
+            caster.light = light;
+            casters.push_back(caster);
+        }
+
+        /**
+         * @brief Assigns tiles by screen importance and brings the atlas up to date. Writes the shadow index of every light whose tile changed, so it must run before the lights are flushed. Leaves the scene framebuffer bound
+         *
+         * @param camera Camera the frame is drawn from
+         * @param rx Width of the scene in pixels
+         * @param ry Height of the scene in pixels
+         * @param lights Buffer holding the lights
+         * @param drawStatic Draws static geometry with the given shader (setting its "model" uniform)
+         * @param drawDynamic Draws dynamic casters with the given shader
+         * @param dynamicBounds Bounding spheres (center, radius) of the dynamic casters
+         */
+        void update(Camera* camera, int rx, int ry, LightBuffer* lights, const std::function<void(Shader*)>& drawStatic, const std::function<void(Shader*)>& drawDynamic, const vector<glm::vec4>& dynamicBounds) {
+            staticRenders = 0;
+            dynamicRenders = 0;
+
+            for (unsigned int i = 0; i < casters.size(); i++) {
+                ShadowCaster& c = casters[i];
+                int wanted = importanceClass(c.light, camera, ry);
+                if (wanted == c.cls || (c.cls > wanted && free[wanted].empty() && c.tile >= 0))
+                    c.reclassFrames = 0;
+                else if (c.tile < 0 || ++c.reclassFrames >= SHADOW_RECLASS_FRAMES) {
+                    release(c);
+                    acquire(c, wanted);
+                    c.reclassFrames = 0;
+                }
+                if (c.cached && c.cachedPosition != c.light->position)
+                    c.cached = false;
+                if (!c.cached && c.light->shadow >= 0) {
+                    c.light->shadow = -1;
+                    lights->write(c.light);
+                }
+            }
+
+            glEnable(GL_DEPTH_TEST);
+            glDepthMask(GL_TRUE);
+            glEnable(GL_SCISSOR_TEST);
+            depthShader->use();
+
+            for (unsigned int i = 0; i < casters.size() && staticRenders < SHADOW_REFRESH_BUDGET; i++) {
+                ShadowCaster& c = casters[i];
+                if (c.cached || c.tile < 0)
+                    continue;
+
+                renderTile(c, cacheTarget, true, drawStatic);
+                copyTile(c.tile);
+                c.cached = true;
+                c.cachedPosition = c.light->position;
+                c.dynamicLast = false;
+                c.light->shadow = c.tile;
+                lights->write(c.light);
+                staticRenders++;
+            }
+
+            // dynamic casters go over a fresh copy of the cache, which also erases where they were last frame
+            for (unsigned int i = 0; i < casters.size(); i++) {
+                ShadowCaster& c = casters[i];
+                if (!c.cached)
+                    continue;
+                bool near = false;
+                for (unsigned int b = 0; b < dynamicBounds.size() && !near; b++)
+                    near = glm::length(glm::vec3(dynamicBounds[b]) - c.light->position) < dynamicBounds[b].w + c.light->radius;
+                if (!near && !c.dynamicLast)
+                    continue;
+
+                copyTile(c.tile);
+                if (near) {
+                    renderTile(c, atlasTarget, false, drawDynamic);
+                    dynamicRenders++;
+                }
+                c.dynamicLast = near;
+            }
+
+            glDisable(GL_SCISSOR_TEST);
+            RenderTarget::bindScene(rx, ry);
+        }
+
+        // binds the atlas and tile table for shading
+        void bind() {
+            glActiveTexture(GL_TEXTURE0 + SHADOW_ATLAS_UNIT);
+            glBindTexture(GL_TEXTURE_2D, atlasTarget->depth);
+            glActiveTexture(GL_TEXTURE0);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SHADOW_BINDING, tileBuffer);
+        }
+
+        // lights with a current shadow
+        unsigned int getShadowedCount() {
+            unsigned int n = 0;
+            for (unsigned int i = 0; i < casters.size(); i++)
+                n += casters[i].cached;
+            return n;
+        }
+
+    private:
+        Shader* depthShader;
+        RenderTarget* cacheTarget;
+        RenderTarget* atlasTarget;
+        GLuint tileBuffer;
+        vector<glm::ivec3> tiles;           // atlas texel origin and face size
+        vector<int> free[SHADOW_CLASSES];   // unused tiles of each class
+        vector<ShadowCaster> casters;
+
+        /**
+         * @brief Tile class of a light, from the size of its sphere of influence on screen
+         */
+        int importanceClass(PntLight* light, Camera* camera, int ry) {
+            glm::vec3 d = light->position - camera->position;
+            float dist = glm::length(d);
+            // behind the camera its shadows can only be seen at the edges
+            if (glm::dot(d, camera->front) < -light->radius)
+                return SHADOW_CLASSES - 1;
+            if (dist <= light->radius)
+                return 0;
+
+            float pixels = light->radius / dist * ry / tanf(glm::radians(camera->zoom) * 0.5f);
+            for (int c = 0; c < SHADOW_CLASSES - 1; c++)
+                if (pixels >= shadowFaceSizes[c])
+                    return c;
+            return SHADOW_CLASSES - 1;
+        }
+
+        // takes a free tile of the wanted class, or of the largest smaller class with one left
+        void acquire(ShadowCaster& c, int wanted) {
+            for (int cls = wanted; cls < SHADOW_CLASSES; cls++) {
+                if (!free[cls].empty()) {
+                    c.cls = cls;
+                    c.tile = free[cls].back();
+                    free[cls].pop_back();
+                    return;
+                }
+            }
+        }
+
+        void release(ShadowCaster& c) {
+            if (c.tile >= 0)
+                free[c.cls].push_back(c.tile);
+            c.cls = -1;
+            c.tile = -1;
+            c.cached = false;
+        }
+
+        // copies a tile of the static cache into the atlas
+        void copyTile(int tile) {
+            glm::ivec3 t = tiles[tile];
+            glCopyImageSubData(cacheTarget->depth, GL_TEXTURE_2D, 0, t.x, t.y, 0, atlasTarget->depth, GL_TEXTURE_2D, 0, t.x, t.y, 0, 3 * t.z, 2 * t.z, 1);
+        }
+
+        /**
+         * @brief Draws casters into the six faces of a light's tile
+         *
+         * @param clear Whether to clear the faces first
+         */
+        void renderTile(ShadowCaster& c, RenderTarget* target, bool clear, const std::function<void(Shader*)>& draw) {
+            static const glm::vec3 forward[6] = {glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)};
+            static const glm::vec3 up[6] = {glm::vec3(0, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1), glm::vec3(0, -1, 0), glm::vec3(0, -1, 0)};
+
+            glm::ivec3 t = tiles[c.tile];
+            glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+            depthShader->setVec3("lightPosition", c.light->position);
+            depthShader->setFloat("lightRadius", c.light->radius);
+            glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.02f, c.light->radius);
+            for (int f = 0; f < 6; f++) {
+                int x = t.x + (f % 3) * t.z, y = t.y + (f / 3) * t.z;
+                glViewport(x, y, t.z, t.z);
+                glScissor(x, y, t.z, t.z);
+                if (clear)
+                    glClear(GL_DEPTH_BUFFER_BIT);
+                depthShader->setMat4("lightViewProjection", projection * glm::lookAt(c.light->position, c.light->position + forward[f], up[f]));
+                draw(depthShader);
+            }
+        }
+};
+
+#endif
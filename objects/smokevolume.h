@@ -0,0 +1,110 @@
+/**
+ * @file smokevolume.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Draws the CPU smoke solver (see fluid.h): its density is uploaded to a 3D texture each step and raymarched through its box in one fullscreen pass, lit by the fire with a short shadow march, and stopped at opaque geometry
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef SMOKEVOLUME_H
+#define SMOKEVOLUME_H
+
+#include "helper.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "fluid.h"
+
+/**
+ * @brief Density texture and raymarch pass for a SmokeFluid. Usage: upload() after each solver step, draw() into the scene after its depth is resolved
+ */
+class SmokeVolume {
+    public:
+        glm::vec3 boxMin, boxMax;       // world-space box the grid fills
+        float extinction = 12.0f;       // per world unit, at density 1
+        float albedo = 0.8f;
+        int steps = 64;                 // samples along the view ray through the box
+        int shadowSteps = 6;            // samples toward the light
+
+        /**
+         * @brief Construct a new SmokeVolume object
+         *
+         * @param size Cells per side of the solver's grid
+         * @param boxMin World-space corner of the grid
+         * @param boxMax Opposite corner
+         */
+        SmokeVolume(int size, glm::vec3 boxMin, glm::vec3 boxMax) : boxMin(boxMin), boxMax(boxMax), size(size) {
+            shader = new Shader("shaders/fullscreen.vert", "shaders/smoke_raymarch.frag");
+            staging.assign((size_t)size * size * size, 0.0f);
+            texture = createTexture3D(size, GL_R16F, GL_RED, GL_FLOAT, &staging[0], GL_CLAMP_TO_EDGE);
+        }
+
+        ~SmokeVolume() {
+            delete shader;
+            glDeleteTextures(1, &texture);
+        }
+
+        // copies the solver's current density into the texture
+        void upload(const SmokeFluid* fluid) {
+            fluid->copyDensity(&staging[0]);
+            glBindTexture(GL_TEXTURE_3D, texture);
+            glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, size, size, size, GL_RED, GL_FLOAT, &staging[0]);
+            glBindTexture(GL_TEXTURE_3D, 0);
+        }
+
+        /**
+         * @brief Blends the smoke over the bound scene framebuffer (premultiplied alpha)
+         *
+         * @param camera Camera the scene is drawn from
+         * @param aspect Width over height of the viewport
+         * @param depthTexture Window depth of the opaque scene
+         * @param light Light the smoke is lit by (the fire)
+         * @param lightScale Multiplier of the light's color, as the scene applies it
+         * @param ambient Light from everywhere else
+         */
+        void draw(Camera* camera, float aspect, unsigned int depthTexture, const PntLight* light, glm::vec3 lightScale, glm::vec3 ambient) {
+            glm::mat4 viewProjection = camera->getProjectionMatrix(aspect) * camera->getViewMatrix();
+
+            shader->use();
+            shader->setInt("densityTexture", 0);
+            shader->setInt("sceneDepth", 1);
+            shader->setMat4("inverseViewProjection", glm::inverse(viewProjection));
+            shader->setVec3("eye", camera->position);
+            shader->setVec3("boxMin", boxMin);
+            shader->setVec3("boxMax", boxMax);
+            shader->setFloat("extinction", extinction);
+            shader->setFloat("albedo", albedo);
+            shader->setInt("steps", steps);
+            shader->setInt("shadowSteps", shadowSteps);
+            shader->setVec3("lightPosition", light->position);
+            shader->setVec3("lightColor", light->color * light->intensity * lightScale);
+            shader->setFloat("lightRadius", light->radius);
+            shader->setVec3("ambient", ambient);
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_3D, texture);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, depthTexture);
+
+            glDisable(GL_DEPTH_TEST);
+            glDepthMask(GL_FALSE);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+            drawFullscreenTriangle();
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+            glEnable(GL_DEPTH_TEST);
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_3D, 0);
+        }
+
+    private:
+        int size;
+        Shader* shader;
+        unsigned int texture;
+        vector<float> staging;      // density without ghost cells, reused every upload
+};
+
+#endif
@@ -0,0 +1,288 @@
+/**
+ * @file volumefire.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Raymarched volumetric fire, as an alternative to the fire sprites. A teardrop flame displaced by the shared curl-noise field (see noise.h) is marched through the emitter's bounds with adaptive steps, skipping the empty cells of a coarse occupancy grid and stopping once opaque; temperature is colored through a blackbody table, and the march runs at reduced resolution through a LowResParticlePass
+ * @version 0.1
+ * @date 2022-08-06
+ *
+ * @copyright Copyright (c) 2022
+ */
+
+#ifndef VOLUMEFIRE_H
+#define VOLUMEFIRE_H
+
+#include <cmath>
+#include <vector>
+using std::vector;
+
+#include "helper.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "depth.h"
+#include "lowres.h"
+#include "noise.h"
+#include "particles.h"
+
+// Texels in the blackbody table, from minKelvin to maxKelvin
+#define VOLUMEFIRE_LUT_SIZE 256
+// Occupancy cells per side of the emitter's bounds
+#define VOLUMEFIRE_OCCUPANCY 16
+
+/**
+ * @brief Flame shape, blackbody table, occupancy grid and raymarch pass. Usage: construct from the fire's emitter once the GL context exists, then draw() into the scene after its depth is resolved, in place of the fire sprites
+ */
+class VolumetricFire {
+    public:
+        glm::vec3 boxMin, boxMax;           // emitter's bounds, where rays are marched
+        glm::vec3 base;                     // center of the flame's base
+        float radius;                       // of the flame at its base
+        float height;                       // base to tip
+        float displacement = 0.15f;         // world units the flame is pushed by the noise, per unit of curl
+        float noiseScale;                   // noise tiles per world unit
+        float rise = 0.8f;                  // noise tiles per second the flame scrolls up through
+        float extinction = 8.0f;            // per world unit, at density 1
+        float intensity = 3.0f;             // multiplier of the blackbody color
+        float minKelvin = 800.0f;           // temperature at the edge of the flame
+        float maxKelvin = 2200.0f;          // temperature at its core
+        float luminancePower = 0.35f;       // compresses the blackbody's brightness range, which spans orders of magnitude over the table
+        float minStep = 0.02f;              // world units between samples in dense flame
+        float maxStep = 0.08f;              // and where it is thin
+        float stepGrowth = 0.1f;            // fraction the step grows by per world unit from the camera
+        int maxSteps = 160;                 // per ray, skipped cells included
+        float opaqueThreshold = 0.99f;      // rays stop at this opacity
+
+        LowResParticlePass* pass;           // reduced-resolution target, upsampling and edge fix-up; factor 1 marches at full resolution
+        float occupancy = 0.0f;             // fraction of occupancy cells the flame can reach
+
+        /**
+         * @brief Construct a new VolumetricFire object, fitting the flame to an emitter
+         *
+         * @param rx Width of the scene in pixels
+         * @param ry Height of the scene in pixels
+         * @param desc Fire emitter the flame stands in for
+         * @param noise Noise field, for the largest displacement it can cause
+         * @param noiseTexture The same field as a 3D texture (curl in rgb, noise in a)
+         */
+        VolumetricFire(int rx, int ry, const EmitterDesc& desc, const NoiseField* noise, unsigned int noiseTexture) : noiseTexture(noiseTexture) {
+            shader = new Shader("shaders/fullscreen.vert", "shaders/fire_raymarch.frag");
+            pass = new LowResParticlePass(rx, ry);
+            pass->setFactor(2);
+
+            glm::vec3 center;
+            float reach;
+            emitterBounds(desc, center, reach);
+            boxMin = center - glm::vec3(reach);
+            boxMax = center + glm::vec3(reach);
+
+            // the flame is as wide as the spawn sphere plus a sprite, and as tall as a particle rises over a mean lifetime
+            base = desc.position;
+            radius = desc.radius + 0.5f * desc.sizeStart;
+            height = riseHeight(desc, 0.5f * (desc.lifeMin + desc.lifeMax)) + 0.5f * desc.sizeEnd;
+            noiseScale = desc.turbulenceScale;
+
+            maxCurl = 0.0f;
+            for (size_t i = 0; i < noise->curlX.size(); i++) {
+                float c = noise->curlX[i] * noise->curlX[i] + noise->curlY[i] * noise->curlY[i] + noise->curlZ[i] * noise->curlZ[i];
+                maxCurl = fmaxf(maxCurl, c);
+            }
+            maxCurl = sqrtf(maxCurl);
+
+            lut = 0;
+            occupancyTexture = 0;
+            buildBlackbody();
+            buildOccupancy();
+        }
+
+        ~VolumetricFire() {
+            delete shader;
+            delete pass;
+            glDeleteTextures(1, &lut);
+            glDeleteTextures(1, &occupancyTexture);
+        }
+
+        /**
+         * @brief Fills the blackbody table: Planck's law integrated against the CIE 1931 observer (the multi-lobe Gaussian fit of Wyman, Sloan and Shirley) at each temperature, converted to linear sRGB. Luminance is relative to maxKelvin and compressed by luminancePower. Call again after changing the temperature range
+         */
+        void buildBlackbody() {
+            vector<float> texels(VOLUMEFIRE_LUT_SIZE * 3);
+            double peak[3], xyz[3];
+            blackbodyXYZ(maxKelvin, peak);
+            for (int i = 0; i < VOLUMEFIRE_LUT_SIZE; i++) {
+                blackbodyXYZ(minKelvin + (maxKelvin - minKelvin) * i / (VOLUMEFIRE_LUT_SIZE - 1), xyz);
+                double x = xyz[0] / peak[1], y = xyz[1] / peak[1], z = xyz[2] / peak[1];
+                double rgb[3] = {3.2406 * x - 1.5372 * y - 0.4986 * z,
+                                -0.9689 * x + 1.8758 * y + 0.0415 * z,
+                                 0.0557 * x - 0.2040 * y + 1.0570 * z};
+                // rgb has luminance y; rescale it to the compressed luminance
+                double scale = y > 0.0 ? pow(y, luminancePower - 1.0) : 0.0;
+                for (int c = 0; c < 3; c++)
+                    texels[i * 3 + c] = (float)(fmax(rgb[c], 0.0) * scale);
+            }
+
+            if (lut == 0) {
+                glGenTextures(1, &lut);
+                glBindTexture(GL_TEXTURE_1D, lut);
+                glTexStorage1D(GL_TEXTURE_1D, 1, GL_RGB16F, VOLUMEFIRE_LUT_SIZE);
+                glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            }
+            glBindTexture(GL_TEXTURE_1D, lut);
+            glTexSubImage1D(GL_TEXTURE_1D, 0, 0, VOLUMEFIRE_LUT_SIZE, GL_RGB, GL_FLOAT, &texels[0]);
+            glBindTexture(GL_TEXTURE_1D, 0);
+        }
+
+        /**
+         * @brief Marks the cells of the bounds the displaced flame can reach. Each cell is grown by the largest displacement and tested against the undisplaced teardrop (see fire_raymarch.frag), so no visible flame is ever skipped. Call again after changing the shape
+         */
+        void buildOccupancy() {
+            const int n = VOLUMEFIRE_OCCUPANCY;
+            vector<unsigned char> cells((size_t)n * n * n);
+            glm::vec3 cell = (boxMax - boxMin) / (float)n;
+            float grow = displacement * maxCurl;
+            unsigned int occupied = 0;
+            for (int z = 0; z < n; z++)
+                for (int y = 0; y < n; y++)
+                    for (int x = 0; x < n; x++) {
+                        glm::vec3 lo = boxMin + cell * glm::vec3(x, y, z) - glm::vec3(grow) - base;
+                        glm::vec3 hi = lo + cell + glm::vec3(2.0f * grow);
+
+                        // the teardrop spans heights -0.1 to 1 of the flame, and is widest at its lowest point
+                        float h = fmaxf(lo.y / height, FIRE_BASE_FADE);
+                        float dx = fmaxf(fmaxf(lo.x, -hi.x), 0.0f), dz = fmaxf(fmaxf(lo.z, -hi.z), 0.0f);
+                        bool inside = hi.y > FIRE_BASE_FADE * height && h < 1.0f && dx * dx + dz * dz < radius * radius * (1.0f - h);
+
+                        cells[((size_t)z * n + y) * n + x] = inside ? 255 : 0;
+                        occupied += inside;
+                    }
+            occupancy = (float)occupied / cells.size();
+
+            if (occupancyTexture == 0)
+                occupancyTexture = createTexture3D(n, GL_R8, GL_RED, GL_UNSIGNED_BYTE, NULL, GL_CLAMP_TO_EDGE);
+            glBindTexture(GL_TEXTURE_3D, occupancyTexture);
+            glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, n, n, n, GL_RED, GL_UNSIGNED_BYTE, &cells[0]);
+            glBindTexture(GL_TEXTURE_3D, 0);
+        }
+
+        /**
+         * @brief Blends the flame over the bound scene framebuffer (premultiplied alpha), through the reduced-resolution pass when its factor is above 1
+         *
+         * @param camera Camera the scene is drawn from
+         * @param aspect Width over height of the viewport
+         * @param depth Scene depth, resolved this frame
+         * @param time Seconds since start, to scroll the noise by
+         */
+        void draw(Camera* camera, float aspect, SceneDepth* depth, float time) {
+            if (pass->factor == 1) {
+                march(camera, aspect, depth, time);
+                return;
+            }
+
+            pass->begin(depth, camera);
+            pass->bindLowRes();
+            march(camera, aspect, depth, time);
+            pass->beginFixup();
+            march(camera, aspect, depth, time);
+            pass->endFixup();
+            pass->composite(depth, camera);
+        }
+
+    private:
+        // lowest height of the teardrop, as a fraction of the flame's height; it fades in between there and the base
+        static constexpr float FIRE_BASE_FADE = -0.1f;
+
+        Shader* shader;
+        unsigned int noiseTexture;
+        unsigned int lut;                   // RGB16F blackbody color, minKelvin to maxKelvin
+        unsigned int occupancyTexture;      // R8, nonzero where the flame can reach
+        float maxCurl;                      // largest curl magnitude in the noise field
+
+        /**
+         * @brief Height a particle rises over a time, under the emitter's acceleration and drag
+         */
+        static float riseHeight(const EmitterDesc& desc, float t) {
+            float v0 = desc.velocity.y, a = desc.acceleration.y, k = desc.drag;
+            if (k <= 0.0f)
+                return v0 * t + 0.5f * a * t * t;
+            // dv/dt = a - k v, whose velocity relaxes from v0 to a / k
+            return a / k * t + (v0 - a / k) * (1.0f - expf(-k * t)) / k;
+        }
+
+        // CIE 1931 color matching lobe: a Gaussian with different widths either side of its peak
+        static double lobe(double x, double mu, double below, double above) {
+            double s = (x - mu) / (x < mu ? below : above);
+            return exp(-0.5 * s * s);
+        }
+
+        // XYZ of a blackbody at a temperature, in arbitrary but consistent units
+        static void blackbodyXYZ(double kelvin, double xyz[3]) {
+            xyz[0] = xyz[1] = xyz[2] = 0.0;
+            for (double nm = 380.0; nm <= 780.0; nm += 5.0) {
+                double m = nm * 1e-9;
+                double radiance = 1.0 / (m * m * m * m * m * (exp(1.4388e-2 / (m * kelvin)) - 1.0));
+                double x = 1.056 * lobe(nm, 599.8, 37.9, 31.0) + 0.362 * lobe(nm, 442.0, 16.0, 26.7) - 0.065 * lobe(nm, 501.1, 20.4, 26.2);
+                double y = 0.821 * lobe(nm, 568.8, 46.9, 40.5) + 0.286 * lobe(nm, 530.9, 16.3, 31.1);
+                double z = 1.217 * lobe(nm, 437.0, 11.8, 36.0) + 0.681 * lobe(nm, 459.0, 26.0, 13.8);
+                xyz[0] += radiance * x;
+                xyz[1] += radiance * y;
+                xyz[2] += radiance * z;
+            }
+        }
+
+        // one raymarch pass into whatever framebuffer is bound
+        void march(Camera* camera, float aspect, SceneDepth* depth, float time) {
+            glm::mat4 viewProjection = camera->getProjectionMatrix(aspect) * camera->getViewMatrix();
+
+            shader->use();
+            shader->setInt("blackbody", 0);
+            shader->setInt("sceneDepth", 1);
+            shader->setInt("occupancy", 2);
+            shader->setInt("noiseTexture", 3);
+            shader->setMat4("inverseViewProjection", glm::inverse(viewProjection));
+            shader->setVec3("eye", camera->position);
+            shader->setVec3("boxMin", boxMin);
+            shader->setVec3("boxMax", boxMax);
+            shader->setVec3("base", base);
+            shader->setFloat("radius", radius);
+            shader->setFloat("height", height);
+            shader->setFloat("baseFade", FIRE_BASE_FADE);
+            shader->setFloat("displacement", displacement);
+            shader->setFloat("noiseScale", noiseScale);
+            shader->setFloat("scroll", rise * time);
+            shader->setFloat("extinction", extinction);
+            shader->setFloat("intensity", intensity);
+            shader->setFloat("minStep", minStep);
+            shader->setFloat("maxStep", maxStep);
+            shader->setFloat("stepGrowth", stepGrowth);
+            shader->setInt("maxSteps", maxSteps);
+            shader->setFloat("opaqueThreshold", opaqueThreshold);
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_1D, lut);
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, depth->texture(DEPTH_FULL));
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_3D, occupancyTexture);
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_3D, noiseTexture);
+
+            // alpha keeps the transmittance convention of the low-resolution target
+            glDisable(GL_DEPTH_TEST);
+            glDepthMask(GL_FALSE);
+            glEnable(GL_BLEND);
+            glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+            drawFullscreenTriangle();
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+            glEnable(GL_DEPTH_TEST);
+
+            glActiveTexture(GL_TEXTURE3);
+            glBindTexture(GL_TEXTURE_3D, 0);
+            glActiveTexture(GL_TEXTURE2);
+            glBindTexture(GL_TEXTURE_3D, 0);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_1D, 0);
+        }
+};
+
+#endif
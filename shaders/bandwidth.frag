@@ -0,0 +1,8 @@
+#version 430 core
+// Constant additive color for the blend bandwidth test; blend ONE, ONE makes every fragment a read-modify-write of the target
+
+out vec4 fragColor;
+
+void main() {
+    fragColor = vec4(0.01, 0.02, 0.03, 0.0);
+}
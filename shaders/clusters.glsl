@@ -0,0 +1,18 @@
+// Froxel light clusters: screen tiles split into exponential depth slices, each listing the lights that can reach it
+// Included by shaders that light the scene; see objects/clusters.h
+
+layout(std430, binding = 5) readonly buffer ClusterRanges { uvec2 clusterRanges[]; };    // (first index, light count)
+layout(std430, binding = 6) readonly buffer ClusterIndices { uint clusterIndices[]; };
+
+uniform ivec3 clusterGrid;
+uniform float clusterNear;
+uniform float clusterFar;
+uniform vec2 viewportSize;
+
+// lights of the cluster containing a fragment
+uvec2 clusterRange(vec2 fragCoord, float viewDepth) {
+    ivec2 tile = ivec2(fragCoord / viewportSize * vec2(clusterGrid.xy));
+    int slice = int(log(viewDepth / clusterNear) / log(clusterFar / clusterNear) * float(clusterGrid.z));
+    ivec3 c = clamp(ivec3(tile, slice), ivec3(0), clusterGrid - 1);
+    return clusterRanges[(c.z * clusterGrid.y + c.y) * clusterGrid.x + c.x];
+}
@@ -0,0 +1,15 @@
+#version 430 core
+// Copies deferred lighting into the scene, leaving uncovered (sky) pixels alone
+
+in vec2 texCoords;
+
+uniform sampler2D lighting;
+
+out vec4 fragColor;
+
+void main() {
+    vec4 c = texture(lighting, texCoords);
+    if (c.a == 0.0)
+        discard;
+    fragColor = vec4(c.rgb, 1.0);
+}
@@ -0,0 +1,24 @@
+#version 430 core
+// Reduces scene depth to half resolution: the farthest of each 2x2 block, as linear view depth
+// (the farthest sample keeps particles from fading against the near side of a silhouette, which the full-resolution depth test already clips)
+
+uniform sampler2D depthTexture;
+uniform float nearPlane;
+uniform float farPlane;
+
+out float linearDepth;
+
+float linearize(float d) {
+    float z = d * 2.0 - 1.0;
+    return 2.0 * nearPlane * farPlane / (farPlane + nearPlane - z * (farPlane - nearPlane));
+}
+
+void main() {
+    ivec2 src = ivec2(gl_FragCoord.xy) * 2;
+    ivec2 last = textureSize(depthTexture, 0) - 1;
+    float d = texelFetch(depthTexture, min(src, last), 0).r;
+    d = max(d, texelFetch(depthTexture, min(src + ivec2(1, 0), last), 0).r);
+    d = max(d, texelFetch(depthTexture, min(src + ivec2(0, 1), last), 0).r);
+    d = max(d, texelFetch(depthTexture, min(src + ivec2(1, 1), last), 0).r);
+    linearDepth = linearize(d);
+}
@@ -0,0 +1,106 @@
+#version 430 core
+// Raymarches a noise-displaced teardrop flame through the fire emitter's bounds, stopping at opaque geometry
+// Empty occupancy cells are stepped over whole, steps lengthen where the flame is thin and far, and rays stop once opaque
+// Heat is colored through the blackbody table; output is premultiplied, with opacity in alpha
+
+in vec2 texCoords;
+
+uniform sampler1D blackbody;            // color from the edge's temperature (0) to the core's (1)
+uniform sampler2D sceneDepth;           // window depth of the opaque scene
+uniform sampler3D occupancy;            // nonzero in cells the flame can reach
+uniform sampler3D noiseTexture;         // curl in rgb, noise in a; tiles every unit
+uniform mat4 inverseViewProjection;
+uniform vec3 eye;
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+uniform vec3 base;                      // center of the flame's base
+uniform float radius;                   // of the flame at its base
+uniform float height;                   // base to tip
+uniform float baseFade;                 // height, as a fraction of the flame's, below which the flame is gone
+uniform float displacement;             // world units per unit of curl
+uniform float noiseScale;               // noise tiles per world unit
+uniform float scroll;                   // noise tiles the flame has risen through
+uniform float extinction;               // per world unit, at density 1
+uniform float intensity;
+uniform float minStep;
+uniform float maxStep;
+uniform float stepGrowth;
+uniform int maxSteps;
+uniform float opaqueThreshold;
+
+out vec4 fragColor;
+
+// flame density at p, and its heat in [0, 1]
+float flame(vec3 p, out float heat) {
+    vec4 n = texture(noiseTexture, p * noiseScale - vec3(0.0, scroll, 0.0));
+    vec3 q = p - base;
+    // the base is anchored to the fuel; tongues flick about more toward the tip
+    q += n.rgb * displacement * clamp(q.y / height + 0.2, 0.0, 1.0);
+
+    float h = q.y / height;
+    float envelope = radius * sqrt(clamp(1.0 - h, 0.0, 1.0)) * smoothstep(baseFade, 0.05, h);
+    float d = clamp(1.0 - length(q.xz) / max(envelope, 1e-4), 0.0, 1.0);
+    // hottest low in the core, cooling toward the edge and the tip
+    heat = d * (1.0 - 0.6 * clamp(h, 0.0, 1.0));
+    return d * d * clamp(0.75 + 0.5 * n.a, 0.0, 1.0);
+}
+
+// entry and exit distances of the ray through a box; entry > exit when it misses
+vec2 intersectBox(vec3 origin, vec3 dir, vec3 lo, vec3 hi) {
+    vec3 inv = 1.0 / dir;
+    vec3 t0 = (lo - origin) * inv, t1 = (hi - origin) * inv;
+    vec3 near = min(t0, t1), far = max(t0, t1);
+    return vec2(max(max(near.x, near.y), near.z), min(min(far.x, far.y), far.z));
+}
+
+void main() {
+    vec2 ndc = texCoords * 2.0 - 1.0;
+    vec4 far = inverseViewProjection * vec4(ndc, 1.0, 1.0);
+    vec3 dir = normalize(far.xyz / far.w - eye);
+
+    // the march ends at the box or at the scene, whichever is nearer
+    vec4 hit = inverseViewProjection * vec4(ndc, texture(sceneDepth, texCoords).r * 2.0 - 1.0, 1.0);
+    float sceneT = length(hit.xyz / hit.w - eye);
+    vec2 span = intersectBox(eye, dir, boxMin, boxMax);
+    span.x = max(span.x, 0.0);
+    span.y = min(span.y, sceneT);
+    if (span.y <= span.x)
+        discard;
+
+    ivec3 cells = textureSize(occupancy, 0);
+    vec3 cellSize = (boxMax - boxMin) / vec3(cells);
+
+    // per-pixel jitter of the first sample trades banding for noise
+    float jitter = fract(sin(dot(gl_FragCoord.xy, vec2(12.9898, 78.233))) * 43758.5453);
+    float t = span.x + jitter * minStep;
+    vec3 color = vec3(0.0);
+    float transmittance = 1.0;
+    for (int i = 0; i < maxSteps && t < span.y; i++) {
+        vec3 p = eye + dir * t;
+
+        // empty space: jump to where the ray leaves the cell
+        ivec3 cell = clamp(ivec3((p - boxMin) / cellSize), ivec3(0), cells - 1);
+        if (texelFetch(occupancy, cell, 0).r == 0.0) {
+            vec3 lo = boxMin + vec3(cell) * cellSize;
+            t = intersectBox(eye, dir, lo, lo + cellSize).y + 1e-4;
+            continue;
+        }
+
+        float heat;
+        float d = flame(p, heat);
+        // long strides through thin flame and far from the camera, short ones through its body
+        float dt = mix(maxStep, minStep, clamp(d * 4.0, 0.0, 1.0)) * (1.0 + t * stepGrowth);
+        dt = min(dt, span.y - t);
+
+        if (d > 1e-3) {
+            float a = 1.0 - exp(-d * extinction * dt);
+            color += transmittance * a * intensity * texture(blackbody, heat).rgb;
+            transmittance *= 1.0 - a;
+            if (transmittance < 1.0 - opaqueThreshold)
+                break;
+        }
+        t += dt;
+    }
+
+    fragColor = vec4(color, 1.0 - transmittance);
+}
@@ -0,0 +1,20 @@
+#version 430 core
+// Writes opaque scene geometry into the compact G-buffer (see objects/deferred.h): albedo and roughness in RGBA8, octahedral normal in RG16
+
+in vec3 fragPos;
+in vec3 normal;
+in vec2 texCoords;
+in float viewDepth;
+
+#include "octahedral.glsl"
+
+uniform vec3 albedo;
+uniform float roughness;
+
+layout(location = 0) out vec4 albedoRoughness;
+layout(location = 1) out vec2 encodedNormal;
+
+void main() {
+    albedoRoughness = vec4(albedo, roughness);
+    encodedNormal = octEncode(normalize(normal));
+}
@@ -0,0 +1,14 @@
+#version 430 core
+// Resamples a copy of the scene through the heat-haze distortion buffer
+
+in vec2 texCoords;
+
+uniform sampler2D sceneTexture;
+uniform sampler2D distortionTexture;
+
+out vec4 fragColor;
+
+void main() {
+    vec2 offset = texture(distortionTexture, texCoords).rg;
+    fragColor = texture(sceneTexture, texCoords + offset);
+}
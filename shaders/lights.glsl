@@ -0,0 +1,77 @@
+// Light SSBO (records as in the interpretation table in objects/helper.h) and evaluation of one light
+// Included by shaders that light the scene; see objects/lights.h
+
+layout(std430, binding = 4) readonly buffer Lights { float lightData[]; };
+
+#define LIGHT_FLOATS 10
+
+// point light shadows (see objects/shadows.h)
+layout(std430, binding = 8) readonly buffer ShadowTiles { vec4 shadowTiles[]; };    // atlas uv origin, face size in uv, texel size in uv
+layout(binding = 4) uniform sampler2DShadow shadowAtlas;
+
+const vec3 SHADOW_FORWARD[6] = vec3[](vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1));
+const vec3 SHADOW_UP[6] = vec3[](vec3(0, -1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1), vec3(0, -1, 0), vec3(0, -1, 0));
+
+// fraction of a point light reaching a point, from its cube faces in the shadow atlas
+float pointShadow(int tile, vec3 fromLight, float radius) {
+    if (tile < 0)
+        return 1.0;
+
+    vec3 a = abs(fromLight);
+    int face = a.x >= a.y && a.x >= a.z ? (fromLight.x > 0.0 ? 0 : 1) : a.y >= a.z ? (fromLight.y > 0.0 ? 2 : 3) : (fromLight.z > 0.0 ? 4 : 5);
+    vec3 f = SHADOW_FORWARD[face];
+    vec3 s = cross(f, SHADOW_UP[face]);
+    vec3 u = cross(s, f);
+    vec2 faceUv = 0.5 + 0.5 * vec2(dot(fromLight, s), dot(fromLight, u)) / dot(fromLight, f);
+
+    // keep the bilinear footprint inside the face
+    vec4 t = shadowTiles[tile];
+    float inset = t.w / t.z;
+    faceUv = clamp(faceUv, vec2(inset), vec2(1.0 - inset));
+    vec2 uv = t.xy + (vec2(face % 3, face / 3) + faceUv) * t.z;
+
+    // bias of about two texels of the face at this distance, in depth units
+    float depth = length(fromLight) / radius;
+    return texture(shadowAtlas, vec3(uv, depth - 0.005 - 4.0 * inset * depth));
+}
+
+// diffuse irradiance of light i at a surface point, in the light's color; its specular reflection, with a normalized Blinn-Phong lobe as sharp as the roughness allows, is added to specular
+vec3 evaluateLight(uint i, vec3 position, vec3 n, vec3 viewDir, float roughness, inout vec3 specular) {
+    uint base = i * LIGHT_FLOATS;
+    int type = int(lightData[base]);
+    float intensity = lightData[base + 1];
+    vec3 v = vec3(lightData[base + 2], lightData[base + 3], lightData[base + 4]);
+
+    vec3 l;
+    vec3 color = vec3(1.0);
+    if (type == 0) {
+        l = -normalize(v);
+    } else {
+        vec3 toLight = v - position;
+        float d2 = dot(toLight, toLight);
+        l = toLight * inversesqrt(d2);
+        intensity /= 1.0 + d2;
+
+        if (type == 1) {
+            // window the falloff so the light reaches exactly zero at its radius
+            float radius = lightData[base + 5];
+            float x = d2 / (radius * radius);
+            float window = clamp(1.0 - x * x, 0.0, 1.0);
+            intensity *= window * window;
+            intensity *= pointShadow(int(lightData[base + 9]), position - v, radius);
+            color = vec3(lightData[base + 6], lightData[base + 7], lightData[base + 8]);
+        } else {
+            vec3 dir = normalize(vec3(lightData[base + 5], lightData[base + 6], lightData[base + 7]));
+            float cutoff = lightData[base + 8], fade = lightData[base + 9];
+            intensity *= clamp((dot(-l, dir) - cutoff) / max(fade, 1e-4), 0.0, 1.0);
+        }
+    }
+
+    float nl = max(dot(n, l), 0.0);
+    float a2 = max(roughness * roughness * roughness * roughness, 1e-4);
+    float shininess = 2.0 / a2 - 2.0;
+    float nh = max(dot(n, normalize(l + viewDir)), 0.0);
+    vec3 irradiance = color * intensity * nl;
+    specular += irradiance * (shininess + 8.0) / 25.1327 * pow(nh, shininess);
+    return irradiance;
+}
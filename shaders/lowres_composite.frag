@@ -0,0 +1,43 @@
+#version 430 core
+// Upsamples low-resolution particles over the scene; blend ONE, SRC_ALPHA (color is premultiplied, alpha is transmittance).
+// Bilinear where the low-resolution depths agree with the pixel, otherwise the texel nearest in depth
+
+in vec2 texCoords;
+
+uniform sampler2D colorTexture;
+uniform sampler2D depthTexture;
+uniform sampler2D lowDepthTexture;
+uniform float nearPlane;
+uniform float farPlane;
+uniform float threshold;
+
+out vec4 fragColor;
+
+float linearize(float d) {
+    float z = d * 2.0 - 1.0;
+    return 2.0 * nearPlane * farPlane / (farPlane + nearPlane - z * (farPlane - nearPlane));
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float z = linearize(texelFetch(depthTexture, pixel, 0).r);
+
+    ivec2 lowSize = textureSize(lowDepthTexture, 0);
+    vec2 lowPos = texCoords * vec2(lowSize) - 0.5;
+    ivec2 base = ivec2(floor(lowPos));
+
+    bool agree = true;
+    float bestDiff = 1e30;
+    ivec2 best = base;
+    for (int i = 0; i < 4; i++) {
+        ivec2 t = clamp(base + ivec2(i & 1, i >> 1), ivec2(0), lowSize - 1);
+        float diff = abs(linearize(texelFetch(lowDepthTexture, t, 0).r) - z);
+        agree = agree && diff <= threshold * z;
+        if (diff < bestDiff) {
+            bestDiff = diff;
+            best = t;
+        }
+    }
+
+    fragColor = agree ? texture(colorTexture, texCoords) : texelFetch(colorTexture, best, 0);
+}
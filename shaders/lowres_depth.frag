@@ -0,0 +1,16 @@
+#version 430 core
+// Downsamples scene depth into the low-resolution particle target: the farthest of each factor x factor block,
+// so particles are only rejected where the whole block is occluded (partly covered blocks are edges, fixed up at full resolution)
+
+uniform sampler2D depthTexture;
+uniform int factor;
+
+void main() {
+    ivec2 src = ivec2(gl_FragCoord.xy) * factor;
+    ivec2 last = textureSize(depthTexture, 0) - 1;
+    float d = 0.0;
+    for (int y = 0; y < factor; y++)
+        for (int x = 0; x < factor; x++)
+            d = max(d, texelFetch(depthTexture, min(src + ivec2(x, y), last), 0).r);
+    gl_FragDepth = d;
+}
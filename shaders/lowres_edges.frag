@@ -0,0 +1,31 @@
+#version 430 core
+// Marks full-resolution pixels whose depth disagrees with the low-resolution depth around them (the stencil op does the marking;
+// every other pixel is discarded). Particles there are redrawn at full resolution instead of upsampled
+
+uniform sampler2D depthTexture;
+uniform sampler2D lowDepthTexture;
+uniform float nearPlane;
+uniform float farPlane;
+uniform float threshold;        // relative depth difference that counts as an edge
+
+float linearize(float d) {
+    float z = d * 2.0 - 1.0;
+    return 2.0 * nearPlane * farPlane / (farPlane + nearPlane - z * (farPlane - nearPlane));
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float z = linearize(texelFetch(depthTexture, pixel, 0).r);
+
+    // the four low-resolution texels bilinear upsampling would blend
+    ivec2 lowSize = textureSize(lowDepthTexture, 0);
+    vec2 lowPos = (vec2(pixel) + 0.5) * vec2(lowSize) / vec2(textureSize(depthTexture, 0)) - 0.5;
+    ivec2 base = ivec2(floor(lowPos));
+    for (int i = 0; i < 4; i++) {
+        ivec2 t = clamp(base + ivec2(i & 1, i >> 1), ivec2(0), lowSize - 1);
+        float lz = linearize(texelFetch(lowDepthTexture, t, 0).r);
+        if (abs(lz - z) > threshold * z)
+            return;
+    }
+    discard;
+}
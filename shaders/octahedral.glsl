@@ -0,0 +1,22 @@
+// Octahedral unit vector encoding: the sphere is folded onto an octahedron and unwrapped to a square, which spends two channels far more evenly than storing xy
+// Included by the G-buffer shaders; see objects/deferred.h
+
+vec2 octWrap(vec2 v) {
+    return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// unit vector to [0, 1]^2
+vec2 octEncode(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+    return e * 0.5 + 0.5;
+}
+
+// [0, 1]^2 to unit vector
+vec3 octDecode(vec2 e) {
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = clamp(-n.z, 0.0, 1.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
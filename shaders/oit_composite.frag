@@ -0,0 +1,22 @@
+#version 430 core
+// Resolves weighted blended OIT over the scene; blend ONE_MINUS_SRC_ALPHA, SRC_ALPHA
+
+in vec2 texCoords;
+
+uniform sampler2D accumTexture;
+uniform sampler2D revealTexture;
+
+out vec4 fragColor;
+
+void main() {
+    float reveal = texture(revealTexture, texCoords).r;
+
+    // nothing was drawn here; leave the scene untouched
+    if (reveal >= 1.0)
+        discard;
+
+    vec4 accum = texture(accumTexture, texCoords);
+    vec3 average = accum.rgb / max(accum.a, 1e-5);
+
+    fragColor = vec4(average, reveal);
+}
@@ -0,0 +1,47 @@
+#version 430 core
+// Premultiplied-alpha sprite; "additive" blends between over (0) and additive (1) under the same blend state
+
+in vec2 texCoords;
+in vec2 corner;
+in float normAge;
+in float viewDepth;
+
+uniform sampler2D atlas;
+uniform bool useAtlas;
+uniform vec3 tint;
+uniform float additive;
+
+uniform bool softParticles;
+uniform sampler2D sceneDepth;
+uniform bool sceneDepthLinear;     // half-resolution depth is stored linear; full-resolution depth is window depth
+uniform float softDistance;
+uniform float nearPlane;
+uniform float farPlane;
+uniform vec2 viewportSize;
+
+out vec4 fragColor;
+
+// fades sprites out as they approach opaque geometry, hiding the hard line where they intersect it
+float softFade() {
+    if (!softParticles)
+        return 1.0;
+
+    float d = texture(sceneDepth, gl_FragCoord.xy / viewportSize).r;
+    if (!sceneDepthLinear) {
+        float z = d * 2.0 - 1.0;
+        d = 2.0 * nearPlane * farPlane / (farPlane + nearPlane - z * (farPlane - nearPlane));
+    }
+    return clamp((d - viewDepth) / softDistance, 0.0, 1.0);
+}
+
+void main() {
+    vec4 c;
+    if (useAtlas)
+        c = texture(atlas, texCoords);
+    else
+        c = vec4(1.0, 0.6, 0.25, max(0.0, 1.0 - dot(corner, corner)));
+
+    // fade out over the end of the particle's life
+    float a = c.a * (1.0 - smoothstep(0.7, 1.0, normAge)) * softFade();
+    fragColor = vec4(c.rgb * tint * a, a * (1.0 - additive));
+}
@@ -0,0 +1,76 @@
+#version 430 core
+// Camera-facing sprite, pulled from the particle SSBO: one instance per sprite, six vertices per instance
+// (or a triangle fan over the frame's trimmed outline when outlineVertices is set, see objects/flipbook.h)
+
+layout(std430, binding = 0) readonly buffer ParticleData { float data[]; };
+layout(std430, binding = 1) readonly buffer DrawList { uint drawList[]; };
+layout(std430, binding = 2) readonly buffer Outlines { vec2 outlines[]; };
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform int capacity;
+uniform int atlasCols;
+uniform int atlasRows;
+uniform int outlineVertices;    // vertices per frame outline; 0 draws full quads
+uniform int slices;             // CPU pools: slices the pool is stepped in; 0 draws particles where they are
+uniform int sliceEnd[4];        // one past the last particle of each slice (PARTICLE_MAX_SLICES in objects/particles.h)
+uniform float sliceLag[4];      // seconds since each slice was stepped
+
+out vec2 texCoords;
+out vec2 corner;
+out float normAge;
+out float viewDepth;
+
+const vec2 corners[6] = vec2[](
+    vec2(-1, -1), vec2(1, -1), vec2(1, 1),
+    vec2(-1, -1), vec2(1, 1), vec2(-1, 1)
+);
+
+void main() {
+    uint cap = uint(capacity);
+    uint i = drawList[gl_InstanceID];
+
+    vec3 pos = vec3(data[i], data[cap + i], data[2u * cap + i]);
+    float age = data[6u * cap + i];
+    float life = data[7u * cap + i];
+    float size = data[8u * cap + i];
+    uint frame = floatBitsToUint(data[9u * cap + i]);
+
+    // particles not stepped this frame are carried on by their velocity, and hidden once they would have died
+    if (slices > 0) {
+        int s = 0;
+        while (s < slices - 1 && i >= uint(sliceEnd[s]))
+            s++;
+        vec3 vel = vec3(data[3u * cap + i], data[4u * cap + i], data[5u * cap + i]);
+        pos += vel * sliceLag[s];
+        age += sliceLag[s];
+        if (age >= life) {
+            gl_Position = vec4(0.0);
+            return;
+        }
+    }
+
+    if (outlineVertices > 0) {
+        // fan triangle t is (0, t + 1, t + 2)
+        int k = gl_VertexID % 3;
+        int v = k == 0 ? 0 : gl_VertexID / 3 + k;
+        corner = outlines[frame * uint(outlineVertices) + uint(v)];
+    } else {
+        corner = corners[gl_VertexID];
+    }
+
+    // camera right and up are the first two rows of the view matrix
+    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+    vec3 world = pos + (right * corner.x + up * corner.y) * (0.5 * size);
+    vec4 eye = view * vec4(world, 1.0);
+    viewDepth = -eye.z;
+    gl_Position = projection * eye;
+
+    // atlas frames are row-major from the top left; textures are loaded flipped
+    uint cols = uint(atlasCols);
+    vec2 cell = vec2(frame % cols, uint(atlasRows) - 1u - frame / cols);
+    texCoords = (cell + corner * 0.5 + 0.5) / vec2(atlasCols, atlasRows);
+
+    normAge = life > 0.0 ? clamp(age / life, 0.0, 1.0) : 1.0;
+}
@@ -0,0 +1,47 @@
+#version 430 core
+// Heat-haze distortion of a flame sprite, accumulated additively into a reduced-resolution RG16F target
+// The distortion scrolls upwards through the shared curl-noise field; it is occluded by fading against scene depth, like soft particles
+
+in vec2 texCoords;
+in vec2 corner;
+in float normAge;
+in float viewDepth;
+
+uniform sampler3D noiseTexture;     // curl in rgb, unit RMS
+uniform float time;
+uniform float strength;         // peak offset, as a fraction of the screen
+
+uniform bool softParticles;
+uniform sampler2D sceneDepth;
+uniform bool sceneDepthLinear;
+uniform float softDistance;
+uniform float nearPlane;
+uniform float farPlane;
+uniform vec2 viewportSize;
+
+out vec2 distortion;
+
+float softFade() {
+    if (!softParticles)
+        return 1.0;
+
+    float d = texture(sceneDepth, gl_FragCoord.xy / viewportSize).r;
+    if (!sceneDepthLinear) {
+        float z = d * 2.0 - 1.0;
+        d = 2.0 * nearPlane * farPlane / (farPlane + nearPlane - z * (farPlane - nearPlane));
+    }
+    return clamp((d - viewDepth) / softDistance, 0.0, 1.0);
+}
+
+void main() {
+    float r2 = dot(corner, corner);
+    if (r2 >= 1.0)
+        discard;
+
+    // strongest at the sprite's center and early in its life, and weaker with distance
+    float falloff = (1.0 - r2) * (1.0 - r2) * (1.0 - normAge) / max(viewDepth, 1.0);
+
+    // a slice of the field drifting through z, so the shimmer churns rather than only translating
+    vec2 n = clamp(texture(noiseTexture, vec3(texCoords * 0.5 + vec2(0.0, -0.15 * time), 0.05 * time)).rg * 0.6, -1.0, 1.0);
+    distortion = n * strength * falloff * softFade();
+}
@@ -0,0 +1,58 @@
+#version 430 core
+// Weighted blended order-independent transparency (McGuire and Bavoil 2013), accumulation pass
+// Target 0 (RGBA16F, blend ONE, ONE): premultiplied color and coverage, weighted
+// Target 1 (R8, blend ZERO, ONE_MINUS_SRC_COLOR): revealage, the product of (1 - coverage)
+
+in vec2 texCoords;
+in vec2 corner;
+in float normAge;
+in float viewDepth;
+
+uniform sampler2D atlas;
+uniform bool useAtlas;
+uniform vec3 tint;
+uniform float additive;
+
+uniform bool softParticles;
+uniform sampler2D sceneDepth;
+uniform bool sceneDepthLinear;     // half-resolution depth is stored linear; full-resolution depth is window depth
+uniform float softDistance;
+uniform float nearPlane;
+uniform float farPlane;
+uniform vec2 viewportSize;
+
+layout(location = 0) out vec4 accum;
+layout(location = 1) out float reveal;
+
+// fades sprites out as they approach opaque geometry, hiding the hard line where they intersect it
+float softFade() {
+    if (!softParticles)
+        return 1.0;
+
+    float d = texture(sceneDepth, gl_FragCoord.xy / viewportSize).r;
+    if (!sceneDepthLinear) {
+        float z = d * 2.0 - 1.0;
+        d = 2.0 * nearPlane * farPlane / (farPlane + nearPlane - z * (farPlane - nearPlane));
+    }
+    return clamp((d - viewDepth) / softDistance, 0.0, 1.0);
+}
+
+void main() {
+    vec4 c;
+    if (useAtlas)
+        c = texture(atlas, texCoords);
+    else
+        c = vec4(1.0, 0.6, 0.25, max(0.0, 1.0 - dot(corner, corner)));
+
+    // a weighted average cannot express purely additive light, so the coverage weights the color here
+    // regardless of "additive"; additive-only layers stay on the sorted path
+    float a = c.a * (1.0 - smoothstep(0.7, 1.0, normAge)) * softFade();
+    vec3 color = c.rgb * tint * a;
+
+    // depth weight (eq. 7 of the paper), favouring near fragments
+    float z = gl_FragCoord.z;
+    float w = clamp(a * max(1e-2, 3e3 * pow(1.0 - z, 3.0)), 1e-2, 3e3);
+
+    accum = vec4(color, a) * w;
+    reveal = a;
+}
@@ -0,0 +1,30 @@
+#version 430 core
+// Opaque scene geometry lit by the lights of its froxel cluster, plus a dim ambient term
+
+in vec3 fragPos;
+in vec3 normal;
+in vec2 texCoords;
+in float viewDepth;
+
+#include "lights.glsl"
+#include "clusters.glsl"
+
+uniform vec3 albedo;
+uniform float roughness;
+uniform vec3 eye;
+uniform vec3 lightColor;        // shared tint of the lights
+uniform vec3 ambient;
+
+out vec4 fragColor;
+
+void main() {
+    vec3 n = normalize(normal);
+    vec3 viewDir = normalize(eye - fragPos);
+    uvec2 range = clusterRange(gl_FragCoord.xy, viewDepth);
+    vec3 diffuse = vec3(0.0), specular = vec3(0.0);
+    for (uint k = 0u; k < range.y; k++)
+        diffuse += evaluateLight(clusterIndices[range.x + k], fragPos, n, viewDir, roughness, specular);
+
+    // dielectric: 4% specular reflectance
+    fragColor = vec4(albedo * (ambient + lightColor * diffuse) + lightColor * 0.04 * specular, 1.0);
+}
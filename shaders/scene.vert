@@ -0,0 +1,25 @@
+#version 430 core
+// Opaque scene geometry (Mesh vertex layout)
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+out vec3 fragPos;
+out vec3 normal;
+out vec2 texCoords;
+out float viewDepth;
+
+void main() {
+    vec4 world = model * vec4(aPos, 1.0);
+    fragPos = world.xyz;
+    normal = mat3(transpose(inverse(model))) * aNormal;
+    texCoords = aTexCoords;
+    vec4 eye = view * world;
+    viewDepth = -eye.z;
+    gl_Position = projection * eye;
+}
@@ -0,0 +1,11 @@
+#version 430 core
+// Writes distance to the light over its radius, so precision is spread evenly over the light's range
+
+in vec3 worldPos;
+
+uniform vec3 lightPosition;
+uniform float lightRadius;
+
+void main() {
+    gl_FragDepth = length(worldPos - lightPosition) / lightRadius;
+}
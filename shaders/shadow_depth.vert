@@ -0,0 +1,15 @@
+#version 430 core
+// Shadow caster geometry (Mesh vertex layout) into one cube face of a shadow atlas tile
+
+layout(location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 lightViewProjection;
+
+out vec3 worldPos;
+
+void main() {
+    vec4 world = model * vec4(aPos, 1.0);
+    worldPos = world.xyz;
+    gl_Position = lightViewProjection * world;
+}
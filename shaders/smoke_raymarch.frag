@@ -0,0 +1,88 @@
+#version 430 core
+// Raymarches the smoke solver's density through its box, stopping at opaque geometry
+// Each sample is lit by the fire through a short march toward it, plus ambient; output is premultiplied
+
+in vec2 texCoords;
+
+uniform sampler3D densityTexture;
+uniform sampler2D sceneDepth;           // window depth of the opaque scene
+uniform mat4 inverseViewProjection;
+uniform vec3 eye;
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+uniform float extinction;               // per world unit, at density 1
+uniform float albedo;
+uniform int steps;
+uniform int shadowSteps;
+uniform vec3 lightPosition;
+uniform vec3 lightColor;
+uniform float lightRadius;
+uniform vec3 ambient;
+
+out vec4 fragColor;
+
+float density(vec3 p) {
+    return texture(densityTexture, (p - boxMin) / (boxMax - boxMin)).r;
+}
+
+// entry and exit distances of the ray through the box; entry > exit when it misses
+vec2 intersectBox(vec3 origin, vec3 dir) {
+    vec3 inv = 1.0 / dir;
+    vec3 t0 = (boxMin - origin) * inv, t1 = (boxMax - origin) * inv;
+    vec3 lo = min(t0, t1), hi = max(t0, t1);
+    return vec2(max(max(lo.x, lo.y), lo.z), min(min(hi.x, hi.y), hi.z));
+}
+
+// fraction of the light that reaches p through the smoke
+float lightTransmittance(vec3 p) {
+    vec3 toLight = lightPosition - p;
+    float dist = length(toLight);
+    vec3 dir = toLight / dist;
+    float exit = min(intersectBox(p, dir).y, dist);
+    float dt = exit / float(shadowSteps);
+    float depth = 0.0;
+    for (int i = 0; i < shadowSteps; i++)
+        depth += density(p + dir * ((float(i) + 0.5) * dt));
+    return exp(-depth * extinction * dt);
+}
+
+void main() {
+    vec2 ndc = texCoords * 2.0 - 1.0;
+    vec4 far = inverseViewProjection * vec4(ndc, 1.0, 1.0);
+    vec3 dir = normalize(far.xyz / far.w - eye);
+
+    // the march ends at the box or at the scene, whichever is nearer
+    vec4 hit = inverseViewProjection * vec4(ndc, texture(sceneDepth, texCoords).r * 2.0 - 1.0, 1.0);
+    float sceneT = length(hit.xyz / hit.w - eye);
+    vec2 span = intersectBox(eye, dir);
+    span.x = max(span.x, 0.0);
+    span.y = min(span.y, sceneT);
+    if (span.y <= span.x)
+        discard;
+
+    // per-pixel jitter of the first sample trades banding for noise
+    float jitter = fract(sin(dot(gl_FragCoord.xy, vec2(12.9898, 78.233))) * 43758.5453);
+    float dt = (span.y - span.x) / float(steps);
+    vec3 color = vec3(0.0);
+    float transmittance = 1.0;
+    for (int i = 0; i < steps; i++) {
+        vec3 p = eye + dir * (span.x + (float(i) + jitter) * dt);
+        float d = density(p);
+        if (d < 1e-3)
+            continue;
+
+        // windowed inverse-square falloff, as the scene's point lights
+        vec3 toLight = lightPosition - p;
+        float dist2 = dot(toLight, toLight);
+        float window = clamp(1.0 - dist2 * dist2 / pow(lightRadius, 4.0), 0.0, 1.0);
+        vec3 lit = ambient + lightColor * (window * window / (dist2 + 1.0)) * lightTransmittance(p);
+
+        float a = 1.0 - exp(-d * extinction * dt);
+        color += transmittance * a * albedo * lit;
+        transmittance *= 1.0 - a;
+        if (transmittance < 0.01)
+            break;
+    }
+
+    fragColor = vec4(color, 1.0 - transmittance);
+}
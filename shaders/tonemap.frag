@@ -0,0 +1,25 @@
+#version 430 core
+// Resolves the HDR scene to the window: adds bloom, applies exposure and a filmic curve (Narkowicz's ACES fit), and gamma encodes
+
+in vec2 texCoords;
+
+uniform sampler2D hdrTexture;
+uniform sampler2D bloomTexture;
+uniform bool useBloom;
+uniform float bloomIntensity;
+uniform float exposure;
+
+out vec4 fragColor;
+
+vec3 aces(vec3 x) {
+    return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main() {
+    vec3 color = texture(hdrTexture, texCoords).rgb;
+    if (useBloom)
+        color += textureLod(bloomTexture, texCoords, 0.0).rgb * bloomIntensity;
+
+    color = aces(color * exposure);
+    fragColor = vec4(pow(color, vec3(1.0 / 2.2)), 1.0);
+}
@@ -0,0 +1,140 @@
+/**
+ * @file jobs.cpp
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Fixed-size worker pool with a blocking parallel-for, used to split CPU simulation kernels across cores
+ * @version 0.1
+ * @date 2022-08-06
+ */
+
+#include "jobs.h"
+
+/**
+ * @brief Construct a new JobSystem object
+ * 
+ * @param numThreads Total number of threads executing work (including the caller of parallelFor). Defaults to the hardware concurrency
+ */
+JobSystem::JobSystem(unsigned int numThreads) : nextChunk(0), finishedChunks(0) {
+    if (numThreads == 0)
+        numThreads = std::thread::hardware_concurrency();
+    if (numThreads == 0)
+        numThreads = 1;
+
+    // the calling thread is the last worker
+    for (unsigned int i = 0; i < numThreads - 1; i++)
+        workers.emplace_back(&JobSystem::workerLoop, this);
+}
+
+/**
+ * @brief Destroy the JobSystem object. Joins all worker threads
+ */
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quitting = true;
+    }
+    wake.notify_all();
+
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+/**
+ * @brief Gets the number of threads that execute work, including the calling thread
+ */
+unsigned int JobSystem::getThreadCount() {
+    return workers.size() + 1;
+}
+
+/**
+ * @brief Runs f over [0, count) in chunks of grain elements on all threads, and blocks until all chunks are complete. Not reentrant; f must not call parallelFor
+ * 
+ * @param count Number of elements
+ * @param grain Maximum number of elements per chunk
+ * @param f Function called as f(begin, end) for each chunk
+ */
+void JobSystem::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& f) {
+    if (count == 0)
+        return;
+    if (grain == 0)
+        grain = 1;
+
+    size_t chunks = (count + grain - 1) / grain;
+    // chunk indices are claimed in 32 bits
+    while (chunks > 0xffffffffull) {
+        grain *= 2;
+        chunks = (count + grain - 1) / grain;
+    }
+
+    // not worth waking anyone up
+    if (chunks == 1 || workers.empty()) {
+        f(0, count);
+        return;
+    }
+
+    Job j;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        generation++;
+        j.f = &f;
+        j.count = count;
+        j.grain = grain;
+        j.chunks = chunks;
+        j.tag = (uint64_t)(uint32_t)generation << 32;
+        job = j;
+        nextChunk.store(j.tag);
+        finishedChunks.store(0);
+    }
+    wake.notify_all();
+
+    runChunks(j);
+
+    // wait for stragglers
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this, &j] { return finishedChunks.load() == j.chunks; });
+    job = Job();
+}
+
+/**
+ * @brief Claims and executes chunks of a job until none remain. Claims only succeed while the counter still carries the job's generation, so a worker that wakes late for a finished job returns without touching the next one
+ *
+ * @param j Copy of the job taken under the mutex
+ */
+void JobSystem::runChunks(const Job& j) {
+    uint64_t claim = nextChunk.load();
+    while (true) {
+        if ((claim & 0xffffffff00000000ull) != j.tag || (claim & 0xffffffffull) >= j.chunks)
+            return;
+        if (!nextChunk.compare_exchange_weak(claim, claim + 1))
+            continue;
+
+        size_t c = (size_t)(claim & 0xffffffffull);
+        size_t begin = c * j.grain;
+        size_t end = begin + j.grain < j.count ? begin + j.grain : j.count;
+        (*j.f)(begin, end);
+
+        if (finishedChunks.fetch_add(1) + 1 == j.chunks) {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.notify_one();
+        }
+        claim = nextChunk.load();
+    }
+}
+
+/**
+ * @brief Main loop for worker threads; sleeps until a new job generation is published
+ */
+void JobSystem::workerLoop() {
+    unsigned long long seen = 0;
+    while (true) {
+        Job j;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, &seen] { return quitting || generation != seen; });
+            if (quitting)
+                return;
+            seen = generation;
+            j = job;
+        }
+        runChunks(j);
+    }
+}
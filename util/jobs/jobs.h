@@ -0,0 +1,62 @@
+/**
+ * @file jobs.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Fixed-size worker pool with a blocking parallel-for, used to split CPU simulation kernels across cores
+ * @version 0.1
+ * @date 2022-08-06
+ */
+
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem {
+    public:
+        JobSystem(unsigned int numThreads = 0);
+        ~JobSystem();
+
+        // splits [0, count) into chunks of at most grain elements, and runs f(begin, end) on every chunk across all workers
+        // (the calling thread participates). Blocks until every chunk has completed
+        void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& f);
+
+        // number of threads that execute work, including the calling thread
+        unsigned int getThreadCount();
+
+    private:
+        // description of one parallelFor; workers copy it under the mutex, so only the claim counter is shared while running
+        struct Job {
+            const std::function<void(size_t, size_t)>* f = NULL;
+            size_t count = 0;
+            size_t grain = 1;
+            size_t chunks = 0;
+            uint64_t tag = 0;           // generation, in the top half of every claim made against this job
+        };
+
+        void workerLoop();
+        void runChunks(const Job& j);
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+
+        // current job; only valid while a parallelFor is in flight
+        Job job;
+        // generation in the high 32 bits, next unclaimed chunk in the low 32. A worker still holding an older job
+        // sees a different generation and cannot claim chunks of the new one
+        std::atomic<uint64_t> nextChunk;
+        std::atomic<size_t> finishedChunks;
+        unsigned long long generation = 0;
+
+        bool quitting = false;
+};
+
+#endif
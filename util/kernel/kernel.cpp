@@ -86,10 +86,14 @@ bool Kernel::initSDL() {
         return false;
     }
     
-    //Specify OpenGL Version (4.3)
+    //Specify OpenGL Version (4.4, for persistently mapped buffers)
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
-    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 4);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+    // 24-bit depth with stencil, so scene depth can be blitted into offscreen DEPTH24_STENCIL8 targets
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+    SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
     SDL_Log("SDL Initialized");
     return true;
 }
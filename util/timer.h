@@ -0,0 +1,37 @@
+/**
+ * @file timer.h
+ * @author Eron Ristich (eron@ristich.com)
+ * @brief Small wall-clock stopwatch used for CPU-side stats and benchmarks
+ * @version 0.1
+ * @date 2022-08-06
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <chrono>
+
+/**
+ * @brief Stopwatch over the steady clock. Starts on construction
+ */
+class Timer {
+    public:
+        Timer() {
+            reset();
+        }
+
+        // restarts the stopwatch
+        void reset() {
+            start = std::chrono::steady_clock::now();
+        }
+
+        // milliseconds elapsed since construction or the last reset
+        double elapsedMs() {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start;
+};
+
+#endif